@@ -36,4 +36,13 @@
 #define unlikely(x) (x)
 #endif
 
+/* busy-wait hint */
+#if defined(__x86_64__) || defined(__i386__)
+#define cpu_relax() __builtin_ia32_pause()
+#elif defined(__aarch64__)
+#define cpu_relax() __asm__ __volatile__("yield" ::: "memory")
+#else
+#define cpu_relax() __asm__ __volatile__("" ::: "memory")
+#endif
+
 #endif				/* _RPC_INTRINSIC_H */
@@ -74,10 +74,15 @@
  * uint64_t atomic_postclear_uint64_t_bits(uint64_t *var,
  * uint64_t atomic_postset_uint64_t_bits(uint64_t *var,
  *
+ * Compare and swap is provided for uint32_t:
+ *
+ * bool atomic_cas_uint32_t(uint32_t *var, uint32_t *expected, uint32_t val)
+ *
  */
 
 #ifndef _ABSTRACT_ATOMIC_H
 #define _ABSTRACT_ATOMIC_H
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <time.h>
@@ -2299,6 +2304,39 @@ static inline void atomic_store_uint32_t(uint32_t *var, uint32_t val)
 }
 #endif
 
+/**
+ * @brief Atomically compare and swap a uint32_t
+ *
+ * This function atomically stores val in the variable indicated by
+ * the supplied pointer, when it still holds the expected value.
+ *
+ * @param[in,out] var      Pointer to the variable to modify
+ * @param[in,out] expected The value expected; on failure, the value found
+ * @param[in]     val      The value to store
+ *
+ * @return true when val was stored.
+ */
+
+#ifdef GCC_ATOMIC_FUNCTIONS
+static inline bool atomic_cas_uint32_t(uint32_t *var, uint32_t *expected,
+				       uint32_t val)
+{
+	return __atomic_compare_exchange_n(var, expected, val, false,
+					   __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+#elif defined(GCC_SYNC_FUNCTIONS)
+static inline bool atomic_cas_uint32_t(uint32_t *var, uint32_t *expected,
+				       uint32_t val)
+{
+	uint32_t found = __sync_val_compare_and_swap(var, *expected, val);
+
+	if (found == *expected)
+		return true;
+	*expected = found;
+	return false;
+}
+#endif
+
 /**
  * @brief Atomically fetch an int16_t
  *
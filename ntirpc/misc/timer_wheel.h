@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2026 The libntirpc contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR `AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <misc/queue.h>
+
+/**
+ ** Hierarchical timer wheel.  Adding, removing, and expiring an entry
+ ** are O(1); timer_wheel_expire() costs O(expired) plus the ticks elapsed.
+ **
+ ** Entries fire at tick resolution, never early.  Owners with a busy
+ ** deadline (e.g., last receive) should not re-add on each update, but
+ ** re-check from the callback and re-add for the remainder.
+ **/
+
+#define TIMER_WHEEL_BITS	6
+#define TIMER_WHEEL_SLOTS	(1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_LEVELS	4	/* 2^24 ticks */
+
+struct timer_wheel_entry;
+typedef void (*timer_wheel_fun_t)(struct timer_wheel_entry *);
+
+TAILQ_HEAD(timer_wheel_head, timer_wheel_entry);
+
+struct timer_wheel_entry {
+	TAILQ_ENTRY(timer_wheel_entry) q;
+	struct timer_wheel_head *head;	/* NULL when not queued */
+	timer_wheel_fun_t fun;	/* called without the wheel locked */
+	uint64_t expires;	/* tick */
+};
+
+struct timer_wheel {
+	pthread_mutex_t mtx;
+	pthread_cond_t cv;
+	uint32_t tick_ms;
+	bool initialized;
+	uint64_t now;		/* last tick expired */
+	uint32_t count;		/* queued */
+	bool expiring;
+	struct timer_wheel_entry *running;	/* callback in progress */
+	pthread_t running_thr;
+	struct timer_wheel_head expired;	/* due, callback pending */
+	struct timer_wheel_head slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+};
+
+#define TIMER_WHEEL_INITIALIZER(ms) {		\
+	.mtx = PTHREAD_MUTEX_INITIALIZER,	\
+	.cv = PTHREAD_COND_INITIALIZER,		\
+	.tick_ms = (ms),			\
+}
+
+/* (re-)queue to fire after delay_ms; fun set by the caller */
+void timer_wheel_add(struct timer_wheel *, struct timer_wheel_entry *,
+		     uint64_t delay_ms);
+
+/* dequeue; true when it was queued.  When its callback is running on
+ * another thread, waits for it to return (the owner may then be freed).
+ */
+bool timer_wheel_del(struct timer_wheel *, struct timer_wheel_entry *);
+
+/* run the callbacks of all entries due; returns how many */
+uint32_t timer_wheel_expire(struct timer_wheel *);
+
+#endif				/* TIMER_WHEEL_H */
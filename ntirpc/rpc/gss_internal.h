@@ -36,6 +36,7 @@
 #include <misc/rbtree_x.h>
 #include <misc/queue.h>
 #include <misc/abstract_atomic.h>
+#include <misc/timer_wheel.h>
 #include <intrinsic.h>
 
 #ifdef HAVE_HEIMDAL
@@ -95,8 +96,22 @@ struct svc_rpc_gss_data {
 	} pac;
 	SVCAUTH *auth;
 	uint32_t endtime;
+	struct timer_wheel_entry expire;	/* at endtime, while cached */
 };
 
+#ifdef __APPLE__
+/* there's also mach_absolute_time() - don't know if it's faster */
+#define get_time_fast()	time(0)
+#else
+static inline int64_t
+get_time_fast(void)
+{
+	struct timespec ts[1];
+	(void)clock_gettime(CLOCK_MONOTONIC_FAST, ts);
+	return ts->tv_sec;
+}
+#endif
+
 bool svcauth_gss_destroy(SVCAUTH *auth);
 
 static inline struct
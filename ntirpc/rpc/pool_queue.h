@@ -32,6 +32,11 @@
  *
  * This provides simple queues using pthreads and TAILQ primitives.
  *
+ * Optionally, a poolq_head also has a bounded lock-free ring (Vyukov's
+ * multi-producer/multi-consumer array queue).  Users try the ring first,
+ * and take the mutex only when it is empty (to wait) or full (to queue on
+ * the TAILQ).  The qcount then counts only the TAILQ entries and waiters.
+ *
  * @note    Loosely based upon previous wait_queue by
  *          Matt Benjamin <matt@cohortfs.com>
  */
@@ -42,6 +47,8 @@
 #include <pthread.h>
 #include <sys/types.h>
 #include <misc/queue.h>
+#include <misc/portable.h>
+#include <rpc/types.h>
 
 struct poolq_entry {
 	TAILQ_ENTRY(poolq_entry) q;	/*** 1st ***/
@@ -50,9 +57,25 @@ struct poolq_entry {
 	u_int qflags;
 };
 
+struct poolq_cell {
+	uint32_t seq;
+	struct poolq_entry *have;
+};
+
+struct poolq_ring {
+	uint32_t mask;			/* slots - 1 */
+	CACHE_PAD(0);
+	uint32_t enq;			/* producers */
+	CACHE_PAD(1);
+	uint32_t deq;			/* consumers */
+	CACHE_PAD(2);
+	struct poolq_cell cell[];
+};
+
 struct poolq_head {
 	TAILQ_HEAD(q_head, poolq_entry) qh;
 	pthread_mutex_t qmutex;
+	struct poolq_ring *qring;	/* NULL: TAILQ only */
 
 	u_int qsize;			/* default size of q entries,
 					 * 0: static size */
@@ -63,6 +86,11 @@ struct poolq_head {
 static inline void
 poolq_head_destroy(struct poolq_head *qh)
 {
+	if (qh->qring) {
+		mem_free(qh->qring, sizeof(struct poolq_ring)
+			 + (qh->qring->mask + 1) * sizeof(struct poolq_cell));
+		qh->qring = NULL;
+	}
 	pthread_mutex_destroy(&qh->qmutex);
 }
 
@@ -71,7 +99,100 @@ poolq_head_setup(struct poolq_head *qh)
 {
 	TAILQ_INIT(&qh->qh);
 	pthread_mutex_init(&qh->qmutex, NULL);
+	qh->qring = NULL;
 	qh->qcount = 0;
 }
 
+/**
+ * @brief Add a ring to a setup poolq_head
+ *
+ * @param[in] qh	the queue head
+ * @param[in] slots	minimum ring size, rounded up to a power of 2
+ */
+static inline void
+poolq_ring_setup(struct poolq_head *qh, uint32_t slots)
+{
+	struct poolq_ring *ring;
+	uint32_t size = 2;
+	uint32_t ix;
+
+	while (size < slots)
+		size <<= 1;
+
+	ring = mem_zalloc(sizeof(struct poolq_ring)
+			  + size * sizeof(struct poolq_cell));
+	ring->mask = size - 1;
+	for (ix = 0; ix < size; ix++)
+		ring->cell[ix].seq = ix;
+
+	qh->qring = ring;
+}
+
+/**
+ * @brief Add an entry to the ring
+ *
+ * @return false when the ring is full.
+ */
+static inline bool
+poolq_ring_push(struct poolq_ring *ring, struct poolq_entry *have)
+{
+	struct poolq_cell *cell;
+	uint32_t pos = atomic_fetch_uint32_t(&ring->enq);
+	int32_t dif;
+
+	for (;;) {
+		cell = &ring->cell[pos & ring->mask];
+		dif = (int32_t)(atomic_fetch_uint32_t(&cell->seq) - pos);
+		if (dif == 0) {
+			/* free slot, claim it (or pos is reloaded) */
+			if (atomic_cas_uint32_t(&ring->enq, &pos, pos + 1))
+				break;
+		} else if (dif < 0) {
+			/* full */
+			return false;
+		} else {
+			/* another producer claimed it */
+			pos = atomic_fetch_uint32_t(&ring->enq);
+		}
+	}
+
+	cell->have = have;
+	atomic_store_uint32_t(&cell->seq, pos + 1);
+	return true;
+}
+
+/**
+ * @brief Remove an entry from the ring
+ *
+ * @return the entry, or NULL when the ring is empty.
+ */
+static inline struct poolq_entry *
+poolq_ring_pop(struct poolq_ring *ring)
+{
+	struct poolq_cell *cell;
+	struct poolq_entry *have;
+	uint32_t pos = atomic_fetch_uint32_t(&ring->deq);
+	int32_t dif;
+
+	for (;;) {
+		cell = &ring->cell[pos & ring->mask];
+		dif = (int32_t)(atomic_fetch_uint32_t(&cell->seq) - (pos + 1));
+		if (dif == 0) {
+			/* filled slot, claim it (or pos is reloaded) */
+			if (atomic_cas_uint32_t(&ring->deq, &pos, pos + 1))
+				break;
+		} else if (dif < 0) {
+			/* empty */
+			return NULL;
+		} else {
+			/* another consumer claimed it */
+			pos = atomic_fetch_uint32_t(&ring->deq);
+		}
+	}
+
+	have = cell->have;
+	atomic_store_uint32_t(&cell->seq, pos + ring->mask + 1);
+	return have;
+}
+
 #endif				/* POOL_QUEUE_H */
@@ -81,6 +81,24 @@
 #define SVC_INIT_EPOLL          0x0002
 #define SVC_INIT_NOREG_XPRTS    0x0008
 #define SVC_INIT_BLKIN          0x0010
+#define SVC_INIT_NUMA           0x0020	/* work pool per NUMA node */
+#define SVC_INIT_VC_ET          0x0040	/* nonblocking, edge triggered VC */
+#define SVC_INIT_IOQ_IFQ        0x0080	/* busy VC output takes turns per
+					 * interface */
+#define SVC_INIT_ZEROCOPY       0x0100	/* MSG_ZEROCOPY for large output on
+					 * SVC_INIT_VC_ET xprts */
+#define SVC_INIT_VC_IOQ_RECV    0x0200	/* SVC_INIT_VC_ET xprts read into
+					 * pooled xdr_ioq segments, or
+					 * receive them on SVC_RQST_FLAG_URING
+					 * channels */
+#define SVC_INIT_WORK_PRIO      0x0400	/* work pool dequeues by
+					 * work_pool_entry prio, per
+					 * xprt by SVCSET_XP_PRIO, per
+					 * call by svc_init_params
+					 * classify */
+#define SVC_INIT_LAZY_LOCAL     0x0800	/* xp_local of accepted VC xprts
+					 * left unset until svc_xprt_local()
+					 * (svc_getrpclocal()) */
 
 #define SVC_SHUTDOWN_FLAG_NONE  0x0000
 
@@ -103,6 +121,13 @@
 #define SVCSET_XP_RECV_USER_DATA        14
 #define SVCGET_XP_FREE_USER_DATA        15
 #define SVCSET_XP_FREE_USER_DATA        16
+/*
+ * SVC_INIT_WORK_PRIO: the xprt is queued to the work pool before its
+ * requests are decoded, in its class.  Connections accepted by a listener
+ * take its.  Calls are then classed by svc_init_params classify, if any.
+ */
+#define SVCGET_XP_PRIO          17	/* uint32_t WORK_POOL_PRIO_* */
+#define SVCSET_XP_PRIO          18
 
 /*
  * Operations for rpc_control().
@@ -117,9 +142,28 @@
 /* Svc event strategy */
 enum svc_event_type {
 	SVC_EVENT_FDSET /* trad. using select and poll (currently unhooked) */ ,
-	SVC_EVENT_EPOLL		/* Linux epoll interface */
+	SVC_EVENT_EPOLL,	/* Linux epoll interface */
+	SVC_EVENT_URING		/* Linux io_uring (USE_IO_URING) */
 };
 
+struct svc_req;
+
+/*
+ * SVC_INIT_WORK_PRIO: the WORK_POOL_PRIO_* of a call, from its header
+ * (rq_xprt and rq_msg; not yet authenticated, arguments not decoded).
+ * On SVC_RQST_FLAG_WORKER channels, a call classed other than the task
+ * that read it is set aside, and its authentication, dispatch and the
+ * reading of the requests after it continue in a task of its class.
+ */
+typedef uint32_t (*svc_classify_t) (struct svc_req *);
+
+/*
+ * inline_max: whether a call, from its header, may be dispatched on the
+ * event thread that read it, as it does not block.  The others (all,
+ * without one) continue in svc_work_pool.
+ */
+typedef bool (*svc_nonblock_t) (struct svc_req *);
+
 typedef struct svc_init_params {
 	u_long flags;
 	u_int max_connections;	/* xprts */
@@ -131,11 +175,37 @@ typedef struct svc_init_params {
 	u_int gss_max_idle_gen;
 	u_int gss_max_gc;
 	u_int ioq_thrd_max;
+	u_int inline_max;	/* SVC_RQST_FLAG_WORKER: getreq on the
+				 * event thread when a whole record of
+				 * no more than this many bytes is
+				 * received, calls by nonblock, 0: never */
+	u_int busy_poll_us;	/* SVC_RQST_FLAG_BUSY_POLL: poll without
+				 * blocking this long after an event */
+	u_int busy_poll_napi_us;	/* SVC_RQST_FLAG_BUSY_POLL: also
+					 * SO_BUSY_POLL on sockets, 0: not */
+	u_int getreq_budget;	/* requests per xprt before it yields to
+				 * the others, 0: SVC_GETREQ_BUDGET */
+	u_int ioq_hiwat;	/* VC output queued (bytes) above which no
+				 * more requests are read, 0: 4 * maxbuf */
+	u_int ioq_lowat;	/* ... until it is down to this, 0: 1/4 */
+	u_int zerocopy_min;	/* SVC_INIT_ZEROCOPY: smallest output
+				 * (bytes) sent so, 0: 64 KiB */
+	svc_classify_t classify;	/* SVC_INIT_WORK_PRIO: class of each
+					 * call, NULL: its xprt's */
+	svc_nonblock_t nonblock;	/* inline_max: calls dispatched on
+					 * the event thread, NULL: none */
 } svc_init_params;
 
 /* Svc param flags */
 #define SVC_FLAG_NONE             0x0000
 #define SVC_FLAG_NOREG_XPRTS      0x0001
+#define SVC_FLAG_NUMA             0x0002
+#define SVC_FLAG_VC_ET            0x0004
+#define SVC_FLAG_IOQ_IFQ          0x0008
+#define SVC_FLAG_ZEROCOPY         0x0010
+#define SVC_FLAG_VC_IOQ_RECV      0x0020
+#define SVC_FLAG_WORK_PRIO        0x0040
+#define SVC_FLAG_LAZY_LOCAL       0x0080
 
 /*
  * SVCXPRT xp_flags
@@ -150,12 +220,25 @@ typedef struct svc_init_params {
 #define SVC_XPRT_FLAG_DESTROYED		0x0020	/* SVC_DESTROY() was called */
 #define SVC_XPRT_FLAG_DESTROYING	0x0040	/* (*xp_destroy) was called */
 #define SVC_XPRT_FLAG_INITIALIZED	0x0080
+#define SVC_XPRT_FLAG_EDGE		0x0100	/* EPOLLET, see xp_ev_busy */
+#define SVC_XPRT_FLAG_ADDED_SEND	0x0200	/* xp_fd_send on the channel */
+#define SVC_XPRT_FLAG_SEND_WAIT		0x0400	/* output waits for EPOLLOUT */
+#define SVC_XPRT_FLAG_ZEROCOPY		0x0800	/* SO_ZEROCOPY set */
+#define SVC_XPRT_FLAG_RECV_SEGS		0x1000	/* input in segments, see
+						 * xp_ev_recv */
 #define SVC_XPRT_FLAG_MASK		0xffff
 
 /* uint32_t instructions */
 #define SVC_XPRT_FLAG_LOCKED		0x00010000
 #define SVC_XPRT_FLAG_UNLOCK		0x00020000
 
+/*
+ * SVCXPRT xp_ev_busy (SVC_XPRT_FLAG_EDGE)
+ */
+
+#define SVC_XPRT_EV_ACTIVE		0x0001	/* a thread is receiving */
+#define SVC_XPRT_EV_PENDING		0x0002	/* event while active */
+
 /*
  * SVC_REF flags
  */
@@ -268,6 +351,20 @@ typedef struct rpc_svcxprt {
 	/* event vector list */
 	TAILQ_ENTRY(rpc_svcxprt) xp_evq;
 
+	/* SVC_RQST_FLAG_WORKER getreq task, its prio set by SVCSET_XP_PRIO
+	 * (calls may be classed otherwise, see svc_classify_t)
+	 */
+	struct work_pool_entry xp_wpe;
+
+	/* svc_rqst_evchan_migrate() target chan_id, 0: none */
+	uint32_t xp_ev_next;
+
+	/* SVC_XPRT_FLAG_EDGE: an event is handled by the receiving thread */
+	uint32_t xp_ev_busy;
+
+	/* SVC_XPRT_FLAG_RECV_SEGS: input received by the event channel */
+	void *xp_ev_recv;
+
 	/* indexed by fd */
 	struct opr_rbtree_node xp_fd_node;
 
@@ -275,6 +372,7 @@ typedef struct rpc_svcxprt {
 	uint32_t xp_requests;	/* related requests count */
 
 	int xp_fd;
+	int xp_fd_send;		/* dup of xp_fd for EPOLLOUT, or -1 */
 	int xp_ifindex;		/* interface index */
 	int xp_si_type;		/* si type */
 	int xp_type;		/* xprt type */
@@ -367,7 +465,14 @@ struct svc_req {
  *  Approved way of getting addresses
  */
 #define svc_getrpccaller(x) (&(x)->xp_remote.ss)
-#define svc_getrpclocal(x) (&(x)->xp_local.ss)
+#define svc_getrpclocal(x) (&svc_xprt_local(x)->ss)
+
+/* xp_local; with SVC_INIT_LAZY_LOCAL, of accepted connections, looked up
+ * on first use: read it only through this
+ */
+__BEGIN_DECLS
+extern struct rpc_address *svc_xprt_local(SVCXPRT *);
+__END_DECLS
 
 /*
  * Ganesha.  Get connected transport type.
@@ -525,6 +630,22 @@ __END_DECLS
 __BEGIN_DECLS
 int svc_shutdown(u_long flags);
 __END_DECLS
+
+/*
+ * Connection oriented output totals.
+ */
+struct svc_ioq_stats {
+	uint64_t sends;		/* sendmsg() calls */
+	uint64_t replies;	/* records written */
+	uint64_t bytes;
+	uint64_t waits;		/* socket full, waited for EPOLLOUT */
+	uint64_t zerocopy;	/* sendmsg() calls with MSG_ZEROCOPY */
+	uint64_t zerocopy_copied;	/* ... completed, but copied */
+};
+
+__BEGIN_DECLS
+void svc_ioq_output_stats(struct svc_ioq_stats *);
+__END_DECLS
 /*
  * Service registration
  *
@@ -701,6 +822,26 @@ svc_vc_ncreate(const int fd, const u_int sendsize, const u_int recvsize)
 	return (svc_vc_ncreatef(fd, sendsize, recvsize, SVC_CREATE_FLAG_CLOSE));
 }
 
+/* svc_vc_ncreate_reuseport() flags */
+#define SVC_VC_REUSEPORT_NONE		0x0000
+#define SVC_VC_REUSEPORT_CPU		0x0001	/* steer by cpu (cBPF) */
+#define SVC_VC_REUSEPORT_INCOMING_CPU	0x0002	/* SO_INCOMING_CPU hint */
+
+extern int svc_vc_ncreate_reuseport(const struct sockaddr *, const socklen_t,
+				    const u_int, const u_int,
+				    const uint32_t *, const int,
+				    const uint32_t, SVCXPRT **);
+/*
+ *      const struct sockaddr *addr;            -- address to listen on
+ *      const socklen_t len;                    -- address length
+ *      const u_int sendsize;                   -- max send size
+ *      const u_int recvsize;                   -- max recv size
+ *      const uint32_t *chan_ids;               -- event channel each
+ *      const int n;                            -- listeners
+ *      const uint32_t flags;                   -- SVC_VC_REUSEPORT_*
+ *      SVCXPRT **xprts;                        -- n listeners (OUT)
+ */
+
 /*
  * Create a client handle from an active service transport handle.
  * (Defined here because this file knows about clnt.h, but not vice versa.)
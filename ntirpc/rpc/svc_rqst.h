@@ -36,7 +36,14 @@
 /* uint16_t actually used */
 #define SVC_RQST_FLAG_XPRT_UREG		SVC_XPRT_FLAG_UREG
 #define SVC_RQST_FLAG_CHAN_AFFINITY	0x1000 /* bind conn to parent chan */
-#define SVC_RQST_FLAG_MASK (SVC_RQST_FLAG_CHAN_AFFINITY)
+#define SVC_RQST_FLAG_WORKER		0x2000 /* getreq in svc_work_pool,
+						* unless under inline_max */
+#define SVC_RQST_FLAG_BALANCE		0x4000 /* new conns to least loaded
+						* BALANCE chan */
+#define SVC_RQST_FLAG_BUSY_POLL		0x8000 /* spin for busy_poll_us
+						* before blocking */
+#define SVC_RQST_FLAG_MASK (SVC_RQST_FLAG_CHAN_AFFINITY | SVC_RQST_FLAG_WORKER \
+			    | SVC_RQST_FLAG_BALANCE | SVC_RQST_FLAG_BUSY_POLL)
 
 /* uint32_t instructions */
 #define SVC_RQST_FLAG_LOCKED		SVC_XPRT_FLAG_LOCKED
@@ -45,15 +52,21 @@
 
 #define SVC_RQST_FLAG_PART_LOCKED	0x00100000
 #define SVC_RQST_FLAG_PART_UNLOCK	0x00200000
+#define SVC_RQST_FLAG_URING		0x00400000 /* io_uring, else epoll */
 
 /*
  * exported interface:
  *
  *  svc_rqst_init -- init module (optional)
  *  svc_rqst_new_evchan -- create event channel
- *  svc_rqst_evchan_reg -- set {xprt, dispatcher} mapping
+ *  svc_rqst_evchan_reg -- set {xprt, dispatcher} mapping; 0 once hooked
+ *   when called by the channel's thread or before any runs it, else
+ *   once posted to its thread, which destroys the xprt if the hook fails
+ *  svc_rqst_evchan_migrate -- move xprt to another channel at its next rearm
+ *  svc_rqst_evchan_stats -- get channel load counters
  *  svc_rqst_foreach_xprt -- scan registered xprts at id (or 0 for all)
- *  svc_rqst_thrd_run -- enter dispatch loop at id
+ *  svc_rqst_thrd_run -- enter dispatch loop at id (from any number of
+ *   threads)
  *  svc_rqst_thrd_signal --request thread to run a callout function which
  *   can cause the thread to return
  *  svc_rqst_shutdown -- cause all threads to return
@@ -69,6 +82,24 @@ int svc_rqst_new_evchan(uint32_t *chan_id /* OUT */ , void *u_data,
 			uint32_t flags);
 int svc_rqst_evchan_reg(uint32_t chan_id, SVCXPRT *xprt, uint32_t flags);
 int svc_rqst_rearm_events(SVCXPRT *xprt, uint32_t flags);
+int svc_rqst_requeue(SVCXPRT *xprt);
+int svc_rqst_submit(SVCXPRT *xprt, struct work_pool_entry *wpe);
+int svc_rqst_evchan_migrate(SVCXPRT *xprt, uint32_t chan_id);
+
+struct svc_rqst_stats {
+	uint32_t n_xprts;	/* registered */
+	uint64_t events;	/* xprt events handled */
+	uint64_t bytes;		/* readable at event, when measured
+				 * (BALANCE or inline_max) */
+	uint64_t events_sec;	/* over the last interval of 1 s or more */
+	uint64_t bytes_sec;
+	uint64_t polls_busy;	/* SVC_RQST_FLAG_BUSY_POLL: polls with */
+	uint64_t polls_empty;	/* and without events, not blocking */
+	uint64_t requeues;	/* xprts yielding at getreq_budget */
+	uint32_t batch;		/* current events per wait */
+};
+
+int svc_rqst_evchan_stats(uint32_t chan_id, struct svc_rqst_stats *stats);
 
 int svc_rqst_xprt_register(SVCXPRT *xprt, SVCXPRT *newxprt);
 void svc_rqst_xprt_unregister(SVCXPRT *xprt);
@@ -52,7 +52,7 @@
  *  Approved way of getting addresses
  */
 #define svc_getcaller_netbuf(x) (&(x)->xp_remote.nb)
-#define svc_getlocal_netbuf(x) (&(x)->xp_local.nb)
+#define svc_getlocal_netbuf(x) (&svc_xprt_local(x)->nb)
 
 /*
  * Service registration
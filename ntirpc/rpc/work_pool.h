@@ -40,29 +40,127 @@
 #define WORK_POOL_H
 
 #include <rpc/pool_queue.h>
+#include <misc/portable.h>
 
+struct work_pool;
 struct work_pool_entry;
 typedef void (*work_pool_fun_t) (struct work_pool_entry *);
+typedef void (*work_pool_idle_t) (struct work_pool *);
+
+/* work_pool_entry prio (WORK_POOL_FLAG_PRIO) */
+#define WORK_POOL_PRIO_NORMAL		0	/* default */
+#define WORK_POOL_PRIO_HIGH		1	/* latency critical,
+						 * such as control plane */
+#define WORK_POOL_PRIO_BULK		2	/* large data transfers */
+#define WORK_POOL_PRIO_MAX		3
 
 struct work_pool_entry {
 	struct poolq_entry pqe;		/*** 1st ***/
 	work_pool_fun_t fun;
 	void *arg;
+	uint32_t prio;
+	uint64_t enqueued;		/* ELASTIC: submit time (ns) */
 };
 
+/* work_pool_params flags */
+#define WORK_POOL_FLAG_NONE		0x0000
+#define WORK_POOL_FLAG_STEAL		0x0001	/* per-worker queues, idle
+						 * workers steal from others */
+#define WORK_POOL_FLAG_NUMA		0x0002	/* one pool per NUMA node,
+						 * with node pinned workers */
+#define WORK_POOL_FLAG_RING		0x0004	/* lock-free ring before the
+						 * (lane) queue mutex */
+#define WORK_POOL_FLAG_PRIO		0x0008	/* queue per prio, weighted
+						 * dequeue; not with STEAL
+						 * or RING */
+#define WORK_POOL_FLAG_ELASTIC		0x0010	/* grow and shrink by queue
+						 * delay */
+
 struct work_pool_params {
 	int32_t thrd_max;
 	int32_t thrd_min;
+	uint32_t flags;
+	uint32_t spin_max_ns;		/* idle worker spins up to this long
+					 * before parking, 0: never */
+	uint32_t prio_weight[WORK_POOL_PRIO_MAX];
+					/* tasks per round, 0: default */
+	uint32_t idle_max_ms;		/* idle worker exits (above thrd_min)
+					 * after this long, 0: 120 s */
+	uint32_t idle_min_ms;		/* ELASTIC: may exit after this long,
+					 * when not needed, 0: idle_max_ms */
+	uint32_t delay_max_us;		/* ELASTIC: grow above this average
+					 * queue delay, 0: 1 ms */
+	work_pool_idle_t idle;		/* called by a worker that waited
+					 * idle_ms without a task, NULL: none */
 };
 
-struct work_pool {
+#define WORK_POOL_DELAY_BUCKETS		24
+
+struct work_pool_stats {
+	uint64_t spawned;		/* threads started */
+	uint64_t exited;		/* threads finished */
+	uint64_t spin_hits;		/* task arrived while spinning */
+	uint64_t spin_misses;		/* parked after spinning */
+	uint64_t delay[WORK_POOL_DELAY_BUCKETS];
+					/* ELASTIC: tasks by queue delay,
+					 * [0] < 1 us, [n] < 2^n us */
+
+	/* only filled by work_pool_get_stats() */
+	uint64_t delay_avg_ns;		/* ELASTIC */
+	uint32_t n_threads;
+	uint32_t n_idle;		/* waiting for tasks */
+	uint32_t depth;			/* tasks queued */
+};
+
+/* WORK_POOL_FLAG_STEAL: one queue per worker (modulo n_lanes), each on its
+ * own cache line, so that submitters and workers rarely share a mutex.
+ */
+struct work_pool_lane {
 	struct poolq_head pqh;
+	CACHE_PAD(0);
+};
+
+struct work_pool {
+	struct poolq_head pqh;		/* tasks, or waiting workers;
+					 * STEAL: only waiting workers */
 	char *name;
 	pthread_attr_t attr;
 	struct work_pool_params params;
 	uint32_t n_threads;
+	struct work_pool_stats stats;
+
+	/* WORK_POOL_FLAG_ELASTIC */
+	uint64_t delay_ns;		/* average queue delay */
+	uint32_t spawn_last_ms;
+
+	/* params.spin_max_ns */
+	uint64_t arrival_ns;		/* average time between submits */
+	uint64_t arrival_last;
+	uint32_t spin_cap_ns;		/* tuned by hits and misses */
+	uint32_t n_spinning;
+	uint32_t n_parked;		/* without spinning, probe now and then */
+
+	/* WORK_POOL_FLAG_PRIO */
+	struct q_head prio_qh[WORK_POOL_PRIO_MAX];
+	uint32_t prio_credit[WORK_POOL_PRIO_MAX];
+
+	/* WORK_POOL_FLAG_STEAL */
+	struct work_pool_lane *lanes;
+	uint32_t n_lanes;
+	uint32_t next_index;		/* worker lane assignment */
+	uint32_t n_idle;		/* parked on pqh */
+	uint32_t n_pending;		/* queued on lanes */
+
+	/* WORK_POOL_FLAG_NUMA */
+	struct work_pool *parts;	/* one per node, thrd_max split */
+	int16_t *cpu_node;		/* cpu number to parts index */
+	int16_t *node_part;		/* node number to parts index */
+	uint32_t n_parts;
 };
 
+/* work_pool_thread pqe.qflags */
+#define WORK_POOL_THREAD_WAITING	0x0001	/* queued on pool pqh */
+
 struct work_pool_thread {
 	struct poolq_entry pqe;		/*** 1st ***/
 	pthread_cond_t pqcond;
@@ -70,11 +168,15 @@ struct work_pool_thread {
 	struct work_pool *pool;
 	struct work_pool_entry *work;
 	pthread_t id;
+	uint64_t idle_since;		/* ELASTIC */
 	uint32_t worker_index;
 };
 
 int work_pool_init(struct work_pool *, const char *, struct work_pool_params *);
 int work_pool_submit(struct work_pool *, struct work_pool_entry *);
+int work_pool_submit_node(struct work_pool *, struct work_pool_entry *, int);
+int work_pool_submit_batch(struct work_pool *, struct work_pool_entry **, int);
+void work_pool_get_stats(struct work_pool *, struct work_pool_stats *);
 int work_pool_shutdown(struct work_pool *);
 
 #endif				/* WORK_POOL_H */
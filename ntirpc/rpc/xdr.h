@@ -144,6 +144,8 @@ typedef struct xdr_uio {
 } xdr_uio;
 
 /* Op flags */
+#define XDR_GETBUFS_FLAG_NONE    0x0000
+
 #define XDR_PUTBUFS_FLAG_NONE    0x0000
 #define XDR_PUTBUFS_FLAG_RDNLY   0x0001
 
@@ -179,7 +181,7 @@ typedef struct rpc_xdr {
 		void (*x_destroy)(struct rpc_xdr *);
 		bool (*x_control)(struct rpc_xdr *, int, void *);
 		/* new vector and refcounted interfaces */
-		bool (*x_getbufs)(struct rpc_xdr *, xdr_uio *, u_int);
+		bool (*x_getbufs)(struct rpc_xdr *, xdr_uio *, u_int, u_int);
 		bool (*x_putbufs)(struct rpc_xdr *, xdr_uio *, u_int);
 	} *x_ops;
 	void *x_public; /* users' data */
@@ -287,6 +289,14 @@ xdr_putlong(XDR *xdrs, const long *lp)
 #define xdr_putbytes(xdrs, addr, len)			\
 	(*(xdrs)->x_ops->x_putbytes)(xdrs, addr, len)
 
+/*
+ * XDR_GETBUFS: receive len bytes into buffers the caller supplies, the
+ * uio vectors filled from vio_tail up to vio_wrap; no pooled segments
+ * are lent.  On xdr_inrec, bytes already read ahead are copied out of
+ * the stream buffer, and only the rest read directly from the socket;
+ * on SVC_INIT_VC_ET xprts without SVC_INIT_VC_IOQ_RECV, every byte is
+ * one copy out of the xprt's receive ring.
+ */
 #define XDR_GETBUFS(xdrs, uio, len, flags)		\
 	(*(xdrs)->x_ops->x_getbufs)(xdrs, uio, len, flags)
 #define xdr_getbufs(xdrs, uio, len, flags)		\
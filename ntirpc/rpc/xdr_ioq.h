@@ -121,6 +121,41 @@ extern void xdr_ioq_setup(struct xdr_ioq *xioq);
 extern void xdr_ioq_destroy(struct xdr_ioq *xioq, size_t qsize);
 extern void xdr_ioq_destroy_pool(struct poolq_head *ioqh);
 
+/*
+ * Segment cache: free segments of each size class are kept in per-thread
+ * magazines, exchanged whole with a global depot.  Larger sizes are not
+ * cached.  At most 64 MiB in the depots, and 6 MiB held by each thread
+ * until it exits or calls xdr_ioq_cache_flush_thread().  svc_work_pool
+ * workers call it when idle for their timeout, and event channel threads
+ * (which release segments of the connections they receive on) when their
+ * wait times out; a busy event channel thread keeps its 6 MiB.
+ */
+#define XDR_IOQ_CACHE_4K	0
+#define XDR_IOQ_CACHE_8K	1
+#define XDR_IOQ_CACHE_64K	2
+#define XDR_IOQ_CACHE_1M	3
+#define XDR_IOQ_CACHE_CLASSES	4
+
+struct xdr_ioq_cache_stats {
+	uint64_t allocs;	/* segments taken */
+	uint64_t hits;		/* ... from a magazine */
+	uint64_t misses;	/* ... newly allocated */
+	uint64_t frees;		/* segments returned */
+	uint64_t releases;	/* ... and freed, the depot full */
+	uint64_t depot;		/* magazines exchanged with the depot */
+};
+
+extern struct xdr_ioq_uv *xdr_ioq_cache_get(u_int size);
+extern struct poolq_entry *xdr_ioq_cache_fetch(struct xdr_ioq *xioq,
+						struct poolq_head *ioqh,
+						char *comment,
+						u_int count,
+						u_int ioq_flags);
+extern XDR *xdr_ioq_cache_create(u_int min_bsize, u_int max_bsize);
+extern void xdr_ioq_cache_stats(struct xdr_ioq_cache_stats
+				stats[XDR_IOQ_CACHE_CLASSES]);
+extern void xdr_ioq_cache_flush_thread(void);
+
 extern const struct xdr_ops xdr_ioq_ops;
 
 #endif				/* XDR_IOQ_H */
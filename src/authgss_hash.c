@@ -173,12 +173,28 @@ authgss_ctx_hash_get(struct rpc_gss_cred *gc)
 	return (gd);
 }
 
+/*
+ * svc_idle_wheel callback, at gd->endtime.  Still cached, as removal
+ * cancels it (waiting for it if running), so gd is valid here.
+ */
+static void
+authgss_ctx_expire(struct timer_wheel_entry *twe)
+{
+	struct svc_rpc_gss_data *gd =
+		opr_containerof(twe, struct svc_rpc_gss_data, expire);
+
+	__warnx(TIRPC_DEBUG_FLAG_RPCSEC_GSS,
+		"%s: gd %p expired", __func__, gd);
+	(void)authgss_ctx_hash_del(gd);
+}
+
 bool
 authgss_ctx_hash_set(struct svc_rpc_gss_data *gd)
 {
 	struct rbtree_x_part *t;
 	struct authgss_x_part *axp;
 	gss_union_ctx_id_desc *gss_ctx;
+	int64_t endtime;
 	bool rslt;
 
 	cond_init_authgss_hash();
@@ -196,6 +212,12 @@ authgss_ctx_hash_set(struct svc_rpc_gss_data *gd)
 	axp = (struct authgss_x_part *)t->u1;
 	TAILQ_INSERT_TAIL(&axp->lru_q, gd, lru_q);
 	++(axp->size);
+
+	/* expiry */
+	endtime = (int64_t)gd->endtime - get_time_fast();
+	gd->expire.fun = authgss_ctx_expire;
+	timer_wheel_add(&svc_idle_wheel, &gd->expire,
+			endtime > 0 ? endtime * 1000 : 0);
 	mutex_unlock(&t->mtx);
 
 	/* global size */
@@ -237,27 +259,24 @@ authgss_ctx_hash_del(struct svc_rpc_gss_data *gd)
 	/* global size */
 	(void)atomic_dec_uint32_t(&authgss_hash_st.size);
 
+	/* unless called from it */
+	(void)timer_wheel_del(&svc_idle_wheel, &gd->expire);
+
 	/* release gd */
 	unref_svc_rpc_gss_data(gd, SVC_RPC_GSS_FLAG_NONE);
 
 	return (true);
 }
 
-static inline bool
-authgss_ctx_expired(struct svc_rpc_gss_data *gd)
-{
-	OM_uint32 maj_stat, min_stat;
-	maj_stat =
-	    gss_inquire_context(&min_stat, gd->ctx, NULL, NULL, NULL, NULL,
-				NULL, NULL, NULL);
-	return (maj_stat == GSS_S_CONTEXT_EXPIRED);
-}
-
 static uint32_t idle_next;
 
 #define IDLE_NEXT() \
 	(atomic_inc_uint32_t(&(idle_next)) % authgss_hash_st.xt.npart)
 
+/*
+ * Trim partitions over their size limit.  Expired contexts are removed
+ * from svc_idle_wheel, without a scan; both run from __svc_clean_idle2().
+ */
 void authgss_ctx_gc_idle(void)
 {
 	struct rbtree_x_part *xp;
@@ -280,10 +299,8 @@ void authgss_ctx_gc_idle(void)
 			goto next_t;
 
 		/* Remove the least-recently-used entry in this hash
-		 * partition iff it is expired, or the partition size
-		 * limit is exceeded */
-		if (unlikely((axp->size > authgss_hash_st.max_part)
-				|| (authgss_ctx_expired(gd)))) {
+		 * partition iff the partition size limit is exceeded */
+		if (unlikely(axp->size > authgss_hash_st.max_part)) {
 
 			/* remove entry */
 			rbtree_x_cached_remove(&authgss_hash_st.xt, xp,
@@ -293,6 +310,9 @@ void authgss_ctx_gc_idle(void)
 			--(axp->size);
 			(void)atomic_dec_uint32_t(&authgss_hash_st.size);
 
+			/* never waits, expiry runs in this thread */
+			(void)timer_wheel_del(&svc_idle_wheel, &gd->expire);
+
 			/* drop sentinel ref (may free gd) */
 			unref_svc_rpc_gss_data(gd, SVC_RPC_GSS_FLAG_NONE);
 
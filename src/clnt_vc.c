@@ -369,6 +369,8 @@ clnt_vc_call(CLIENT *clnt, AUTH *auth, rpcproc_t proc,
 			rpc_dplx_rui(rec);
 			return (RPC_TIMEDOUT);
 		}
+		/* the reply may be a received xdr_ioq, see svc_vc_recv() */
+		xdrs = svc_vc_xdrs_in(xd);
 	} else {
 		xdrs->x_lib[0] = (void *)ctx; /* transiently thread ctx */
 		/*
@@ -151,15 +151,20 @@ NTIRPC_${NTIRPC_VERSION} {
     svc_exit;
     svc_fd_ncreatef;
     svc_init;
+    svc_ioq_output_stats;
     svc_ncreate;
     svc_raw_ncreate;
     svc_rdma_ncreate;
     svc_reg;
     svc_register;
     svc_rqst_new_evchan;
+    svc_rqst_evchan_migrate;
     svc_rqst_evchan_reg;
+    svc_rqst_evchan_stats;
     svc_rqst_evchan_unreg;
     svc_rqst_rearm_events;
+    svc_rqst_requeue;
+    svc_rqst_submit;
     svc_rqst_thrd_run;
     svc_rqst_thrd_signal;
     svc_run;
@@ -171,7 +176,9 @@ NTIRPC_${NTIRPC_VERSION} {
     svc_unreg;
     svc_unregister;
     svc_validate_xprt_list;
+    svc_vc_ncreate_reuseport;
     svc_vc_ncreatef;
+    svc_xprt_local;
     svc_xprt_trace;
     svcauth_gss_acquire_cred;
     svcauth_gss_destroy;
@@ -202,6 +209,14 @@ NTIRPC_${NTIRPC_VERSION} {
     # u*
     uaddr2taddr;
 
+    # w*
+    work_pool_get_stats;
+    work_pool_init;
+    work_pool_shutdown;
+    work_pool_submit;
+    work_pool_submit_batch;
+    work_pool_submit_node;
+
     # x*
     xdr_array;
     xdr_authunix_parms;
@@ -227,6 +242,11 @@ NTIRPC_${NTIRPC_VERSION} {
     xdr_int16_t;
     xdr_int32_t;
     xdr_int64_t;
+    xdr_ioq_cache_flush_thread;
+    xdr_ioq_cache_get;
+    xdr_ioq_cache_stats;
+    xdr_ioq_uv_create;
+    xdr_ioq_uv_release;
     xdr_long;
     xdr_longlong_t;
     xdr_naccepted_reply;
@@ -119,14 +119,29 @@ static struct svc_callout *svc_find(rpcprog_t, rpcvers_t, struct svc_callout **,
 
 struct work_pool svc_work_pool;
 
+/* no task for a timeout, leave cached segments to busy threads */
+static void
+svc_work_pool_idle(struct work_pool *pool)
+{
+	xdr_ioq_cache_flush_thread();
+}
+
 static int
 svc_work_pool_init()
 {
 	struct work_pool_params params = {
 		.thrd_max = __svc_params->ioq.thrd_max,
-		.thrd_min = 2
+		.thrd_min = 2,
+		.idle = svc_work_pool_idle
 	};
 
+	if (__svc_params->flags & SVC_FLAG_NUMA)
+		params.flags |= WORK_POOL_FLAG_NUMA;
+
+	/* dispatchers may mark latency critical work prio HIGH */
+	if (__svc_params->flags & SVC_FLAG_WORK_PRIO)
+		params.flags |= WORK_POOL_FLAG_PRIO;
+
 	return work_pool_init(&svc_work_pool, "svc_work_pool", &params);
 }
 
@@ -181,10 +196,67 @@ svc_init(svc_init_params *params)
 	__svc_params->svc_ioq_maxbuf =
 	    (params->svc_ioq_maxbuf) ? (params->svc_ioq_maxbuf) : 262144;
 
+	/* run small, nonblocking calls to completion on the event thread */
+	__svc_params->inline_max = params->inline_max;
+	__svc_params->nonblock = params->nonblock;
+
+	/* SVC_RQST_FLAG_BUSY_POLL channels */
+	__svc_params->busy_poll_us = params->busy_poll_us;
+	__svc_params->busy_poll_napi_us = params->busy_poll_napi_us;
+
+	/* fairness between xprts with queued requests */
+	__svc_params->getreq_budget =
+	    (params->getreq_budget) ? (params->getreq_budget)
+	    : SVC_GETREQ_BUDGET;
+
+	/* stop reading from clients not reading their replies */
+	__svc_params->ioq_hiwat =
+	    (params->ioq_hiwat) ? (params->ioq_hiwat)
+	    : 4 * __svc_params->svc_ioq_maxbuf;
+	__svc_params->ioq_lowat =
+	    (params->ioq_lowat && params->ioq_lowat < __svc_params->ioq_hiwat)
+	    ? (params->ioq_lowat) : __svc_params->ioq_hiwat / 4;
+
+	__svc_params->zerocopy_min =
+	    (params->zerocopy_min) ? (params->zerocopy_min)
+	    : SVC_IOQ_ZEROCOPY_MIN;
+
 	/* allow consumers to manage all xprt registration */
 	if (params->flags & SVC_INIT_NOREG_XPRTS)
 		__svc_params->flags |= SVC_FLAG_NOREG_XPRTS;
 
+	/* partition the work pool by NUMA node */
+	if (params->flags & SVC_INIT_NUMA)
+		__svc_params->flags |= SVC_FLAG_NUMA;
+
+	/* priority classes in the work pool, by xprt and by call */
+	if (params->flags & SVC_INIT_WORK_PRIO) {
+		__svc_params->flags |= SVC_FLAG_WORK_PRIO;
+		__svc_params->classify = params->classify;
+	}
+
+	if (params->flags & SVC_INIT_VC_ET)
+		__svc_params->flags |= SVC_FLAG_VC_ET;
+
+	/* consumers read xp_local only by svc_xprt_local() */
+	if (params->flags & SVC_INIT_LAZY_LOCAL)
+		__svc_params->flags |= SVC_FLAG_LAZY_LOCAL;
+
+	if (params->flags & SVC_INIT_IOQ_IFQ)
+		__svc_params->flags |= SVC_FLAG_IOQ_IFQ;
+
+	/* edge triggered only: completions are reaped at EPOLLERR */
+	if ((params->flags & SVC_INIT_ZEROCOPY)
+	 && (params->flags & SVC_INIT_VC_ET))
+		__svc_params->flags |= SVC_FLAG_ZEROCOPY;
+
+	/* drained by edge triggered receive only */
+	if ((params->flags & SVC_INIT_VC_IOQ_RECV)
+	 && (params->flags & SVC_INIT_VC_ET)) {
+		__svc_params->flags |= SVC_FLAG_VC_IOQ_RECV;
+		svc_ioq_segs_init();
+	}
+
 	if (params->ioq_thrd_max)
 		__svc_params->ioq.thrd_max = params->ioq_thrd_max;
 	else
@@ -838,18 +910,122 @@ svc_dispatch_default(SVCXPRT *xprt, struct rpc_msg **ind_msg)
 	}
 }
 
-bool
-svc_getreq_default(SVCXPRT *xprt)
+/*
+ * After getreq_budget requests, give other xprts a turn.  On requeue,
+ * the xprt (with its ref) goes to the back of its channel's work; if it
+ * has none, keep going.  A client not reading its replies is parked
+ * (with the ref) until its output drains.
+ */
+static inline bool
+svc_getreq_yield(SVCXPRT *xprt, u_int n, u_int budget)
+{
+	if (svc_ioq_throttle(xprt, XPRT_MOREREQS))
+		return (true);
+	return (n >= budget && !svc_rqst_requeue(xprt));
+}
+
+/* svc_getreq_run() flags */
+#define SVC_GETREQ_FLAG_NONE	0x0000
+#define SVC_GETREQ_FLAG_PENDING	0x0001	/* req already received */
+#define SVC_GETREQ_FLAG_INLINE	0x0002	/* on the event thread */
+
+/*
+ * svc_classify_t (or svc_nonblock_t, inline): a call set aside for a task
+ * of its class (or the xprt's), with the ref
+ * of the getreq that read it, and the receive lock SVC_RECV() took.
+ */
+struct svc_getreq_class {
+	struct work_pool_entry wpe;	/*** 1st ***/
+	struct svc_req req;
+	bool locked;
+};
+
+static enum xprt_stat svc_getreq_run(struct svc_req *, uint32_t, uint32_t);
+
+static void
+svc_getreq_class_task(struct work_pool_entry *wpe)
+{
+	struct svc_getreq_class *gc = (struct svc_getreq_class *)wpe;
+
+	if (gc->locked)
+		rpc_dplx_rli(REC_XPRT(gc->req.rq_xprt));
+	(void)svc_getreq_run(&gc->req, wpe->prio, SVC_GETREQ_FLAG_PENDING);
+	mem_free(gc, sizeof(*gc));
+}
+
+/*
+ * Hand the call just read over to a task of class.
+ *
+ * @return true when handed over.
+ */
+static bool
+svc_getreq_handoff(struct svc_req *req, uint32_t class)
 {
+	SVCXPRT *xprt = req->rq_xprt;
+	struct svc_getreq_class *gc;
+
+	gc = mem_alloc(sizeof(*gc));
+	memset(&gc->wpe, 0, sizeof(gc->wpe));
+	gc->wpe.fun = svc_getreq_class_task;
+	gc->wpe.prio = class;
+	gc->req = *req;
+
+	/* held from SVC_RECV() to SVC_STAT(), now across threads; other
+	 * readers still wait for SVC_XPRT_FLAG_BLOCKED
+	 */
+	gc->locked = !!(atomic_fetch_uint16_t(&xprt->xp_flags)
+			& SVC_XPRT_FLAG_BLOCKED);
+	if (gc->locked)
+		rpc_dplx_rui(REC_XPRT(xprt));
+
+	if (!svc_rqst_submit(xprt, &gc->wpe))
+		return (true);
+
+	if (gc->locked)
+		rpc_dplx_rli(REC_XPRT(xprt));
+	mem_free(gc, sizeof(*gc));
+	return (false);
+}
+
+/*
+ * Class the call just read; when not that of the calling task, hand it
+ * over to a task of its class.
+ *
+ * @return true when handed over.
+ */
+static inline bool
+svc_getreq_classify(struct svc_req *req, uint32_t prio)
+{
+	uint32_t class = __svc_params->classify(req);
+
+	if (class == prio || class >= WORK_POOL_PRIO_MAX)
+		return (false);
+	return (svc_getreq_handoff(req, class));
+}
+
+/*
+ * Receive and dispatch calls, from a task of class prio.  With
+ * SVC_GETREQ_FLAG_PENDING, req was already received (and classed).  With
+ * SVC_GETREQ_FLAG_INLINE, one call at most: any after it, and one
+ * svc_init_params nonblock does not accept, continue in svc_work_pool.
+ */
+static enum xprt_stat
+svc_getreq_run(struct svc_req *req, uint32_t prio, uint32_t flags)
+{
+	SVCXPRT *xprt = req->rq_xprt;
 	enum xprt_stat stat;
-	struct svc_req req = {.rq_xprt = xprt };
+	bool pending = !!(flags & SVC_GETREQ_FLAG_PENDING);
 	bool no_dispatch = false;
+	bool requeued = false;
+	u_int budget = (flags & SVC_GETREQ_FLAG_INLINE)
+		     ? 1 : __svc_params->getreq_budget;
+	u_int n = 0;
 
 	/* XXX !MT-SAFE */
 
 	/* now receive msgs from xprt (support batch calls) */
 	do {
-		if (SVC_RECV(&req)) {
+		if (pending || SVC_RECV(req)) {
 
 			/* now find the exported program and call it */
 			svc_vers_range_t vrange;
@@ -857,33 +1033,45 @@ svc_getreq_default(SVCXPRT *xprt)
 			svc_rec_t *svc_rec;
 			enum auth_stat why;
 
+			/* continues in a task of its class? */
+			if (!pending && __svc_params->classify
+			 && svc_getreq_classify(req, prio))
+				return (XPRT_IDLE);
+
+			/* or may block the event thread? */
+			if (!pending && (flags & SVC_GETREQ_FLAG_INLINE)
+			 && !__svc_params->nonblock(req)
+			 && svc_getreq_handoff(req, prio))
+				return (XPRT_IDLE);
+			pending = false;
+
 			/* first authenticate the message */
-			why = svc_auth_authenticate(&req, &no_dispatch);
+			why = svc_auth_authenticate(req, &no_dispatch);
 			if ((why != AUTH_OK) || no_dispatch) {
-				svcerr_auth(&req, why);
+				svcerr_auth(req, why);
 				goto call_done;
 			}
 
 			lkp_res =
-			    svc_lookup(&svc_rec, &vrange, req.rq_msg.cb_prog,
-				       req.rq_msg.cb_vers, NULL, 0);
+			    svc_lookup(&svc_rec, &vrange, req->rq_msg.cb_prog,
+				       req->rq_msg.cb_vers, NULL, 0);
 			switch (lkp_res) {
 			case SVC_LKP_SUCCESS:
-				(*svc_rec->sc_dispatch) (&req);
+				(*svc_rec->sc_dispatch) (req);
 				goto call_done;
 				break;
 			case SVC_LKP_VERS_NOTFOUND:
 				__warnx(TIRPC_DEBUG_FLAG_SVC,
 					"%s: dispatch prog vers notfound\n",
 					__func__);
-				svcerr_progvers(&req, vrange.lowvers,
+				svcerr_progvers(req, vrange.lowvers,
 						vrange.highvers);
 				break;
 			default:
 				__warnx(TIRPC_DEBUG_FLAG_SVC,
 					"%s: dispatch prog notfound\n",
 					__func__);
-				svcerr_noprog(&req);
+				svcerr_noprog(req);
 				break;
 			}
 
@@ -895,8 +1083,11 @@ svc_getreq_default(SVCXPRT *xprt)
 			__warnx(TIRPC_DEBUG_FLAG_SVC,
 				"%s: stat == XPRT_DIED (%p)\n", __func__,
 				xprt);
-			SVC_DESTROY(xprt);
-			SVC_RELEASE(xprt, SVC_RELEASE_FLAG_NONE);
+			/* else the writer has the ref */
+			if (!svc_ioq_linger(xprt)) {
+				SVC_DESTROY(xprt);
+				SVC_RELEASE(xprt, SVC_RELEASE_FLAG_NONE);
+			}
 			xprt = 0;
 			break;
 
@@ -913,16 +1104,40 @@ svc_getreq_default(SVCXPRT *xprt)
 			}
 		}
 
-	} while (stat == XPRT_MOREREQS);
+	} while (stat == XPRT_MOREREQS
+		 && !(requeued = svc_getreq_yield(xprt, ++n, budget)));
 
-	if (xprt) {
-		svc_rqst_rearm_events(xprt, SVC_RQST_FLAG_NONE);
+	if (xprt && !requeued) {
+		if (!svc_ioq_throttle(xprt, stat))
+			svc_rqst_rearm_events(xprt, SVC_RQST_FLAG_NONE);
 		SVC_RELEASE(xprt, SVC_RELEASE_FLAG_NONE);
 	}
 
 	return (stat);
 }
 
+bool
+svc_getreq_default(SVCXPRT *xprt)
+{
+	struct svc_req req = {.rq_xprt = xprt };
+
+	return (svc_getreq_run(&req, xprt->xp_wpe.prio,
+			       SVC_GETREQ_FLAG_NONE));
+}
+
+/*
+ * inline_max: svc_getreq_default() on the event thread, for a record
+ * already received whole (see svc_vc_inline_ready()).
+ */
+bool
+svc_getreq_inline(SVCXPRT *xprt)
+{
+	struct svc_req req = {.rq_xprt = xprt };
+
+	return (svc_getreq_run(&req, xprt->xp_wpe.prio,
+			       SVC_GETREQ_FLAG_INLINE));
+}
+
 bool
 rpc_control(int what, void *arg)
 {
@@ -945,13 +1160,48 @@ rpc_control(int what, void *arg)
 	return (true);
 }
 
+/*
+ * With SVC_INIT_LAZY_LOCAL, rendezvous_request() leaves xp_local of the
+ * connections it accepts unset, saving a getsockname() per connection
+ * that is rarely used.
+ */
+struct rpc_address *
+svc_xprt_local(SVCXPRT *xprt)
+{
+	struct sockaddr_storage ss;
+	socklen_t len = sizeof(ss);
+
+	if (likely(atomic_fetch_voidptr(&xprt->xp_local.nb.buf)))
+		return (&xprt->xp_local);
+
+	mutex_lock(&xprt->xp_lock);
+	if (!xprt->xp_local.nb.buf) {
+		if (getsockname(xprt->xp_fd, (struct sockaddr *)&ss, &len) < 0) {
+			__warnx(TIRPC_DEBUG_FLAG_SVC,
+				"%s: fd %d getsockname failed (%d)",
+				__func__, xprt->xp_fd, errno);
+			len = sizeof(ss);
+			memset(&ss, 0xfe, len);
+		}
+		memcpy(&xprt->xp_local.ss, &ss, sizeof(ss));
+		xprt->xp_local.nb.len = len;
+		xprt->xp_local.nb.maxlen = sizeof(ss);
+		/* last, others may look without the lock */
+		atomic_store_voidptr(&xprt->xp_local.nb.buf,
+				     &xprt->xp_local.ss);
+	}
+	mutex_unlock(&xprt->xp_lock);
+
+	return (&xprt->xp_local);
+}
+
 #if defined(HAVE_BLKIN)
 void __rpc_set_blkin_endpoint(SVCXPRT *xprt, const char *tag)
 {
 	struct sockaddr_in *salocal_in;
 	struct sockaddr_in6 *salocal_in6;
 	struct sockaddr *salocal =
-		(struct sockaddr *)&xprt->xp_local.ss;
+		(struct sockaddr *)&svc_xprt_local(xprt)->ss;
 	char saddr[INET6_ADDRSTRLEN];
 	int xp_port = 0;
 
@@ -1008,6 +1258,9 @@ svc_shutdown(u_long flags)
 	/* release request event channels */
 	svc_rqst_shutdown();
 
+	/* free the svc_vc_xprts kept for reuse */
+	svc_vc_xprt_pool_drain();
+
 	/* XXX assert quiescent */
 
 	return (code);
@@ -563,6 +563,14 @@ svc_dg_control(SVCXPRT *xprt, const u_int rq, void *in)
 		xprt->xp_ops->xp_free_user_data = *(xp_free_user_data_t) in;
 		mutex_unlock(&ops_lock);
 		break;
+	case SVCGET_XP_PRIO:
+		*(uint32_t *)in = xprt->xp_wpe.prio;
+		break;
+	case SVCSET_XP_PRIO:
+		if (*(uint32_t *)in >= WORK_POOL_PRIO_MAX)
+			return (false);
+		xprt->xp_wpe.prio = *(uint32_t *)in;
+		break;
 	default:
 		return (false);
 	}
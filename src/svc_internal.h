@@ -27,15 +27,60 @@
 #define TIRPC_SVC_INTERNAL_H
 
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 #include <misc/os_epoll.h>
+#include <misc/timer_wheel.h>
 #include <rpc/rpc_msg.h>
+#include <rpc/xdr_ioq.h>
 
 #include "rpc_dplx_internal.h"
 
 extern int __svc_maxiov;
 extern int __svc_maxrec;
 
+/* svc_getreq_default() requests per xprt, before requeue */
+#define SVC_GETREQ_BUDGET 16
+
+/* svc_vc_xprt ioq_parked: input stopped at ioq_hiwat, resumed by */
+#define SVC_IOQ_PARK_NONE	0
+#define SVC_IOQ_PARK_REARM	1	/* svc_rqst_rearm_events() */
+#define SVC_IOQ_PARK_GETREQ	2	/* svc_rqst_requeue(), holds a ref */
+#define SVC_IOQ_PARK_DESTROY	3	/* at the last record, holds a ref */
+
+#define SVC_IOQ_ZEROCOPY_MIN (64 * 1024)
+#define SVC_IOQ_ZEROCOPY_LINGER_MS (100)
+
+/* records buffered by SVC_XPRT_FLAG_EDGE receive without a maxrec */
+#define SVC_VC_MAXREC_BUFS 16	/* of svc_ioq_maxbuf */
+
+#define SVC_IOQ_IOV_INLINE 32
+#define SVC_IOQ_HDR_INLINE (SVC_IOQ_IOV_INLINE / 2)
+
+/* MSG_ZEROCOPY output, held until its completion */
+struct svc_ioq_zc_hold;
+TAILQ_HEAD(svc_ioq_zc_head, svc_ioq_zc_hold);
+
+/* records written together, partly written until EPOLLOUT */
+struct svc_ioq_out {
+	struct xdr_ioq *xioq;	/* first record, NULL: none */
+	struct q_head more;	/* the others, off ioq.qh */
+	u_int records;
+	u_int bytes;		/* in the records */
+	struct iovec *iov;	/* fragment headers and data */
+	uint32_t *headers;
+	u_int vsize;		/* allocated iov and headers, 0: inline */
+	int ix;			/* iov used */
+	int iw;			/* next iov to write */
+	int ih;			/* headers used */
+	u_int sends;		/* sendmsg() calls */
+	u_int zc_sends;		/* ... with MSG_ZEROCOPY */
+	bool zerocopy;
+	size_t remaining;
+	struct iovec iov_inline[SVC_IOQ_IOV_INLINE];
+	uint32_t hdr_inline[SVC_IOQ_HDR_INLINE];
+};
+
 /* threading fdsets around is annoying */
 struct svc_params {
 	bool initialized;
@@ -58,6 +103,15 @@ struct svc_params {
 	int32_t idle_timeout;
 	u_int max_connections;
 	u_int svc_ioq_maxbuf;
+	u_int inline_max;
+	u_int busy_poll_us;
+	u_int busy_poll_napi_us;
+	u_int getreq_budget;
+	u_int ioq_hiwat;
+	u_int ioq_lowat;
+	u_int zerocopy_min;
+	svc_classify_t classify;
+	svc_nonblock_t nonblock;
 
 	union {
 		struct {
@@ -80,6 +134,9 @@ struct svc_params {
 
 extern struct svc_params __svc_params[1];
 
+/* idle xprts and GSS contexts, advanced by __svc_clean_idle2() */
+extern struct timer_wheel svc_idle_wheel;
+
 #define svc_cond_init()	\
 	do { \
 		if (!__svc_params->initialized) { \
@@ -219,6 +276,44 @@ struct svc_dg_xprt {
 #define DG_DR(p) (opr_containerof((p), struct svc_dg_xprt, su_dr))
 #define su_data(xprt) (DG_DR(REC_XPRT(xprt)))
 
+/**
+ * \struct svc_vc_ring
+ * SVC_XPRT_FLAG_EDGE receive buffer
+ *
+ * Offsets into base.  Bytes before ready are whole records, fed to
+ * xdrs_in by svc_read_vc(); recs of them are not yet started.
+ */
+struct svc_vc_ring {
+	char *base;
+	u_int size;
+	u_int head;	/* next byte to xdrs_in */
+	u_int ready;	/* end of the last complete record */
+	u_int scan;	/* next fragment header */
+	u_int tail;	/* end of the bytes read */
+	u_int recs;	/* complete records not yet received */
+};
+
+/**
+ * \struct svc_vc_segs
+ * SVC_XPRT_FLAG_EDGE receive segments, SVC_INIT_VC_IOQ_RECV
+ *
+ * Segments read into, oldest first; scan is in the first.  Views of the
+ * record data, without fragment headers, make up each record's xdr_ioq.
+ */
+struct svc_vc_segs {
+	struct q_head qh;	/* read into, held by the reader */
+	struct q_head recs;	/* complete records (ioq_s), to receive */
+	struct xdr_ioq *rec;	/* record being read, NULL: none */
+	char *scan;		/* next byte to parse */
+	char *mark;		/* first record byte not yet in a view */
+	uint32_t header;	/* fragment header, host order */
+	u_int hlen;		/* header bytes read, < 4: in the header */
+	u_int fbtbc;		/* fragment bytes to be consumed */
+	u_int rlen;		/* record bytes read */
+	u_int ready;		/* record bytes complete, to receive */
+	u_int nrecs;		/* complete records, to receive */
+};
+
 /**
  * \struct svc_vc_xprt
  * VC transport instance
@@ -228,6 +323,7 @@ struct svc_dg_xprt {
  */
 struct svc_vc_xprt {
 	struct rpc_dplx_rec sx_dr;	/* SVCXPRT indexed by fd */
+	SLIST_ENTRY(svc_vc_xprt) sx_pool;	/* free, svc_vc_xprt_pool */
 	struct {
 		struct {
 			uint32_t xid;	/* current xid */
@@ -239,17 +335,39 @@ struct svc_vc_xprt {
 	struct {
 		enum xprt_stat strm_stat;
 		struct timespec last_recv;	/* XXX move to shared? */
+		struct timer_wheel_entry idle;	/* svc_idle_wheel */
 		int32_t maxrec;
 	} sx;
 	struct {
 		XDR xdrs_in;	/* recv queue */
+		struct svc_vc_ring ring;	/* SVC_XPRT_FLAG_EDGE */
+		struct svc_vc_segs segs;	/* ... with ioq_recv */
+		struct xdr_ioq *xioq_in;	/* record received, ioq_recv */
+		struct poolq_head ioq;	/* output, see svc_ioq_write() */
+		struct svc_ioq_out out;	/* elected writer only */
+		uint32_t ioq_bytes;	/* ioq.qmutex, read atomic */
+		uint32_t ioq_parked;	/* ioq.qmutex */
+		struct svc_ioq_zc_head zc_held;	/* ioq.qmutex */
+		uint32_t zc_next;	/* next MSG_ZEROCOPY id, writer only */
+		uint32_t zc_done;	/* ids completed below, ioq.qmutex */
+		bool zc_off;		/* SO_ZEROCOPY refused */
 		u_int sendsz;
 		u_int recvsz;
 		bool nonblock;
+		bool ioq_recv;	/* SVC_INIT_VC_IOQ_RECV */
 	} shared;
 };
 #define VC_DR(p) (opr_containerof((p), struct svc_vc_xprt, sx_dr))
 
+/* the stream the record received is decoded from */
+static inline XDR *
+svc_vc_xdrs_in(struct svc_vc_xprt *xd)
+{
+	if (xd->shared.xioq_in)
+		return (xd->shared.xioq_in->xdrs);
+	return (&xd->shared.xdrs_in);
+}
+
 /* Epoll interface change */
 #ifndef EPOLL_CLOEXEC
 #define EPOLL_CLOEXEC 02000000
@@ -271,5 +389,16 @@ extern void __rpc_set_blkin_endpoint(SVCXPRT *xprt, const char *tag);
 #endif
 
 void svc_rqst_shutdown(void);
+int svc_rqst_evchan_write(SVCXPRT *);
+void svc_vc_xprt_pool_drain(void);
+bool svc_vc_inline_ready(SVCXPRT *, int);
+bool svc_getreq_inline(SVCXPRT *);
+
+/* SVC_XPRT_FLAG_RECV_SEGS: segments received meanwhile; returns 0 while
+ * the channel receives, EAGAIN to read the socket (then call
+ * svc_rqst_recv_done()), or the connection's error (ESHUTDOWN at EOF)
+ */
+int svc_rqst_recv_take(SVCXPRT *, struct q_head *);
+void svc_rqst_recv_done(SVCXPRT *);
 
 #endif				/* TIRPC_SVC_INTERNAL_H */
@@ -23,6 +23,8 @@
  * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <config.h>
+
 #include <sys/cdefs.h>
 #include <sys/socket.h>
 #include <sys/types.h>
@@ -34,6 +36,7 @@
 #include <sys/uio.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
+#include <linux/errqueue.h>
 
 #include <assert.h>
 #include <err.h>
@@ -66,18 +69,16 @@
 #include <misc/opr.h>
 #include "svc_ioq.h"
 
-/* Queue per interface, determined per transport socket.
- *
- * Ideally, these would be some variant of weighted fair queuing.  Currently,
- * assuming supplied by underlying OS.
- *
- * The assigned thread should have affinity for the interface.  Therefore, the
- * first thread arriving for each interface is used for all subsequent work,
- * until the interface is idle.  This assumes that the output interface is
- * closely associated with the input interface.
+/* Output is queued per transport.  The first thread to queue output on an
+ * idle transport is elected its writer; others only append, and return.
+ * So replies to one client never wait behind another's, and a slow
+ * client holds only its own writer.
  *
- * Note that this is a static fixed size list of interfaces.  In most cases,
- * many of these entries will be unused.
+ * After SVC_IOQ_BUDGET records, the writer hands the rest to a work pool
+ * task (with the election), so one busy transport cannot keep the thread
+ * that happened to reply first.  With SVC_INIT_IOQ_IFQ, these busy
+ * transports instead take turns on a queue per interface, served by one
+ * task, SVC_IOQ_BUDGET records each.
  *
  * For efficiency, a mask is applied to the ifindex, possibly causing overlap of
  * multiple interfaces.  The size is selected to be larger than expected number
@@ -87,6 +88,111 @@
 #define IOQ_IF_MASK (IOQ_IF_SIZE - 1)
 struct poolq_head ioq_ifqh[IOQ_IF_SIZE];
 
+#define SVC_IOQ_BUDGET (16)	/* records per writer turn */
+
+static struct svc_ioq_stats svc_ioq_totals;
+
+/* MSG_ZEROCOPY (Linux 4.14), when the headers predate it */
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+#ifndef SO_EE_ORIGIN_ZEROCOPY
+#define SO_EE_ORIGIN_ZEROCOPY 5
+#define SO_EE_CODE_ZEROCOPY_COPIED 1
+#endif
+
+/*
+ * The buffers of records sent with MSG_ZEROCOPY, taken from them before
+ * XDR_DESTROY().  Released when the socket's error queue reports id
+ * (the last sendmsg() of the batch) complete.
+ */
+struct svc_ioq_zc_hold {
+	TAILQ_ENTRY(svc_ioq_zc_hold) q;
+	uint32_t id;
+	struct q_head uvq;
+	struct iovec *iov;	/* with the fragment headers */
+	u_int vsize;
+};
+
+/*
+ * SVC_INIT_VC_IOQ_RECV: page sized segments from the xdr_ioq cache, read
+ * into by svc_vc and decoded in place, then reused for replies.
+ */
+static u_int svc_ioq_seg_size;
+
+void
+svc_ioq_segs_init(void)
+{
+	long pagesize = sysconf(_SC_PAGESIZE);
+
+	svc_ioq_seg_size = (pagesize > 0) ? pagesize : 4096;
+}
+
+/**
+ * @brief Get an empty segment, with one reference
+ *
+ * Released by xdr_ioq_uv_release() in an xdr_ioq, or shared with views
+ * by svc_ioq_seg_unref().
+ */
+struct xdr_ioq_uv *
+svc_ioq_seg_get(void)
+{
+	return (xdr_ioq_cache_get(svc_ioq_seg_size));
+}
+
+/* a segment shared with views */
+void
+svc_ioq_seg_unref(struct xdr_ioq_uv *uv)
+{
+	if (!atomic_dec_int32_t(&uv->u.uio_references))
+		uv->u.uio_release(&uv->u, UIO_FLAG_NONE);
+}
+
+static void
+svc_ioq_seg_view_release(struct xdr_uio *uio, u_int flags)
+{
+	struct xdr_ioq_uv *seg = uio->uio_p2;
+
+	mem_free(IOQU(uio), sizeof(struct xdr_ioq_uv));
+	svc_ioq_seg_unref(seg);
+}
+
+/**
+ * @brief Reference bytes of a segment, for an xdr_ioq to decode
+ *
+ * Several records may share a segment read with one readv(); each has
+ * its own view, holding a reference on it.
+ */
+struct xdr_ioq_uv *
+svc_ioq_seg_view(struct xdr_ioq_uv *seg, void *head, void *tail)
+{
+	struct xdr_ioq_uv *uv = xdr_ioq_uv_create(0, UIO_FLAG_NONE);
+
+	uv->u.uio_p2 = seg;
+	uv->u.uio_release = svc_ioq_seg_view_release;
+	uv->v.vio_base = head;
+	uv->v.vio_head = head;
+	uv->v.vio_tail = tail;
+	uv->v.vio_wrap = tail;
+	atomic_inc_int32_t(&seg->u.uio_references);
+	return (uv);
+}
+
+/**
+ * @brief Create an output stream of page sized segments
+ *
+ * The segments of requests decoded return to the same cache, so replies
+ * reuse them.
+ */
+XDR *
+svc_ioq_seg_xdr_create(void)
+{
+	return (xdr_ioq_cache_create(svc_ioq_seg_size, svc_ioq_seg_size));
+}
+
 void
 svc_ioq_init(void)
 {
@@ -111,123 +217,422 @@ cfconn_set_dead(SVCXPRT *xprt)
 }
 
 #define LAST_FRAG ((u_int32_t)(1 << 31))
-#define MAXALLOCA (256)
 
-static inline void
-svc_ioq_flushv(SVCXPRT *xprt, struct xdr_ioq *xioq)
+/*
+ * Without an event channel to wait on, wait for room here, as a blocking
+ * write would.
+ */
+static inline bool
+svc_ioq_poll_out(SVCXPRT *xprt)
+{
+	struct pollfd pollfd = {
+		.fd = xprt->xp_fd,
+		.events = POLLOUT,
+	};
+	int milliseconds = 35 * 1000;	/* XXX as svc_read_vc() */
+
+	for (;;) {
+		switch (poll(&pollfd, 1, milliseconds)) {
+		case -1:
+			if (errno == EINTR)
+				continue;
+			return (false);
+		case 0:
+			return (false);
+		default:
+			return (true);
+		}
+	}
+}
+
+/* record length, after xdr_tail_update() */
+static inline u_int
+svc_ioq_length(struct xdr_ioq *xioq)
 {
-	struct iovec *iov, *tiov, *wiov;
 	struct poolq_entry *have;
-	struct xdr_ioq_uv *data;
-	ssize_t result;
-	u_int32_t frag_header;
-	u_int32_t fbytes;
-	u_int32_t remaining = 0;
-	u_int32_t vsize = (xioq->ioq_uv.uvqh.qcount + 1) * sizeof(struct iovec);
-	int iw = 0;
-	int ix = 1;
-
-	if (unlikely(vsize > MAXALLOCA)) {
-		iov = mem_alloc(vsize);
-	} else {
-		iov = alloca(vsize);
+	u_int len = 0;
+
+	TAILQ_FOREACH(have, &(xioq->ioq_uv.uvqh.qh), q) {
+		len += ioquv_length(IOQ_(have));
 	}
-	wiov = iov; /* position at initial fragment header */
+	return (len);
+}
 
-	/* update the most recent data length, just in case */
-	xdr_tail_update(xioq->xdrs);
+static inline void
+svc_ioq_out_iov(struct svc_ioq_out *out, void *base, size_t len)
+{
+	struct iovec *tiov = &out->iov[out->ix++];
+
+	tiov->iov_base = base;
+	tiov->iov_len = len;
+	out->remaining += len;
+}
+
+/*
+ * Fragments of a record: at most __svc_maxiov - 1 buffers, so one
+ * fragment fits one sendmsg, and less than LAST_FRAG bytes.  Adds the
+ * record to out, each fragment after its header; without out, only
+ * counts.  Returns the iov needed (headers are at most half).
+ */
+static int
+svc_ioq_out_record(struct svc_ioq_out *out, struct xdr_ioq *xioq)
+{
+	struct poolq_entry *have;
+	struct xdr_ioq_uv *data;
+	uint32_t *frag = NULL;
+	uint32_t fbytes = 0;
+	u_int len;
+	int fbufs = 0;
+	int n = 0;
 
-	/* build list after initial fragment header (ix = 1 above) */
 	TAILQ_FOREACH(have, &(xioq->ioq_uv.uvqh.qh), q) {
 		data = IOQ_(have);
-		tiov = iov + ix;
-		tiov->iov_base = data->v.vio_head;
-		tiov->iov_len = ioquv_length(data);
-		remaining += tiov->iov_len;
-		ix++;
-	}
+		len = ioquv_length(data);
 
-	while (remaining > 0) {
-		if (iw == 0) {
-			/* new fragment header, determine last iov */
-			fbytes = 0;
-			for (tiov = &wiov[++iw];
-			     (tiov < &iov[ix]) && (iw < __svc_maxiov);
-			     ++tiov, ++iw) {
-				fbytes += tiov->iov_len;
-
-				/* check for fragment value overflow */
-				/* never happens, see ganesha FSAL_MAXIOSIZE */
-				if (unlikely(fbytes >= LAST_FRAG)) {
-					fbytes -= tiov->iov_len;
-					break;
-				}
-			} /* for */
-
-			/* fragment length doesn't include fragment header */
-			if (&wiov[iw] < &iov[ix]) {
-				frag_header = htonl((u_int32_t) (fbytes));
-			} else {
-				frag_header = htonl((u_int32_t) (fbytes | LAST_FRAG));
+		/* fragment value overflow never happens, see ganesha
+		 * FSAL_MAXIOSIZE
+		 */
+		if (!n || fbufs >= __svc_maxiov - 1
+		 || unlikely(fbytes + len >= LAST_FRAG)) {
+			if (out) {
+				if (frag)
+					*frag = htonl(fbytes);
+				frag = &out->headers[out->ih++];
+				svc_ioq_out_iov(out, frag, sizeof(uint32_t));
 			}
-			wiov->iov_base = &(frag_header);
-			wiov->iov_len = sizeof(u_int32_t);
-
-			/* writev return includes fragment header */
-			remaining += sizeof(u_int32_t);
-			fbytes += sizeof(u_int32_t);
+			fbytes = 0;
+			fbufs = 0;
+			n++;
 		}
+		if (out)
+			svc_ioq_out_iov(out, data->v.vio_head, len);
+		fbytes += len;
+		fbufs++;
+		n++;
+	}
+	if (frag)
+		*frag = htonl(fbytes | LAST_FRAG);
+	return (n);
+}
+
+/* once per xprt, writer only */
+static bool
+svc_ioq_zerocopy_enable(SVCXPRT *xprt, struct svc_vc_xprt *xd)
+{
+	int one = 1;
+
+	if (xprt->xp_flags & SVC_XPRT_FLAG_ZEROCOPY)
+		return (true);
+	if (xd->shared.zc_off
+	 || xprt->xp_type != XPRT_TCP
+	 || !(xprt->xp_flags & SVC_XPRT_FLAG_EDGE))
+		return (false);
+
+	if (setsockopt(xprt->xp_fd, SOL_SOCKET, SO_ZEROCOPY,
+		       &one, sizeof(one))) {
+		__warnx(TIRPC_DEBUG_FLAG_SVC_VC,
+			"%s: %p fd %d SO_ZEROCOPY failed (%d)",
+			__func__, xprt, xprt->xp_fd, errno);
+		xd->shared.zc_off = true;
+		return (false);
+	}
+	atomic_set_uint16_t_bits(&xprt->xp_flags, SVC_XPRT_FLAG_ZEROCOPY);
+	return (true);
+}
 
-		/* blocking write */
-		result = writev(xprt->xp_fd, wiov, iw);
-		remaining -= result;
+/*
+ * Take the records queued behind xioq, up to budget records and
+ * __svc_maxiov iov in all, so they go out in the same sendmsg.  They
+ * stay counted in ioq.qcount, so no other writer is elected.
+ */
+static void
+svc_ioq_out_setup(struct svc_vc_xprt *xd, struct xdr_ioq *xioq, u_int budget)
+{
+	struct svc_ioq_out *out = &xd->shared.out;
+	struct poolq_head *ioqh = &xd->shared.ioq;
+	struct poolq_entry *have;
+	int n = svc_ioq_out_record(NULL, xioq);
+	int m;
 
-		if (result == fbytes) {
-			wiov += iw - 1;
-			iw = 0;
-			continue;
-		}
+	TAILQ_INIT(&out->more);
+	out->records = 1;
+	out->bytes = svc_ioq_length(xioq);
+
+	mutex_lock(&ioqh->qmutex);
+	while (out->records < budget && (have = TAILQ_FIRST(&ioqh->qh))) {
+		m = svc_ioq_out_record(NULL, _IOQ(have));
+		if (n + m > __svc_maxiov)
+			break;
+		TAILQ_REMOVE(&ioqh->qh, have, q);
+		TAILQ_INSERT_TAIL(&out->more, have, q);
+		out->bytes += svc_ioq_length(_IOQ(have));
+		out->records++;
+		n += m;
+	}
+	mutex_unlock(&ioqh->qmutex);
+
+	out->zerocopy = (__svc_params->flags & SVC_FLAG_ZEROCOPY)
+		      && out->bytes >= __svc_params->zerocopy_min
+		      && svc_ioq_zerocopy_enable(&xd->sx_dr.xprt, xd);
+	out->zc_sends = 0;
+
+	/* zero copy: headers are held with the buffers */
+	if (unlikely(n > SVC_IOQ_IOV_INLINE) || out->zerocopy) {
+		out->vsize = n * sizeof(struct iovec)
+			   + (n / 2) * sizeof(uint32_t);
+		out->iov = mem_alloc(out->vsize);
+		out->headers = (uint32_t *)(out->iov + n);
+	} else {
+		out->vsize = 0;
+		out->iov = out->iov_inline;
+		out->headers = out->hdr_inline;
+	}
+	out->xioq = xioq;
+	out->ix = 0;
+	out->iw = 0;
+	out->ih = 0;
+	out->sends = 0;
+	out->remaining = 0;
+
+	(void)svc_ioq_out_record(out, xioq);
+	TAILQ_FOREACH(have, &out->more, q) {
+		(void)svc_ioq_out_record(out, _IOQ(have));
+	}
+}
+
+/* count, and free the records */
+static void
+svc_ioq_out_done(struct svc_ioq_out *out)
+{
+	struct poolq_entry *have;
+
+	atomic_add_uint64_t(&svc_ioq_totals.sends, out->sends);
+	atomic_add_uint64_t(&svc_ioq_totals.replies, out->records);
+	atomic_add_uint64_t(&svc_ioq_totals.bytes, out->bytes);
+
+	while ((have = TAILQ_FIRST(&out->more))) {
+		TAILQ_REMOVE(&out->more, have, q);
+		XDR_DESTROY(_IOQ(have)->xdrs);
+	}
+	XDR_DESTROY(out->xioq->xdrs);
+
+	if (unlikely(out->vsize))
+		mem_free(out->iov, out->vsize);
+	out->xioq = NULL;
+}
+
+/*
+ * Write as much of the records as the socket takes without blocking,
+ * continuing where the last call stopped.  While more output follows at
+ * once (from this batch, or queued meanwhile), TCP is told so with
+ * MSG_MORE, and fills its segments across replies.
+ *
+ * Returns 0 when written, EWOULDBLOCK with the rest kept in shared.out,
+ * or another errno when the connection is dead.
+ */
+static int
+svc_ioq_flushv(SVCXPRT *xprt)
+{
+	struct svc_vc_xprt *xd = VC_DR(REC_XPRT(xprt));
+	struct svc_ioq_out *out = &xd->shared.out;
+	struct msghdr msg;
+	struct iovec *tiov;
+	ssize_t result;
+	int iovcnt;
+	int flags;
+	int code = 0;
+
+	memset(&msg, 0, sizeof(msg));
+
+	while (out->remaining > 0) {
+		iovcnt = MIN(out->ix - out->iw, __svc_maxiov);
+
+		/* never blocks, whatever the socket */
+		flags = MSG_DONTWAIT | MSG_NOSIGNAL;
+		if (xprt->xp_type == XPRT_TCP
+		 && (out->iw + iovcnt < out->ix
+		     || atomic_fetch_int32_t(&xd->shared.ioq.qcount)
+			> out->records))
+			flags |= MSG_MORE;
+		if (out->zerocopy)
+			flags |= MSG_ZEROCOPY;
+
+		msg.msg_iov = &out->iov[out->iw];
+		msg.msg_iovlen = iovcnt;
+		result = sendmsg(xprt->xp_fd, &msg, flags);
 		if (unlikely(result < 0)) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return (EWOULDBLOCK);
+			if (errno == ENOBUFS && out->zerocopy) {
+				/* over optmem_max, copy the rest */
+				out->zerocopy = false;
+				continue;
+			}
+			code = errno;
 			__warnx(TIRPC_DEBUG_FLAG_ERROR,
-				"%s() writev failed (%d)\n",
-				__func__, errno);
+				"%s() sendmsg failed (%d)\n",
+				__func__, code);
 			cfconn_set_dead(xprt);
 			break;
 		}
-		fbytes -= result;
+		out->sends++;
+		out->remaining -= result;
+		if (out->zerocopy) {
+			out->zc_sends++;
+			xd->shared.zc_next++;
+		}
 
-		/* rare? writev underrun? (assume never overrun) */
-		for (tiov = wiov; iw > 0; ++tiov, --iw) {
+		/* past what was written, maybe within an iov */
+		for (tiov = &out->iov[out->iw]; result > 0; ++tiov) {
 			if (tiov->iov_len > result) {
 				tiov->iov_len -= result;
 				tiov->iov_base += result;
-				wiov = tiov;
 				break;
-			} else {
-				result -= tiov->iov_len;
 			}
-		} /* for */
+			result -= tiov->iov_len;
+			out->iw++;
+		}
 	} /* while */
 
-	if (unlikely(vsize > MAXALLOCA)) {
-		mem_free(iov, vsize);
+	return (code);
+}
+
+/* ioq LOCKED */
+static inline uint32_t
+svc_ioq_unpark_locked(struct svc_vc_xprt *xd)
+{
+	uint32_t parked = xd->shared.ioq_parked;
+
+	if (parked == SVC_IOQ_PARK_NONE)
+		return (SVC_IOQ_PARK_NONE);
+	if (parked == SVC_IOQ_PARK_DESTROY) {
+		if (xd->shared.ioq.qcount)
+			return (SVC_IOQ_PARK_NONE);
+	} else if (xd->shared.ioq_bytes > __svc_params->ioq_lowat)
+		return (SVC_IOQ_PARK_NONE);
+	xd->shared.ioq_parked = SVC_IOQ_PARK_NONE;
+	return (parked);
+}
+
+/* ! LOCKED */
+static inline void
+svc_ioq_unpark(SVCXPRT *xprt, uint32_t parked)
+{
+	switch (parked) {
+	case SVC_IOQ_PARK_REARM:
+		svc_rqst_rearm_events(xprt, SVC_RQST_FLAG_NONE);
+		break;
+	case SVC_IOQ_PARK_GETREQ:
+		/* on failure, input stays stopped */
+		if (svc_rqst_requeue(xprt))
+			SVC_RELEASE(xprt, SVC_RELEASE_FLAG_NONE);
+		break;
+	case SVC_IOQ_PARK_DESTROY:
+		SVC_DESTROY(xprt);
+		SVC_RELEASE(xprt, SVC_RELEASE_FLAG_NONE);
+		break;
+	default:
+		break;
+	}
+}
+
+/**
+ * @brief Stop reading from a client not reading its replies
+ *
+ * From xp_getreq, in place of going on (XPRT_MOREREQS) or rearming.
+ * While the output queued on a VC xprt is over ioq_hiwat, it is parked
+ * (with the ref, for XPRT_MOREREQS) until the writer has it down to
+ * ioq_lowat.
+ *
+ * @return true when parked.
+ */
+bool
+svc_ioq_throttle(SVCXPRT *xprt, enum xprt_stat stat)
+{
+	struct svc_vc_xprt *xd;
+	bool parked = false;
+
+	if (xprt->xp_type != XPRT_TCP && xprt->xp_type != XPRT_VSOCK)
+		return (false);
+	/* edge triggered, idle: already armed, nothing to hold */
+	if (stat != XPRT_MOREREQS && (xprt->xp_flags & SVC_XPRT_FLAG_EDGE))
+		return (false);
+
+	xd = VC_DR(REC_XPRT(xprt));
+	if (likely(atomic_fetch_uint32_t(&xd->shared.ioq_bytes)
+		   <= __svc_params->ioq_hiwat))
+		return (false);
+
+	mutex_lock(&xd->shared.ioq.qmutex);
+	if (xd->shared.ioq_bytes > __svc_params->ioq_hiwat) {
+		xd->shared.ioq_parked = (stat == XPRT_MOREREQS)
+				      ? SVC_IOQ_PARK_GETREQ
+				      : SVC_IOQ_PARK_REARM;
+		parked = true;
 	}
+	mutex_unlock(&xd->shared.ioq.qmutex);
+
+	if (parked)
+		__warnx(TIRPC_DEBUG_FLAG_SVC_VC,
+			"%s: %p fd %d parked, %" PRIu32 " bytes queued",
+			__func__, xprt, xprt->xp_fd, xd->shared.ioq_bytes);
+	return (parked);
+}
+
+/**
+ * @brief Destroy a VC xprt once its queued output is written
+ *
+ * From xp_getreq at XPRT_DIED, usually EOF: a client may shut down its
+ * sending side and still read the replies.  With output queued, the
+ * writer destroys the xprt (and releases the ref) after its last record.
+ *
+ * @return true when left to the writer.
+ */
+bool
+svc_ioq_linger(SVCXPRT *xprt)
+{
+	struct svc_vc_xprt *xd;
+	bool linger = false;
+
+	if (xprt->xp_type != XPRT_TCP && xprt->xp_type != XPRT_VSOCK)
+		return (false);
+
+	xd = VC_DR(REC_XPRT(xprt));
+	mutex_lock(&xd->shared.ioq.qmutex);
+	if (xd->shared.ioq.qcount
+	 && xd->shared.ioq_parked == SVC_IOQ_PARK_NONE) {
+		xd->shared.ioq_parked = SVC_IOQ_PARK_DESTROY;
+		linger = true;
+	}
+	mutex_unlock(&xd->shared.ioq.qmutex);
+	return (linger);
+}
+
+static void svc_ioq_write(SVCXPRT *, struct xdr_ioq *);
+
+static void
+svc_ioq_write_callback(struct work_pool_entry *wpe)
+{
+	struct xdr_ioq *xioq = opr_containerof(wpe, struct xdr_ioq, ioq_wpe);
+	SVCXPRT *xprt = (SVCXPRT *)xioq->xdrs[0].x_lib[1];
+
+	svc_ioq_write(xprt, xioq);
 }
 
+/* SVC_FLAG_IOQ_IFQ: serve the interface's busy transports in turn */
 static void
-svc_ioq_write(SVCXPRT *xprt, struct xdr_ioq *xioq, struct poolq_head *ifph)
+svc_ioq_ifq_callback(struct work_pool_entry *wpe)
 {
+	struct xdr_ioq *xioq = opr_containerof(wpe, struct xdr_ioq, ioq_wpe);
+	SVCXPRT *xprt = (SVCXPRT *)xioq->xdrs[0].x_lib[1];
+	struct poolq_head *ifph = &ioq_ifqh[xprt->xp_ifindex & IOQ_IF_MASK];
 	struct poolq_entry *have;
 
 	for (;;) {
-		/* do i/o unlocked */
-		if (svc_work_pool.params.thrd_max
-		 && !(xprt->xp_flags & SVC_XPRT_FLAG_DESTROYED)) {
-			/* all systems are go! */
-			svc_ioq_flushv(xprt, xioq);
-		}
-		SVC_RELEASE(xprt, SVC_RELEASE_FLAG_NONE);
-		XDR_DESTROY(xioq->xdrs);
+		/* may queue it again at the tail */
+		svc_ioq_write(xprt, xioq);
 
 		mutex_lock(&ifph->qmutex);
 		if (--(ifph->qcount) == 0)
@@ -243,62 +648,334 @@ svc_ioq_write(SVCXPRT *xprt, struct xdr_ioq *xioq, struct poolq_head *ifph)
 	mutex_unlock(&ifph->qmutex);
 }
 
+/* pass the election, with the next record of the transport */
 static void
-svc_ioq_write_callback(struct work_pool_entry *wpe)
+svc_ioq_yield(SVCXPRT *xprt, struct xdr_ioq *xioq)
 {
-	struct xdr_ioq *xioq = opr_containerof(wpe, struct xdr_ioq, ioq_wpe);
-	SVCXPRT *xprt = (SVCXPRT *)xioq->xdrs[0].x_lib[1];
-	struct poolq_head *ifph = &ioq_ifqh[xprt->xp_ifindex & IOQ_IF_MASK];
-
-	svc_ioq_write(xprt, xioq, ifph);
-}
+	struct poolq_head *ifph;
 
-void
-svc_ioq_write_now(SVCXPRT *xprt, struct xdr_ioq *xioq)
-{
-	struct poolq_head *ifph = &ioq_ifqh[xprt->xp_ifindex & IOQ_IF_MASK];
+	if (!(__svc_params->flags & SVC_FLAG_IOQ_IFQ)) {
+		xioq->ioq_wpe.fun = svc_ioq_write_callback;
+		work_pool_submit(&svc_work_pool, &xioq->ioq_wpe);
+		return;
+	}
 
-	SVC_REF(xprt, SVC_REF_FLAG_NONE);
+	ifph = &ioq_ifqh[xprt->xp_ifindex & IOQ_IF_MASK];
 	mutex_lock(&ifph->qmutex);
-
 	if ((ifph->qcount)++ > 0) {
-		/* queue additional output requests without task switch */
 		TAILQ_INSERT_TAIL(&ifph->qh, &(xioq->ioq_s), q);
 		mutex_unlock(&ifph->qmutex);
 		return;
 	}
 	mutex_unlock(&ifph->qmutex);
 
-	/* handle this output request without queuing, then any additional
-	 * output requests without a task switch (using this thread).
+	xioq->ioq_wpe.fun = svc_ioq_ifq_callback;
+	work_pool_submit(&svc_work_pool, &xioq->ioq_wpe);
+}
+
+static void
+svc_ioq_zerocopy_release(struct svc_ioq_zc_hold *zh)
+{
+	struct poolq_entry *have;
+
+	while ((have = TAILQ_FIRST(&zh->uvq))) {
+		TAILQ_REMOVE(&zh->uvq, have, q);
+		xdr_ioq_uv_release(IOQ_(have));
+	}
+	mem_free(zh->iov, zh->vsize);
+	mem_free(zh, sizeof(*zh));
+}
+
+/* keep the buffers (and headers) of the batch, leaving the records empty */
+static void
+svc_ioq_zerocopy_hold(struct svc_vc_xprt *xd, struct svc_ioq_out *out)
+{
+	struct svc_ioq_zc_hold *zh = mem_alloc(sizeof(*zh));
+	struct xdr_ioq *xioq = out->xioq;
+	struct poolq_entry *next = TAILQ_FIRST(&out->more);
+	struct poolq_entry *have;
+
+	TAILQ_INIT(&zh->uvq);
+	zh->id = xd->shared.zc_next - 1;
+	zh->iov = out->iov;
+	zh->vsize = out->vsize;
+	out->vsize = 0;
+
+	for (;;) {
+		while ((have = TAILQ_FIRST(&xioq->ioq_uv.uvqh.qh))) {
+			TAILQ_REMOVE(&xioq->ioq_uv.uvqh.qh, have, q);
+			TAILQ_INSERT_TAIL(&zh->uvq, have, q);
+		}
+		xioq->ioq_uv.uvqh.qcount = 0;
+		if (!next)
+			break;
+		xioq = _IOQ(next);
+		next = TAILQ_NEXT(next, q);
+	}
+	atomic_add_uint64_t(&svc_ioq_totals.zerocopy, out->zc_sends);
+
+	mutex_lock(&xd->shared.ioq.qmutex);
+	if ((int32_t)(zh->id - xd->shared.zc_done) >= 0) {
+		TAILQ_INSERT_TAIL(&xd->shared.zc_held, zh, q);
+		zh = NULL;
+	}
+	mutex_unlock(&xd->shared.ioq.qmutex);
+
+	/* already reaped */
+	if (zh)
+		svc_ioq_zerocopy_release(zh);
+}
+
+/**
+ * @brief Release the buffers of completed MSG_ZEROCOPY sends
+ *
+ * Called by the event channel at EPOLLERR.  TCP completes ids in order,
+ * so holds are released from the oldest, up to the highest reported.
+ *
+ * @return true when the error queue had completions.
+ */
+bool
+svc_ioq_zerocopy_reap(SVCXPRT *xprt)
+{
+	struct svc_vc_xprt *xd = VC_DR(REC_XPRT(xprt));
+	struct svc_ioq_zc_head done = TAILQ_HEAD_INITIALIZER(done);
+	struct svc_ioq_zc_hold *zh;
+	struct sock_extended_err *serr;
+	struct cmsghdr *cm;
+	struct msghdr msg;
+	char control[CMSG_SPACE(sizeof(*serr) + sizeof(struct sockaddr_in6))];
+	uint64_t copied = 0;
+	bool reaped = false;
+
+	for (;;) {
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+		if (recvmsg(xprt->xp_fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT)
+		    < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		for (cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+			if (!(cm->cmsg_level == SOL_IP
+			      && cm->cmsg_type == IP_RECVERR)
+			 && !(cm->cmsg_level == SOL_IPV6
+			      && cm->cmsg_type == IPV6_RECVERR))
+				continue;
+			serr = (struct sock_extended_err *)CMSG_DATA(cm);
+			if (serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY
+			 || serr->ee_errno != 0)
+				continue;
+
+			/* ids ee_info through ee_data */
+			if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+				copied += serr->ee_data - serr->ee_info + 1;
+			reaped = true;
+
+			mutex_lock(&xd->shared.ioq.qmutex);
+			if ((int32_t)(serr->ee_data + 1 - xd->shared.zc_done)
+			    > 0)
+				xd->shared.zc_done = serr->ee_data + 1;
+			while ((zh = TAILQ_FIRST(&xd->shared.zc_held))
+			       && (int32_t)(zh->id - xd->shared.zc_done) < 0) {
+				TAILQ_REMOVE(&xd->shared.zc_held, zh, q);
+				TAILQ_INSERT_TAIL(&done, zh, q);
+			}
+			mutex_unlock(&xd->shared.ioq.qmutex);
+		}
+	}
+
+	while ((zh = TAILQ_FIRST(&done))) {
+		TAILQ_REMOVE(&done, zh, q);
+		svc_ioq_zerocopy_release(zh);
+	}
+	if (copied)
+		atomic_add_uint64_t(&svc_ioq_totals.zerocopy_copied, copied);
+	return (reaped);
+}
+
+/*
+ * xprt destroyed, before its fd is closed.  The last records may still be
+ * sent from the buffers held, so wait (up to SVC_IOQ_ZEROCOPY_LINGER_MS,
+ * unless the peer is gone) for their completions; no more are reaped
+ * after.
+ */
+void
+svc_ioq_zerocopy_drop(SVCXPRT *xprt)
+{
+	struct svc_vc_xprt *xd = VC_DR(REC_XPRT(xprt));
+	struct svc_ioq_zc_hold *zh;
+	struct pollfd pollfd = {
+		.fd = xprt->xp_fd,
+		.events = 0,	/* POLLERR for the error queue */
+	};
+	int milliseconds = SVC_IOQ_ZEROCOPY_LINGER_MS;
+
+	while (!TAILQ_EMPTY(&xd->shared.zc_held)
+	       && xprt->xp_fd != RPC_ANYFD && milliseconds > 0) {
+		if (poll(&pollfd, 1, 10) < 0 && errno != EINTR)
+			break;
+		if (!svc_ioq_zerocopy_reap(xprt)
+		 && (pollfd.revents & (POLLHUP | POLLNVAL)))
+			break;
+		milliseconds -= 10;
+	}
+
+	if (!TAILQ_EMPTY(&xd->shared.zc_held))
+		__warnx(TIRPC_DEBUG_FLAG_SVC_VC,
+			"%s: %p fd %d zerocopy completions not reaped",
+			__func__, xprt, xprt->xp_fd);
+
+	while ((zh = TAILQ_FIRST(&xd->shared.zc_held))) {
+		TAILQ_REMOVE(&xd->shared.zc_held, zh, q);
+		svc_ioq_zerocopy_release(zh);
+	}
+}
+
+/*
+ * The elected writer: this record, with those queued meanwhile, up to
+ * SVC_IOQ_BUDGET.  When the socket is full, the thread is released, and
+ * the election (with the records' refs) waits on the event channel for
+ * EPOLLOUT.  Each record holds a ref; the last is released only after
+ * the queue is unlocked.
+ */
+static void
+svc_ioq_write(SVCXPRT *xprt, struct xdr_ioq *xioq)
+{
+	struct svc_vc_xprt *xd = VC_DR(REC_XPRT(xprt));
+	struct poolq_head *ioqh = &xd->shared.ioq;
+	struct svc_ioq_out *out = &xd->shared.out;
+	struct poolq_entry *have;
+	uint32_t parked;
+	u_int records;
+	u_int len;
+	u_int n = 0;
+
+	for (;;) {
+		/* resumed at EPOLLOUT, or a new batch */
+		if (out->xioq != xioq)
+			svc_ioq_out_setup(xd, xioq, SVC_IOQ_BUDGET - n);
+
+		/* do i/o unlocked */
+		while (svc_work_pool.params.thrd_max
+		       && !(xprt->xp_flags & SVC_XPRT_FLAG_DESTROYED)
+		       && svc_ioq_flushv(xprt) == EWOULDBLOCK) {
+			atomic_inc_uint64_t(&svc_ioq_totals.waits);
+			/* svc_ioq_resume() at EPOLLOUT */
+			if (!svc_rqst_evchan_write(xprt))
+				return;
+			if (!svc_ioq_poll_out(xprt)) {
+				cfconn_set_dead(xprt);
+				break;
+			}
+		}
+		records = out->records;
+		len = out->bytes;
+		if (out->zc_sends)
+			svc_ioq_zerocopy_hold(xd, out);
+		svc_ioq_out_done(out);
+
+		mutex_lock(&ioqh->qmutex);
+		xd->shared.ioq_bytes -= len;
+		ioqh->qcount -= records;
+		parked = svc_ioq_unpark_locked(xd);
+		if (ioqh->qcount == 0)
+			break;
+
+		have = TAILQ_FIRST(&ioqh->qh);
+		TAILQ_REMOVE(&ioqh->qh, have, q);
+		mutex_unlock(&ioqh->qmutex);
+
+		/* queued records hold their own refs */
+		svc_ioq_unpark(xprt, parked);
+		n += records;
+		for (; records > 0; records--)
+			SVC_RELEASE(xprt, SVC_RELEASE_FLAG_NONE);
+		xioq = _IOQ(have);
+
+		if (n >= SVC_IOQ_BUDGET) {
+			svc_ioq_yield(xprt, xioq);
+			return;
+		}
+	}
+	mutex_unlock(&ioqh->qmutex);
+	svc_ioq_unpark(xprt, parked);
+	for (; records > 0; records--)
+		SVC_RELEASE(xprt, SVC_RELEASE_FLAG_NONE);
+}
+
+void
+svc_ioq_output_stats(struct svc_ioq_stats *stats)
+{
+	stats->sends = atomic_fetch_uint64_t(&svc_ioq_totals.sends);
+	stats->replies = atomic_fetch_uint64_t(&svc_ioq_totals.replies);
+	stats->bytes = atomic_fetch_uint64_t(&svc_ioq_totals.bytes);
+	stats->waits = atomic_fetch_uint64_t(&svc_ioq_totals.waits);
+	stats->zerocopy = atomic_fetch_uint64_t(&svc_ioq_totals.zerocopy);
+	stats->zerocopy_copied =
+		atomic_fetch_uint64_t(&svc_ioq_totals.zerocopy_copied);
+}
+
+void
+svc_ioq_resume(SVCXPRT *xprt)
+{
+	struct xdr_ioq *xioq = VC_DR(REC_XPRT(xprt))->shared.out.xioq;
+
+	xioq->ioq_wpe.fun = svc_ioq_write_callback;
+	work_pool_submit(&svc_work_pool, &xioq->ioq_wpe);
+}
+
+/* queue a record; true when elected to write.  Takes a ref. */
+static inline bool
+svc_ioq_enqueue(SVCXPRT *xprt, struct xdr_ioq *xioq)
+{
+	struct svc_vc_xprt *xd = VC_DR(REC_XPRT(xprt));
+	struct poolq_head *ioqh = &xd->shared.ioq;
+	u_int len;
+
+	/* update the most recent data length, just in case */
+	xdr_tail_update(xioq->xdrs);
+	len = svc_ioq_length(xioq);
+
+	SVC_REF(xprt, SVC_REF_FLAG_NONE);
+	mutex_lock(&ioqh->qmutex);
+	xd->shared.ioq_bytes += len;
+
+	if ((ioqh->qcount)++ > 0) {
+		/* another thread is writing: queue without task switch */
+		TAILQ_INSERT_TAIL(&ioqh->qh, &(xioq->ioq_s), q);
+		mutex_unlock(&ioqh->qmutex);
+		return (false);
+	}
+	mutex_unlock(&ioqh->qmutex);
+	return (true);
+}
+
+void
+svc_ioq_write_now(SVCXPRT *xprt, struct xdr_ioq *xioq)
+{
+	/* elected: handle this output request without queuing, then any
+	 * additional output requests without a task switch (using this
+	 * thread).
 	 */
-	svc_ioq_write(xprt, xioq, ifph);
+	if (svc_ioq_enqueue(xprt, xioq))
+		svc_ioq_write(xprt, xioq);
 }
 
 /*
  * Handle rare case of first output followed by heavy traffic that prevents the
  * original thread from continuing for too long.
  *
- * In the more common case, server traffic will already have begun and this
- * will rapidly queue the output and return.
+ * In the more common case, output on this transport has already begun and
+ * this will rapidly queue the output and return.
  */
 void
 svc_ioq_write_submit(SVCXPRT *xprt, struct xdr_ioq *xioq)
 {
-	struct poolq_head *ifph = &ioq_ifqh[xprt->xp_ifindex & IOQ_IF_MASK];
-
-	SVC_REF(xprt, SVC_REF_FLAG_NONE);
-	mutex_lock(&ifph->qmutex);
-
-	if ((ifph->qcount)++ > 0) {
-		/* queue additional output requests, they will be handled by
-		 * existing thread without another task switch.
-		 */
-		TAILQ_INSERT_TAIL(&ifph->qh, &(xioq->ioq_s), q);
-		mutex_unlock(&ifph->qmutex);
+	if (!svc_ioq_enqueue(xprt, xioq))
 		return;
-	}
-	mutex_unlock(&ifph->qmutex);
 
 	xioq->ioq_wpe.fun = svc_ioq_write_callback;
 	work_pool_submit(&svc_work_pool, &xioq->ioq_wpe);
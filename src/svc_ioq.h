@@ -33,4 +33,24 @@ void svc_ioq_init(void);
 void svc_ioq_write_now(SVCXPRT *, struct xdr_ioq *);
 void svc_ioq_write_submit(SVCXPRT *, struct xdr_ioq *);
 
+/* the writer waiting on EPOLLOUT, see svc_rqst_evchan_write() */
+void svc_ioq_resume(SVCXPRT *);
+
+/* true: input stopped (at stat) until the output queued drains */
+bool svc_ioq_throttle(SVCXPRT *, enum xprt_stat);
+
+/* true: at XPRT_DIED, destroyed after the output queued */
+bool svc_ioq_linger(SVCXPRT *);
+
+/* SVC_INIT_VC_IOQ_RECV segments, see svc_vc_segs_drain() */
+void svc_ioq_segs_init(void);
+struct xdr_ioq_uv *svc_ioq_seg_get(void);
+void svc_ioq_seg_unref(struct xdr_ioq_uv *);
+struct xdr_ioq_uv *svc_ioq_seg_view(struct xdr_ioq_uv *, void *, void *);
+XDR *svc_ioq_seg_xdr_create(void);
+
+/* SVC_XPRT_FLAG_ZEROCOPY: at EPOLLERR, true when completions were reaped */
+bool svc_ioq_zerocopy_reap(SVCXPRT *);
+void svc_ioq_zerocopy_drop(SVCXPRT *);
+
 #endif				/* SVC_IOQ_H */
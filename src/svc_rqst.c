@@ -27,6 +27,9 @@
 
 #include <sys/types.h>
 #include <sys/poll.h>
+#include <sys/ioctl.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
 #include <stdint.h>
 #include <assert.h>
 #include <err.h>
@@ -52,6 +55,10 @@
 #include "svc_internal.h"
 #include <rpc/svc_rqst.h>
 #include "svc_xprt.h"
+#include "svc_ioq.h"
+#if defined(USE_IO_URING)
+#include "svc_uring.h"
+#endif
 
 /*
  * The TI-RPC instance should be able to reach every registered
@@ -64,12 +71,31 @@
 
 #define SVC_RQST_PARTITIONS 7
 
+/* SVC_RQST_FLAG_BALANCE: bytes readable that weigh as much as an event */
+#define SVC_RQST_BALANCE_BYTES 4096
+
+/* adaptive events per wait, down to SVC_RQST_BATCH_MIN (or max_events) */
+#define SVC_RQST_BATCH_MIN 8
+#define SVC_RQST_BATCH_DECAY 16	/* light waits before halving */
+
+/* event user data tag: the send side of the xprt (EPOLLOUT) */
+#define SVC_RQST_EV_SEND 0x1
+
+/* io_uring user data tag: a provided buffer recv, see svc_rqst_recv */
+#define SVC_RQST_EV_RECV 0x2
+
+/* SVC_EVENT_URING provided buffers (page sized segments) per channel */
+#define SVC_RQST_URING_BUFS 256
+
 static bool initialized;
 
+struct svc_rqst_rec;
+
 struct svc_rqst_set {
 	mutex_t mtx;
 	struct rbtree_x xt;
 	uint32_t next_id;
+	TAILQ_HEAD(balance_head, svc_rqst_rec) balance_q;	/* mtx */
 };
 
 static struct svc_rqst_set svc_rqst_set = {
@@ -83,6 +109,18 @@ static struct svc_rqst_set svc_rqst_set = {
 	0			/* next_id */
 };
 
+/* command mailbox, applied by the channel thread */
+#define SVC_RQST_CMD_REG		1	/* hook events for xprt */
+#define SVC_RQST_CMD_SIGNAL		2	/* set signals */
+
+struct svc_rqst_cmd {
+	TAILQ_ENTRY(svc_rqst_cmd) q;
+	uint32_t type;
+	uint32_t signals;	/* SVC_RQST_CMD_SIGNAL */
+	SVCXPRT *xprt;		/* SVC_RQST_CMD_REG, with a ref */
+	int code;		/* SVC_RQST_CMD_REG failed, applied */
+};
+
 struct svc_rqst_rec {
 	struct opr_rbtree_node node_k;
 	TAILQ_HEAD(evq_head, rpc_svcxprt) xprt_q;	/* xprt handles */
@@ -90,13 +128,43 @@ struct svc_rqst_rec {
 	void *u_data;		/* user-installable opaque data */
 	uint64_t gen;		/* generation number */
 
-	int sv[2];
+	int ev_fd;		/* eventfd for wakeups */
+	uint32_t ev_pending;	/* ev_fd written, not yet consumed */
+	mutex_t cmd_mtx;
+	TAILQ_HEAD(cmd_head, svc_rqst_cmd) cmd_q;	/* cmd_mtx */
 	uint32_t id_k;		/* chan id */
 	uint32_t states;
 	uint32_t signals;
 	uint32_t refcnt;
 	uint16_t flags;
 
+	/* load counters (atomic) */
+	uint32_t n_xprts;
+	uint64_t events;
+	uint64_t bytes;
+	uint64_t polls_busy;	/* SVC_RQST_FLAG_BUSY_POLL */
+	uint64_t polls_empty;
+	uint64_t requeues;
+
+	/* xprts yielding at getreq_budget, run after the next poll */
+	TAILQ_HEAD(ready_head, poolq_entry) ready_q;	/* mtx */
+
+	/* events per wait (atomic), and waits using under a quarter
+	 * (a hint, racy)
+	 */
+	uint32_t ev_batch;
+	uint32_t ev_light;
+
+	/* SVC_RQST_FLAG_BALANCE, and rates: protected by svc_rqst_set.mtx */
+	TAILQ_ENTRY(svc_rqst_rec) balance_q;
+	struct {
+		struct timespec ts;
+		uint64_t events;
+		uint64_t bytes;
+		uint64_t events_sec;
+		uint64_t bytes_sec;
+	} rate;
+
 	/*
 	 * union of event processor types
 	 */
@@ -106,9 +174,16 @@ struct svc_rqst_rec {
 		struct {
 			int epoll_fd;
 			struct epoll_event ctrl_ev;
-			struct epoll_event *events;
 			u_int max_events;	/* max epoll events */
 		} epoll;
+#endif
+#if defined(TIRPC_EPOLL) && defined(USE_IO_URING)
+		struct {
+			struct svc_uring ring;	/* sr_rec LOCKED, but enter */
+			u_int max_events;	/* max completions per wait */
+			/* provided to ring, by buffer id; sr_rec LOCKED */
+			struct xdr_ioq_uv **bufs;
+		} uring;
 #endif
 		struct {
 			fd_set set;	/* select/fd_set (currently unhooked) */
@@ -158,6 +233,7 @@ svc_rqst_init(void)
 			__func__, code);
 		goto unlock;
 	}
+	TAILQ_INIT(&svc_rqst_set.balance_q);
 
 	/* init read-through cache */
 	for (ix = 0; ix < SVC_RQST_PARTITIONS; ++ix) {
@@ -220,6 +296,51 @@ svc_rqst_lookup_chan(uint32_t chan_id, struct rbtree_x_part **ref_t,
 	return (sr_rec);
 }
 
+#if defined(TIRPC_EPOLL) && defined(USE_IO_URING)
+/*
+ * SVC_INIT_VC_IOQ_RECV: page sized segments for the kernel to receive
+ * into (svc_rqst_recv), each replaced as it comes back filled.  Without
+ * multishot recv, edge triggered xprts keep their multishot polls.
+ */
+static void
+svc_rqst_uring_bufs_setup(struct svc_rqst_rec *sr_rec)
+{
+	struct svc_uring *ring = &sr_rec->ev_u.uring.ring;
+	struct xdr_ioq_uv *seg;
+	uint16_t bid;
+
+	if (!(__svc_params->flags & SVC_FLAG_VC_IOQ_RECV)
+	 || !ring->multishot
+	 || svc_uring_bufs_setup(ring, SVC_RQST_URING_BUFS))
+		return;
+
+	sr_rec->ev_u.uring.bufs =
+		mem_alloc(SVC_RQST_URING_BUFS * sizeof(struct xdr_ioq_uv *));
+	for (bid = 0; bid < SVC_RQST_URING_BUFS; bid++) {
+		seg = svc_ioq_seg_get();
+		sr_rec->ev_u.uring.bufs[bid] = seg;
+		svc_uring_buf_add(ring, seg->v.vio_head, ioquv_size(seg), bid);
+	}
+	svc_uring_bufs_commit(ring);
+}
+
+/* after the ring, so that the kernel is done with them */
+static void
+svc_rqst_uring_bufs_free(struct svc_rqst_rec *sr_rec)
+{
+	uint16_t bid;
+
+	if (!sr_rec->ev_u.uring.bufs)
+		return;
+
+	for (bid = 0; bid < SVC_RQST_URING_BUFS; bid++)
+		svc_ioq_seg_unref(sr_rec->ev_u.uring.bufs[bid]);
+	mem_free(sr_rec->ev_u.uring.bufs,
+		 SVC_RQST_URING_BUFS * sizeof(struct xdr_ioq_uv *));
+	sr_rec->ev_u.uring.bufs = NULL;
+}
+#endif
+
 int
 svc_rqst_new_evchan(uint32_t *chan_id /* OUT */, void *u_data, uint32_t flags)
 {
@@ -236,22 +357,49 @@ svc_rqst_new_evchan(uint32_t *chan_id /* OUT */, void *u_data, uint32_t flags)
 
 	sr_rec = mem_zalloc(sizeof(struct svc_rqst_rec));
 
-	/* create a pair of anonymous sockets for async event channel wakeups */
-	code = socketpair(AF_UNIX, SOCK_STREAM, 0, sr_rec->sv);
-	if (code) {
+	/* async event channel wakeups */
+	sr_rec->ev_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (sr_rec->ev_fd < 0) {
+		code = errno;
 		__warnx(TIRPC_DEBUG_FLAG_ERROR,
-			"%s: failed creating event signal socketpair (%d)",
+			"%s: failed creating event signal eventfd (%d)",
 			__func__, code);
 		mem_free(sr_rec, sizeof(struct svc_rqst_rec));
 		return (code);
 	}
+	mutex_init(&sr_rec->cmd_mtx, NULL);
+	TAILQ_INIT(&sr_rec->cmd_q);
 
-	/* set non-blocking */
-	SetNonBlock(sr_rec->sv[0]);
-	SetNonBlock(sr_rec->sv[1]);
-
+#if defined(TIRPC_EPOLL) && defined(USE_IO_URING)
+	if (flags & SVC_RQST_FLAG_URING) {
+		sr_rec->ev_u.uring.max_events =
+		    __svc_params->ev_u.evchan.max_events;
+		sr_rec->ev_batch = sr_rec->ev_u.uring.max_events;
+		code = svc_uring_setup(&sr_rec->ev_u.uring.ring,
+				       sr_rec->ev_u.uring.max_events);
+		if (!code) {
+			sr_rec->flags = flags & SVC_RQST_FLAG_MASK;
+			sr_rec->ev_type = SVC_EVENT_URING;
+
+			/* control socket wakeups, re-armed on each */
+			(void)svc_uring_poll_add(&sr_rec->ev_u.uring.ring,
+						 sr_rec->ev_fd, POLLIN,
+						 SVC_URING_DATA_CTRL);
+			svc_rqst_uring_bufs_setup(sr_rec);
+			flags &= ~SVC_RQST_FLAG_EPOLL;
+		} else {
+			__warnx(TIRPC_DEBUG_FLAG_ERROR,
+				"%s: io_uring unavailable (%d), using epoll",
+				__func__, code);
+			memset(&sr_rec->ev_u, 0, sizeof(sr_rec->ev_u));
+			code = 0;
+		}
+	}
+#endif
 #if defined(TIRPC_EPOLL)
-	if (flags & SVC_RQST_FLAG_EPOLL) {
+	if (sr_rec->ev_type == SVC_EVENT_URING) {
+		/* set up above */
+	} else if (flags & SVC_RQST_FLAG_EPOLL) {
 
 		sr_rec->flags = flags & SVC_RQST_FLAG_MASK;
 
@@ -260,9 +408,7 @@ svc_rqst_new_evchan(uint32_t *chan_id /* OUT */, void *u_data, uint32_t flags)
 		/* XXX improve this too */
 		sr_rec->ev_u.epoll.max_events =
 		    __svc_params->ev_u.evchan.max_events;
-		sr_rec->ev_u.epoll.events = (struct epoll_event *)
-		    mem_alloc(sr_rec->ev_u.epoll.max_events *
-			      sizeof(struct epoll_event));
+		sr_rec->ev_batch = sr_rec->ev_u.epoll.max_events;
 
 		/* create epoll fd */
 		sr_rec->ev_u.epoll.epoll_fd =
@@ -273,9 +419,8 @@ svc_rqst_new_evchan(uint32_t *chan_id /* OUT */, void *u_data, uint32_t flags)
 			__warnx(TIRPC_DEBUG_FLAG_ERROR,
 				"%s: epoll_create failed (%d)", __func__,
 				errno);
-			mem_free(sr_rec->ev_u.epoll.events,
-				 sr_rec->ev_u.epoll.max_events *
-				 sizeof(struct epoll_event));
+			close(sr_rec->ev_fd);
+			mutex_destroy(&sr_rec->cmd_mtx);
 			mem_free(sr_rec, sizeof(struct svc_rqst_rec));
 			return (EINVAL);
 		}
@@ -284,14 +429,31 @@ svc_rqst_new_evchan(uint32_t *chan_id /* OUT */, void *u_data, uint32_t flags)
 		 * couple of possible semantics */
 		sr_rec->ev_u.epoll.ctrl_ev.events =
 		    EPOLLIN | EPOLLRDHUP;
-		sr_rec->ev_u.epoll.ctrl_ev.data.fd = sr_rec->sv[1];
+		sr_rec->ev_u.epoll.ctrl_ev.data.fd = sr_rec->ev_fd;
 		code =
 		    epoll_ctl(sr_rec->ev_u.epoll.epoll_fd, EPOLL_CTL_ADD,
-			      sr_rec->sv[1], &sr_rec->ev_u.epoll.ctrl_ev);
+			      sr_rec->ev_fd, &sr_rec->ev_u.epoll.ctrl_ev);
 		if (code == -1)
 			__warnx(TIRPC_DEBUG_FLAG_ERROR,
 				"%s: add control socket failed (%d)", __func__,
 				errno);
+#if defined(EPIOCSPARAMS)
+		if ((sr_rec->flags & SVC_RQST_FLAG_BUSY_POLL)
+		    && __svc_params->busy_poll_napi_us) {
+			struct epoll_params ep = {
+				.busy_poll_usecs =
+					__svc_params->busy_poll_napi_us,
+				.busy_poll_budget = 8,
+				.prefer_busy_poll = 1,
+			};
+
+			if (ioctl(sr_rec->ev_u.epoll.epoll_fd, EPIOCSPARAMS,
+				  &ep))
+				__warnx(TIRPC_DEBUG_FLAG_SVC_RQST,
+					"%s: epoll busy poll params failed (%d)",
+					__func__, errno);
+		}
+#endif
 	} else {
 		/* legacy fdset (currently unhooked) */
 		sr_rec->ev_type = SVC_EVENT_FDSET;
@@ -309,6 +471,7 @@ svc_rqst_new_evchan(uint32_t *chan_id /* OUT */, void *u_data, uint32_t flags)
 	sr_rec->gen = 0;
 	mutex_init(&sr_rec->mtx, NULL);
 	TAILQ_INIT(&sr_rec->xprt_q);
+	TAILQ_INIT(&sr_rec->ready_q);
 
 	t = rbtx_partition_of_scalar(&svc_rqst_set.xt, sr_rec->id_k);
 	mutex_lock(&t->mtx);
@@ -317,43 +480,95 @@ svc_rqst_new_evchan(uint32_t *chan_id /* OUT */, void *u_data, uint32_t flags)
 				   sr_rec->id_k);
 	mutex_unlock(&t->mtx);
 
+	(void)clock_gettime(CLOCK_MONOTONIC_FAST, &sr_rec->rate.ts);
+	if (sr_rec->flags & SVC_RQST_FLAG_BALANCE) {
+		mutex_lock(&svc_rqst_set.mtx);
+		TAILQ_INSERT_TAIL(&svc_rqst_set.balance_q, sr_rec, balance_q);
+		mutex_unlock(&svc_rqst_set.mtx);
+	}
+
 	__warnx(TIRPC_DEBUG_FLAG_SVC_RQST,
-		"%s: create evchan %d socketpair %d:%d", __func__, n_id,
-		sr_rec->sv[0], sr_rec->sv[1]);
+		"%s: create evchan %d eventfd %d", __func__, n_id,
+		sr_rec->ev_fd);
 
 	*chan_id = n_id;
 	return (code);
 }
 
 /*
- * Write 4-byte value to shared event-notification channel.  The
- * value as presently implemented can be interpreted only by one consumer,
- * so is not relied on.
+ * Wake the channel.  Signals coalesce: until the channel thread consumes
+ * the wakeup, further ones cost no system call.
  */
 static inline void
-ev_sig(int fd, uint32_t sig)
+ev_sig(struct svc_rqst_rec *sr_rec)
 {
-	int code = write(fd, &sig, sizeof(uint32_t));
-	__warnx(TIRPC_DEBUG_FLAG_SVC_RQST, "%s: fd %d sig %d", __func__, fd,
-		sig);
+	uint64_t one = 1;
+	int code;
+
+	if (atomic_postset_uint32_t_bits(&sr_rec->ev_pending, 1))
+		return;
+
+	code = write(sr_rec->ev_fd, &one, sizeof(one));
+	__warnx(TIRPC_DEBUG_FLAG_SVC_RQST, "%s: fd %d", __func__,
+		sr_rec->ev_fd);
 	if (code < 1)
 		__warnx(TIRPC_DEBUG_FLAG_SVC_RQST,
-			"%s: error writing to event socket (%d:%d)", __func__,
+			"%s: error writing to eventfd (%d:%d)", __func__,
 			code, errno);
 }
 
 /*
- * Read a single 4-byte value from the shared event-notification channel,
- * the socket is in non-blocking mode.  The value read is returned.
+ * Consume all signals so far (non-blocking).  Clearing ev_pending first
+ * means a racing ev_sig() may cost an extra wakeup, but is never lost.
  */
-static inline uint32_t
-consume_ev_sig_nb(int fd)
+static inline void
+consume_ev_sig_nb(struct svc_rqst_rec *sr_rec)
 {
-	uint32_t sig = 0;
+	uint64_t count;
 	int code __attribute__ ((unused));
 
-	code = read(fd, &sig, sizeof(uint32_t));
-	return (sig);
+	atomic_clear_uint32_t_bits(&sr_rec->ev_pending, 1);
+	code = read(sr_rec->ev_fd, &count, sizeof(count));
+}
+
+/*
+ * Queue a command for the channel thread.  xprt (if any) is held until
+ * it is applied.
+ */
+static void
+svc_rqst_post(struct svc_rqst_rec *sr_rec, uint32_t type, SVCXPRT *xprt,
+	      uint32_t signals)
+{
+	struct svc_rqst_cmd *cmd = mem_alloc(sizeof(*cmd));
+
+	cmd->code = 0;
+	cmd->type = type;
+	cmd->signals = signals;
+	cmd->xprt = xprt;
+	if (xprt)
+		SVC_REF(xprt, SVC_REF_FLAG_NONE);
+
+	mutex_lock(&sr_rec->cmd_mtx);
+	TAILQ_INSERT_TAIL(&sr_rec->cmd_q, cmd, q);
+	mutex_unlock(&sr_rec->cmd_mtx);
+
+	ev_sig(sr_rec);
+}
+
+/* drop unapplied commands, sr_rec going away */
+static void
+svc_rqst_cmd_flush(struct svc_rqst_rec *sr_rec)
+{
+	struct svc_rqst_cmd *cmd;
+
+	mutex_lock(&sr_rec->cmd_mtx);
+	while ((cmd = TAILQ_FIRST(&sr_rec->cmd_q))) {
+		TAILQ_REMOVE(&sr_rec->cmd_q, cmd, q);
+		if (cmd->xprt)
+			SVC_RELEASE(cmd->xprt, SVC_RELEASE_FLAG_NONE);
+		mem_free(cmd, sizeof(*cmd));
+	}
+	mutex_unlock(&sr_rec->cmd_mtx);
 }
 
 static inline void
@@ -367,11 +582,266 @@ svc_rqst_release(struct svc_rqst_rec *sr_rec /* LOCKED => UNLOCKED */)
 
 	if (refcnt == 0) {
 		/* assert sr_rec DESTROYED */
+		svc_rqst_cmd_flush(sr_rec);
+		close(sr_rec->ev_fd);
+		mutex_destroy(&sr_rec->cmd_mtx);
 		mutex_destroy(&sr_rec->mtx);
 		mem_free(sr_rec, sizeof(struct svc_rqst_rec));
 	}
 }
 
+#if defined(TIRPC_EPOLL) && defined(USE_IO_URING)
+/*
+ * SVC_XPRT_FLAG_RECV_SEGS input (xp_ev_recv).  On a SVC_EVENT_URING
+ * channel with multishot recv, the kernel receives into the channel's
+ * provided buffers, and the event thread moves each filled one onto inq
+ * in completion order, for svc_vc_segs_drain() to take instead of reading
+ * the socket.  Elsewhere, it reads itself, marked READING.
+ *
+ * Input stays in order across channels: the xprt is hooked on its next
+ * one only after the recv armed on the last has completed for good, and
+ * (to arm a recv) while no reader reads; REHOOK posts SVC_RQST_CMD_REG
+ * then.  The recv holds a reference, so that its late completions never
+ * reach another connection reusing the xprt.
+ */
+struct svc_rqst_recv {
+	struct poolq_head inq;	/* segments received */
+	SVCXPRT *xprt;		/* NULL once destroyed */
+	uint32_t refs;		/* the xprt's, and the recv armed */
+	uint32_t bytes;		/* on inq */
+	uint32_t state;		/* SVC_RQST_RECV_* */
+	int err;		/* ESHUTDOWN at EOF, or the recv's */
+};				/* inq.qmutex */
+
+#define SVC_RQST_RECV_ARMED	0x0001	/* until its last completion */
+#define SVC_RQST_RECV_STOPPED	0x0002	/* cancelled, inq over ioq_hiwat */
+#define SVC_RQST_RECV_REARM	0x0004	/* again, at its last completion */
+#define SVC_RQST_RECV_READING	0x0008	/* the reader reads the socket */
+#define SVC_RQST_RECV_REHOOK	0x0010	/* hook deferred until both end */
+
+/* LOCKED => UNLOCKED */
+static void
+svc_rqst_recv_put(struct svc_rqst_recv *recv)
+{
+	struct poolq_entry *have;
+	uint32_t refs = --(recv->refs);
+
+	mutex_unlock(&recv->inq.qmutex);
+	if (refs)
+		return;
+
+	while ((have = TAILQ_FIRST(&recv->inq.qh))) {
+		TAILQ_REMOVE(&recv->inq.qh, have, q);
+		svc_ioq_seg_unref(IOQ_(have));
+	}
+	poolq_head_destroy(&recv->inq);
+	mem_free(recv, sizeof(*recv));
+}
+
+/* the kernel receives for the xprt on this channel */
+static inline bool
+svc_rqst_recv_mode(struct svc_rqst_rec *sr_rec, SVCXPRT *xprt)
+{
+	return (sr_rec->ev_type == SVC_EVENT_URING
+		&& sr_rec->ev_u.uring.ring.recv_multi
+		&& (xprt->xp_flags & SVC_XPRT_FLAG_RECV_SEGS));
+}
+
+/* only queued, as polls.  sr_rec LOCKED */
+static int
+svc_rqst_recv_arm(struct svc_rqst_rec *sr_rec, SVCXPRT *xprt,
+		  struct svc_rqst_recv *recv)
+{
+	int code = 0;
+
+	mutex_lock(&recv->inq.qmutex);
+	if (recv->state & SVC_RQST_RECV_ARMED) {
+		/* stopped, but not yet completed */
+		recv->state |= SVC_RQST_RECV_REARM;
+	} else {
+		code = svc_uring_recv_multi(&sr_rec->ev_u.uring.ring,
+					    xprt->xp_fd,
+					    (uintptr_t)recv | SVC_RQST_EV_RECV);
+		if (!code) {
+			recv->state |= SVC_RQST_RECV_ARMED;
+			(recv->refs)++;
+		}
+	}
+	if (!code)
+		recv->state &= ~SVC_RQST_RECV_STOPPED;
+	mutex_unlock(&recv->inq.qmutex);
+	return (code);
+}
+
+/* a hook deferred below.  recv LOCKED, so the xprt is not yet destroyed */
+static void
+svc_rqst_recv_rehook(SVCXPRT *xprt)
+{
+	struct svc_rqst_rec *xp_ev = (struct svc_rqst_rec *)xprt->xp_ev;
+
+	if (xp_ev
+	 && !(atomic_fetch_uint16_t(&xprt->xp_flags)
+	      & (SVC_XPRT_FLAG_DESTROYED | SVC_XPRT_FLAG_DESTROYING)))
+		svc_rqst_post(xp_ev, SVC_RQST_CMD_REG, xprt, 0);
+}
+
+/*
+ * True when hooking now could reorder input: hooked again when the last
+ * recv completes for good, or the reader stops reading.  sr_rec LOCKED.
+ */
+static bool
+svc_rqst_recv_defer(SVCXPRT *xprt, struct svc_rqst_rec *sr_rec)
+{
+	struct svc_rqst_recv *recv = xprt->xp_ev_recv;
+	uint32_t busy = SVC_RQST_RECV_ARMED;
+	bool defer;
+
+	if (!(xprt->xp_flags & SVC_XPRT_FLAG_RECV_SEGS))
+		return (false);
+
+	if (!recv) {
+		/* before any reader */
+		recv = mem_zalloc(sizeof(*recv));
+		poolq_head_setup(&recv->inq);
+		recv->xprt = xprt;
+		recv->refs = 1;
+		xprt->xp_ev_recv = recv;
+	}
+	if (svc_rqst_recv_mode(sr_rec, xprt))
+		busy |= SVC_RQST_RECV_READING;
+
+	mutex_lock(&recv->inq.qmutex);
+	defer = !!(recv->state & busy);
+	if (defer)
+		recv->state |= SVC_RQST_RECV_REHOOK;
+	mutex_unlock(&recv->inq.qmutex);
+	return (defer);
+}
+
+/* destroyed; its recv may still complete */
+static void
+svc_rqst_recv_detach(SVCXPRT *xprt)
+{
+	struct svc_rqst_recv *recv = xprt->xp_ev_recv;
+
+	if (!recv)
+		return;
+
+	xprt->xp_ev_recv = NULL;
+	mutex_lock(&recv->inq.qmutex);
+	recv->xprt = NULL;
+	svc_rqst_recv_put(recv);
+}
+
+/*
+ * The recv's last completion (without IORING_CQE_F_MORE).  After an
+ * overflow or running out of buffers, re-armed in place, with the same
+ * reference; otherwise a deferred hook may go ahead.
+ * sr_rec LOCKED, recv LOCKED => UNLOCKED.
+ */
+static void
+svc_rqst_uring_recv_ended(struct svc_rqst_rec *sr_rec,
+			  struct svc_rqst_recv *recv, int res)
+{
+	SVCXPRT *xprt = recv->xprt;
+	uint16_t xp_flags;
+
+	if ((res > 0 || res == -ENOBUFS)
+	 && !(recv->state & SVC_RQST_RECV_STOPPED))
+		recv->state |= SVC_RQST_RECV_REARM;
+
+	if ((recv->state & SVC_RQST_RECV_REARM) && xprt && !recv->err) {
+		xp_flags = atomic_fetch_uint16_t(&xprt->xp_flags);
+		if (xprt->xp_ev == sr_rec
+		 && (xp_flags & SVC_XPRT_FLAG_ADDED)
+		 && !(xp_flags & SVC_XPRT_FLAG_DESTROYED)
+		 && !svc_uring_recv_multi(&sr_rec->ev_u.uring.ring,
+					  xprt->xp_fd,
+					  (uintptr_t)recv | SVC_RQST_EV_RECV)) {
+			recv->state &= ~(SVC_RQST_RECV_REARM
+					 | SVC_RQST_RECV_STOPPED);
+			mutex_unlock(&recv->inq.qmutex);
+			return;
+		}
+	}
+
+	recv->state &= ~(SVC_RQST_RECV_ARMED | SVC_RQST_RECV_REARM);
+	if ((recv->state & SVC_RQST_RECV_REHOOK)
+	 && !(recv->state & SVC_RQST_RECV_READING)) {
+		recv->state &= ~SVC_RQST_RECV_REHOOK;
+		if (xprt)
+			svc_rqst_recv_rehook(xprt);
+	}
+	svc_rqst_recv_put(recv);
+}
+
+/*
+ * A recv completion, while reaping (sr_rec LOCKED), so that no other
+ * thread running the channel queues later input first.  The buffer
+ * filled goes onto the xprt's inq, replaced in the ring (committed by
+ * the caller); the completion becomes an input event for the xprt, as a
+ * poll's, or SVC_URING_DATA_NONE.
+ */
+static void
+svc_rqst_uring_recvd(struct svc_rqst_rec *sr_rec, struct io_uring_cqe *cqe)
+{
+	struct svc_uring *ring = &sr_rec->ev_u.uring.ring;
+	struct xdr_ioq_uv **bufs = sr_rec->ev_u.uring.bufs;
+	struct svc_rqst_recv *recv = (struct svc_rqst_recv *)(uintptr_t)
+		(cqe->user_data & ~(uint64_t)SVC_RQST_EV_RECV);
+	struct xdr_ioq_uv *seg = NULL;
+	SVCXPRT *xprt;
+	int res = cqe->res;
+	uint16_t bid;
+	bool event;
+
+	if (cqe->flags & IORING_CQE_F_BUFFER) {
+		bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+		seg = bufs[bid];
+		bufs[bid] = svc_ioq_seg_get();
+		svc_uring_buf_add(ring, bufs[bid]->v.vio_head,
+				  ioquv_size(bufs[bid]), bid);
+	}
+
+	mutex_lock(&recv->inq.qmutex);
+	xprt = recv->xprt;
+	if (res > 0 && seg && xprt) {
+		seg->v.vio_tail = (char *)seg->v.vio_head + res;
+		TAILQ_INSERT_TAIL(&recv->inq.qh, &seg->uvq, q);
+		(recv->inq.qcount)++;
+		recv->bytes += res;
+		seg = NULL;
+
+		/* the reader is behind, or parked: it re-arms */
+		if (recv->bytes > __svc_params->ioq_hiwat
+		 && (cqe->flags & IORING_CQE_F_MORE)
+		 && !(recv->state & SVC_RQST_RECV_STOPPED)
+		 && !svc_uring_poll_remove(ring, cqe->user_data))
+			recv->state |= SVC_RQST_RECV_STOPPED;
+	} else if (!res) {
+		recv->err = ESHUTDOWN;
+	} else if (res < 0 && res != -ECANCELED && res != -ENOBUFS) {
+		recv->err = -res;
+	}
+	event = xprt && res != -ECANCELED && res != -ENOBUFS;
+
+	if (!(cqe->flags & IORING_CQE_F_MORE))
+		svc_rqst_uring_recv_ended(sr_rec, recv, res);
+	else
+		mutex_unlock(&recv->inq.qmutex);
+
+	if (seg)
+		svc_ioq_seg_unref(seg);
+
+	if (event) {
+		cqe->user_data = (uintptr_t)xprt;
+		cqe->res = res > 0 ? POLLIN : POLLIN | POLLHUP;
+		cqe->flags = IORING_CQE_F_MORE;	/* no poll to re-arm */
+	} else
+		cqe->user_data = SVC_URING_DATA_NONE;
+}
+#endif
+
 static inline int
 svc_rqst_unhook_events(SVCXPRT *xprt, struct svc_rqst_rec *sr_rec /* LOCKED */)
 {
@@ -390,24 +860,41 @@ svc_rqst_unhook_events(SVCXPRT *xprt, struct svc_rqst_rec *sr_rec /* LOCKED */)
 			__warnx(TIRPC_DEBUG_FLAG_ERROR,
 				"%s: %p epoll del failed fd %d "
 				"sr_rec %p epoll_fd %d "
-				"control fd pair (%d:%d) (%d, %d)",
+				"control fd %d (%d, %d)",
 				__func__, xprt, xprt->xp_fd,
 				sr_rec, sr_rec->ev_u.epoll.epoll_fd,
-				sr_rec->sv[0], sr_rec->sv[1],
+				sr_rec->ev_fd,
 				code, errno);
 			code = errno;
 		} else {
 			__warnx(TIRPC_DEBUG_FLAG_SVC_RQST,
 				"%s: %p epoll del fd %d "
 				"sr_rec %p epoll_fd %d "
-				"control fd pair (%d:%d) (%d, %d)",
+				"control fd %d (%d, %d)",
 				__func__, xprt, xprt->xp_fd,
 				sr_rec, sr_rec->ev_u.epoll.epoll_fd,
-				sr_rec->sv[0], sr_rec->sv[1],
+				sr_rec->ev_fd,
 				code, errno);
 		}
 		break;
 	}
+#endif
+#if defined(TIRPC_EPOLL) && defined(USE_IO_URING)
+	case SVC_EVENT_URING:
+		/* cancel now, the xprt is going away; its poll, or recv */
+		code = svc_uring_poll_remove(&sr_rec->ev_u.uring.ring,
+					     svc_rqst_recv_mode(sr_rec, xprt)
+					     ? (uintptr_t)xprt->xp_ev_recv
+					       | SVC_RQST_EV_RECV
+					     : (uintptr_t)xprt);
+		if (!code)
+			code = svc_uring_enter(&sr_rec->ev_u.uring.ring,
+					       false, 0);
+		__warnx(code ? TIRPC_DEBUG_FLAG_ERROR
+			     : TIRPC_DEBUG_FLAG_SVC_RQST,
+			"%s: %p uring poll remove fd %d sr_rec %p (%d)",
+			__func__, xprt, xprt->xp_fd, sr_rec, code);
+		break;
 #endif
 	default:
 		/* XXX formerly select/fd_set case, now placeholder for new
@@ -418,10 +905,50 @@ svc_rqst_unhook_events(SVCXPRT *xprt, struct svc_rqst_rec *sr_rec /* LOCKED */)
 	return (code);
 }
 
+/*
+ * The send side is left on the channel until the xprt leaves it.  A
+ * writer still waiting retries (and waits on the xprt's new channel, or
+ * discards its output when destroyed).
+ */
+static void
+svc_rqst_unhook_send(SVCXPRT *xprt, struct svc_rqst_rec *sr_rec /* LOCKED */)
+{
+	switch (sr_rec->ev_type) {
+#if defined(TIRPC_EPOLL)
+	case SVC_EVENT_EPOLL:
+		(void)epoll_ctl(sr_rec->ev_u.epoll.epoll_fd, EPOLL_CTL_DEL,
+				xprt->xp_fd_send, NULL);
+		break;
+#endif
+#if defined(TIRPC_EPOLL) && defined(USE_IO_URING)
+	case SVC_EVENT_URING:
+		if (!svc_uring_poll_remove(&sr_rec->ev_u.uring.ring,
+					   (uintptr_t)xprt | SVC_RQST_EV_SEND))
+			(void)svc_uring_enter(&sr_rec->ev_u.uring.ring,
+					      false, 0);
+		break;
+#endif
+	default:
+		break;
+	}
+
+	if (atomic_postclear_uint16_t_bits(&xprt->xp_flags,
+					   SVC_XPRT_FLAG_SEND_WAIT)
+	    & SVC_XPRT_FLAG_SEND_WAIT)
+		svc_ioq_resume(xprt);
+}
+
+#if defined(TIRPC_EPOLL)
+/* the channel run by this thread, if any */
+static __thread struct svc_rqst_rec *svc_rqst_self;
+#endif
+
 int
 svc_rqst_rearm_events(SVCXPRT *xprt, uint32_t __attribute__ ((unused)) flags)
 {
-	struct svc_rqst_rec *sr_rec = (struct svc_rqst_rec *)xprt->xp_ev;
+	struct svc_rqst_rec *sr_rec =
+		(struct svc_rqst_rec *)atomic_fetch_voidptr(&xprt->xp_ev);
+	bool flush __attribute__ ((unused)) = false;
 	int code = 0;
 
 	if (svc_rqst_init_failure())
@@ -430,12 +957,32 @@ svc_rqst_rearm_events(SVCXPRT *xprt, uint32_t __attribute__ ((unused)) flags)
 	if (xprt->xp_flags & SVC_XPRT_FLAG_DESTROYED)
 		return (0);
 
+	/* SVC_XPRT_FLAG_EDGE stays armed, so another thread may be moving
+	 * it (below) meanwhile; its new channel hooks its events
+	 */
+	if (!sr_rec)
+		return (0);
+
 	/* MUST follow the destroyed check above */
 	if (sr_rec->states & SVC_RQST_STATE_DESTROYED)
 		return (0);
 
+	/* svc_rqst_evchan_migrate(): the event is disarmed (oneshot) and
+	 * handled, so move while no other thread can see the xprt
+	 */
+	if (unlikely(atomic_fetch_uint32_t(&xprt->xp_ev_next))) {
+		uint32_t chan_id =
+			atomic_postclear_uint32_t_bits(&xprt->xp_ev_next,
+						       UINT32_MAX);
+
+		if (chan_id && chan_id != sr_rec->id_k
+		 && !svc_rqst_evchan_reg(chan_id, xprt, SVC_RQST_FLAG_NONE))
+			return (0);
+	}
+
 	mutex_lock(&sr_rec->mtx);
-	if (atomic_fetch_uint16_t(&xprt->xp_flags) & SVC_XPRT_FLAG_ADDED) {
+	if (xprt->xp_ev == sr_rec
+	 && (atomic_fetch_uint16_t(&xprt->xp_flags) & SVC_XPRT_FLAG_ADDED)) {
 
 		switch (sr_rec->ev_type) {
 #if defined(TIRPC_EPOLL)
@@ -443,6 +990,10 @@ svc_rqst_rearm_events(SVCXPRT *xprt, uint32_t __attribute__ ((unused)) flags)
 		{
 			struct epoll_event *ev = &xprt->ev_u.epoll.event;
 
+			/* still armed */
+			if (xprt->xp_flags & SVC_XPRT_FLAG_EDGE)
+				break;
+
 			/* set up epoll user data */
 			/* ev->data.ptr = xprt; *//* XXX already set */
 			ev->events = EPOLLIN | EPOLLONESHOT;
@@ -454,13 +1005,33 @@ svc_rqst_rearm_events(SVCXPRT *xprt, uint32_t __attribute__ ((unused)) flags)
 			__warnx(TIRPC_DEBUG_FLAG_SVC_RQST,
 				"%s: %p epoll arm fd %d "
 				"sr_rec %p epoll_fd %d "
-				"control fd pair (%d:%d) (%d, %d)",
+				"control fd %d (%d, %d)",
 				__func__, xprt, xprt->xp_fd,
 				sr_rec, sr_rec->ev_u.epoll.epoll_fd,
-				sr_rec->sv[0], sr_rec->sv[1],
+				sr_rec->ev_fd,
 				code, errno);
 			break;
 		}
+#endif
+#if defined(TIRPC_EPOLL) && defined(USE_IO_URING)
+		case SVC_EVENT_URING:
+			/* still armed (multishot) */
+			if ((xprt->xp_flags & SVC_XPRT_FLAG_EDGE)
+			 && sr_rec->ev_u.uring.ring.multishot)
+				break;
+
+			/* only queued; the event thread submits it with its
+			 * next wait, other threads must submit now
+			 */
+			code = svc_uring_poll_add(&sr_rec->ev_u.uring.ring,
+						  xprt->xp_fd, POLLIN,
+						  (uintptr_t)xprt);
+			flush = !code && svc_rqst_self != sr_rec;
+
+			__warnx(TIRPC_DEBUG_FLAG_SVC_RQST,
+				"%s: %p uring arm fd %d sr_rec %p (%d)",
+				__func__, xprt, xprt->xp_fd, sr_rec, code);
+			break;
 #endif
 		default:
 			/* XXX formerly select/fd_set case, now placeholder
@@ -470,80 +1041,473 @@ svc_rqst_rearm_events(SVCXPRT *xprt, uint32_t __attribute__ ((unused)) flags)
 	}
 
 	mutex_unlock(&sr_rec->mtx);
+
+#if defined(TIRPC_EPOLL) && defined(USE_IO_URING)
+	if (flush)
+		code = svc_uring_enter(&sr_rec->ev_u.uring.ring, false, 0);
+#endif
 	return (code);
 }
 
-static inline int
-svc_rqst_hook_events(SVCXPRT *xprt, struct svc_rqst_rec *sr_rec /* LOCKED */)
+#if defined(TIRPC_EPOLL) && defined(USE_IO_URING)
+/**
+ * @brief Take the input received for an xprt
+ *
+ * Called by svc_vc_segs_drain(), the only reader of the xprt, to append
+ * the segments received meanwhile to qh, in order.  A recv stopped at
+ * ioq_hiwat is armed again.
+ *
+ * @return 0 while the channel receives, EAGAIN when the caller reads the
+ * socket itself (then calls svc_rqst_recv_done()), or the connection's
+ * error (ESHUTDOWN at EOF).
+ */
+int
+svc_rqst_recv_take(SVCXPRT *xprt, struct q_head *qh)
 {
-	int code = 0;
+	struct svc_rqst_recv *recv = xprt->xp_ev_recv;
+	struct svc_rqst_rec *sr_rec;
+	bool resume = false;
+	bool flush = false;
+	int code;
 
-	switch (sr_rec->ev_type) {
-#if defined(TIRPC_EPOLL)
-	case SVC_EVENT_EPOLL:
-	{
-		struct epoll_event *ev = &xprt->ev_u.epoll.event;
+	if (!recv)
+		return (EAGAIN);
+
+	mutex_lock(&recv->inq.qmutex);
+	TAILQ_CONCAT(qh, &recv->inq.qh, q);
+	recv->inq.qcount = 0;
+	recv->bytes = 0;
+	code = recv->err;
+	if (code)
+		;
+	else if (!(recv->state & SVC_RQST_RECV_STOPPED)) {
+		if (!(recv->state & SVC_RQST_RECV_ARMED)) {
+			recv->state |= SVC_RQST_RECV_READING;
+			code = EAGAIN;
+		}
+	} else if (recv->state & SVC_RQST_RECV_ARMED) {
+		/* its cancel has yet to complete */
+		recv->state &= ~SVC_RQST_RECV_STOPPED;
+		recv->state |= SVC_RQST_RECV_REARM;
+	} else
+		resume = true;
+	mutex_unlock(&recv->inq.qmutex);
+
+	if (!resume)
+		return (code);
 
-		/* set up epoll user data */
-		ev->data.ptr = xprt;
+	code = EAGAIN;
+	sr_rec = (struct svc_rqst_rec *)xprt->xp_ev;
+	if (sr_rec) {
+		mutex_lock(&sr_rec->mtx);
+		if (xprt->xp_ev == sr_rec
+		 && (atomic_fetch_uint16_t(&xprt->xp_flags)
+		     & SVC_XPRT_FLAG_ADDED)
+		 && svc_rqst_recv_mode(sr_rec, xprt)
+		 && !svc_rqst_recv_arm(sr_rec, xprt, recv)) {
+			code = 0;
+			flush = svc_rqst_self != sr_rec;
+		}
+		mutex_unlock(&sr_rec->mtx);
+	}
+	if (flush)
+		(void)svc_uring_enter(&sr_rec->ev_u.uring.ring, false, 0);
+	if (code) {
+		/* moved on, read as elsewhere */
+		mutex_lock(&recv->inq.qmutex);
+		recv->state &= ~SVC_RQST_RECV_STOPPED;
+		recv->state |= SVC_RQST_RECV_READING;
+		mutex_unlock(&recv->inq.qmutex);
+	}
+	return (code);
+}
 
-		/* wait for read events, level triggered, oneshot */
-		ev->events = EPOLLIN | EPOLLONESHOT;
+/* after svc_rqst_recv_take() returned EAGAIN, done reading */
+void
+svc_rqst_recv_done(SVCXPRT *xprt)
+{
+	struct svc_rqst_recv *recv = xprt->xp_ev_recv;
 
-		/* add to epoll vector */
-		code = epoll_ctl(sr_rec->ev_u.epoll.epoll_fd,
-				 EPOLL_CTL_ADD, xprt->xp_fd, ev);
-		if (code) {
-			__warnx(TIRPC_DEBUG_FLAG_ERROR,
-				"%s: %p epoll add failed fd %d "
-				"sr_rec %p epoll_fd %d "
-				"control fd pair (%d:%d) (%d, %d)",
-				__func__, xprt, xprt->xp_fd,
-				sr_rec, sr_rec->ev_u.epoll.epoll_fd,
-				sr_rec->sv[0], sr_rec->sv[1],
-				code, errno);
-			code = errno;
-		} else {
-			atomic_set_uint16_t_bits(&xprt->xp_flags,
-						 SVC_XPRT_FLAG_ADDED);
+	if (!recv)
+		return;
 
-			__warnx(TIRPC_DEBUG_FLAG_SVC_RQST,
-				"%s: %p epoll add fd %d "
-				"sr_rec %p epoll_fd %d "
-				"control fd pair (%d:%d) (%d, %d)",
-				__func__, xprt, xprt->xp_fd,
-				sr_rec, sr_rec->ev_u.epoll.epoll_fd,
-				sr_rec->sv[0], sr_rec->sv[1],
-				code, errno);
-		}
-		break;
+	mutex_lock(&recv->inq.qmutex);
+	recv->state &= ~SVC_RQST_RECV_READING;
+	if ((recv->state & SVC_RQST_RECV_REHOOK)
+	 && !(recv->state & SVC_RQST_RECV_ARMED)) {
+		recv->state &= ~SVC_RQST_RECV_REHOOK;
+		svc_rqst_recv_rehook(xprt);
 	}
+	mutex_unlock(&recv->inq.qmutex);
+}
+#else
+int
+svc_rqst_recv_take(SVCXPRT *xprt, struct q_head *qh)
+{
+	return (EAGAIN);
+}
+
+void
+svc_rqst_recv_done(SVCXPRT *xprt)
+{
+}
 #endif
-	default:
-		/* XXX formerly select/fd_set case, now placeholder for new
-		 * event systems, reworked select, etc. */
-		break;
-	}			/* switch */
 
-	ev_sig(sr_rec->sv[0], 0);	/* send wakeup */
+/* SVC_RQST_FLAG_WORKER task, and requeued xprts */
+static void
+svc_rqst_getreq_task(struct work_pool_entry *wpe)
+{
+	SVCXPRT *xprt = (SVCXPRT *) wpe->arg;
 
-	return (code);
+	/* ! LOCKED */
+	(void)xprt->xp_ops->xp_getreq(xprt);
+	__warnx(TIRPC_DEBUG_FLAG_REFCNT,
+		"%s: %p xp_refs %" PRIu32
+		" post xp_getreq",
+		__func__, xprt,
+		xprt->xp_refs);
 }
 
-/*
- * indirect on xp_ev and xp_evq protected by sr_rec lock
+/**
+ * @brief Yield an xprt with requests pending to the others
+ *
+ * Called from xp_getreq in place of svc_rqst_rearm_events(), keeping the
+ * ref and the event (still disarmed, or SVC_XPRT_EV_ACTIVE).
+ * SVC_RQST_FLAG_WORKER channels queue it to svc_work_pool, behind the
+ * work already there; otherwise a channel thread calls xp_getreq again
+ * after its next poll.
+ *
+ * @return 0, or errno when the caller should carry on itself.
  */
-static void
-svc_rqst_unreg(SVCXPRT *xprt, struct svc_rqst_rec *sr_rec /* LOCKED */)
+int
+svc_rqst_requeue(SVCXPRT *xprt)
 {
-	uint16_t xp_flags = atomic_postclear_uint16_t_bits(&xprt->xp_flags,
-							   SVC_XPRT_FLAG_ADDED);
+	struct svc_rqst_rec *sr_rec = (struct svc_rqst_rec *)xprt->xp_ev;
 
-	/* clear events */
-	if (xp_flags & SVC_XPRT_FLAG_ADDED)
-		(void)svc_rqst_unhook_events(xprt, sr_rec);
+	if (!sr_rec || (xprt->xp_flags & SVC_XPRT_FLAG_DESTROYED))
+		return (EINVAL);
+
+	xprt->xp_wpe.fun = svc_rqst_getreq_task;
+	xprt->xp_wpe.arg = xprt;
+
+	if (sr_rec->flags & SVC_RQST_FLAG_WORKER) {
+		atomic_inc_uint64_t(&sr_rec->requeues);
+		return (work_pool_submit(&svc_work_pool, &xprt->xp_wpe));
+	}
+
+	mutex_lock(&sr_rec->mtx);
+	if ((sr_rec->signals & SVC_RQST_SIGNAL_SHUTDOWN)
+	 || (sr_rec->states & SVC_RQST_STATE_DESTROYED)) {
+		mutex_unlock(&sr_rec->mtx);
+		return (ESHUTDOWN);
+	}
+	TAILQ_INSERT_TAIL(&sr_rec->ready_q, &xprt->xp_wpe.pqe, q);
+	mutex_unlock(&sr_rec->mtx);
+	atomic_inc_uint64_t(&sr_rec->requeues);
+
+#if defined(TIRPC_EPOLL)
+	/* a channel thread polls again before blocking */
+	if (svc_rqst_self != sr_rec)
+#endif
+		ev_sig(sr_rec);
+
+	return (0);
+}
+
+/**
+ * @brief Continue an xprt's getreq in another svc_work_pool task
+ *
+ * Called from xp_getreq, holding the ref, for a call classed other than
+ * the task reading it (svc_classify_t).  Only SVC_RQST_FLAG_WORKER
+ * channels hand getreq to svc_work_pool; others keep it on their thread.
+ *
+ * @return 0, or errno when the caller should carry on itself.
+ */
+int
+svc_rqst_submit(SVCXPRT *xprt, struct work_pool_entry *wpe)
+{
+	struct svc_rqst_rec *sr_rec = (struct svc_rqst_rec *)xprt->xp_ev;
+
+	if (!sr_rec || !(sr_rec->flags & SVC_RQST_FLAG_WORKER)
+	 || (xprt->xp_flags & SVC_XPRT_FLAG_DESTROYED))
+		return (EINVAL);
+
+	/* draining, it would be dropped */
+	if (!atomic_fetch_int32_t(&svc_work_pool.params.thrd_max))
+		return (ESHUTDOWN);
+
+	return (work_pool_submit(&svc_work_pool, wpe));
+}
+
+/**
+ * @brief Wait for room to write, without a thread
+ *
+ * The xprt's output is full: at EPOLLOUT, svc_ioq_resume().  For epoll,
+ * the send side is a dup() of xp_fd, so it is armed (oneshot) apart from
+ * input.  After a successful return, the caller may no longer touch its
+ * output; it may be resumed at once.
+ *
+ * @return 0, or errno when the caller must wait itself.
+ */
+int
+svc_rqst_evchan_write(SVCXPRT *xprt)
+{
+	struct svc_rqst_rec *sr_rec = (struct svc_rqst_rec *)xprt->xp_ev;
+	bool flush __attribute__ ((unused)) = false;
+	uint16_t xp_flags;
+	int code = EINVAL;
+
+	if (!sr_rec || (xprt->xp_flags & SVC_XPRT_FLAG_DESTROYED))
+		return (EINVAL);
+
+	mutex_lock(&sr_rec->mtx);
+	if (xprt->xp_ev != sr_rec
+	 || (sr_rec->states & SVC_RQST_STATE_DESTROYED)) {
+		/* migrating, or going away */
+		mutex_unlock(&sr_rec->mtx);
+		return (EINVAL);
+	}
+
+	atomic_set_uint16_t_bits(&xprt->xp_flags, SVC_XPRT_FLAG_SEND_WAIT);
+
+	switch (sr_rec->ev_type) {
+#if defined(TIRPC_EPOLL)
+	case SVC_EVENT_EPOLL:
+	{
+		struct epoll_event ev = {
+			.events = EPOLLOUT | EPOLLONESHOT,
+			.data.u64 = (uintptr_t)xprt | SVC_RQST_EV_SEND,
+		};
+
+		if (xprt->xp_fd_send < 0) {
+			xprt->xp_fd_send = fcntl(xprt->xp_fd, F_DUPFD_CLOEXEC,
+						 0);
+			if (xprt->xp_fd_send < 0) {
+				code = errno;
+				break;
+			}
+		}
+
+		xp_flags = atomic_postset_uint16_t_bits(&xprt->xp_flags,
+						SVC_XPRT_FLAG_ADDED_SEND);
+		code = epoll_ctl(sr_rec->ev_u.epoll.epoll_fd,
+				 (xp_flags & SVC_XPRT_FLAG_ADDED_SEND)
+				 ? EPOLL_CTL_MOD : EPOLL_CTL_ADD,
+				 xprt->xp_fd_send, &ev) ? errno : 0;
+		if (code && !(xp_flags & SVC_XPRT_FLAG_ADDED_SEND))
+			atomic_clear_uint16_t_bits(&xprt->xp_flags,
+						   SVC_XPRT_FLAG_ADDED_SEND);
+		break;
+	}
+#endif
+#if defined(TIRPC_EPOLL) && defined(USE_IO_URING)
+	case SVC_EVENT_URING:
+		atomic_set_uint16_t_bits(&xprt->xp_flags,
+					 SVC_XPRT_FLAG_ADDED_SEND);
+		code = svc_uring_poll_add(&sr_rec->ev_u.uring.ring,
+					  xprt->xp_fd, POLLOUT,
+					  (uintptr_t)xprt | SVC_RQST_EV_SEND);
+		flush = !code && svc_rqst_self != sr_rec;
+		break;
+#endif
+	default:
+		break;
+	}
+
+	if (code)
+		atomic_clear_uint16_t_bits(&xprt->xp_flags,
+					   SVC_XPRT_FLAG_SEND_WAIT);
+	__warnx(code ? TIRPC_DEBUG_FLAG_ERROR : TIRPC_DEBUG_FLAG_SVC_RQST,
+		"%s: %p fd %d sr_rec %p wait for output (%d)",
+		__func__, xprt, xprt->xp_fd, sr_rec, code);
+	mutex_unlock(&sr_rec->mtx);
+
+#if defined(TIRPC_EPOLL) && defined(USE_IO_URING)
+	if (flush)
+		(void)svc_uring_enter(&sr_rec->ev_u.uring.ring, false, 0);
+#endif
+	return (code);
+}
+
+/* SVC_RQST_FLAG_BUSY_POLL: the socket polls its device queue on an empty
+ * read, rather than waiting for the interrupt.  Best effort; raising it
+ * above net.core.busy_read needs CAP_NET_ADMIN.
+ */
+static inline void
+svc_rqst_busy_poll_sock(SVCXPRT *xprt, struct svc_rqst_rec *sr_rec)
+{
+	int usecs = __svc_params->busy_poll_napi_us;
+
+	if (!(sr_rec->flags & SVC_RQST_FLAG_BUSY_POLL) || !usecs)
+		return;
+
+	if (setsockopt(xprt->xp_fd, SOL_SOCKET, SO_BUSY_POLL,
+		       &usecs, sizeof(usecs)))
+		__warnx(TIRPC_DEBUG_FLAG_SVC_RQST,
+			"%s: %p fd %d SO_BUSY_POLL failed (%d)",
+			__func__, xprt, xprt->xp_fd, errno);
+#if defined(SO_PREFER_BUSY_POLL)
+	usecs = 1;
+	(void)setsockopt(xprt->xp_fd, SOL_SOCKET, SO_PREFER_BUSY_POLL,
+			 &usecs, sizeof(usecs));
+#endif
+}
+
+#if defined(TIRPC_EPOLL) && defined(USE_IO_URING)
+/*
+ * Input received before the hook (by the recv on the last channel, its
+ * events dropped there once unhooked), that no poll here would report:
+ * queued as an event.  SVC_XPRT_FLAG_EDGE, so unless already receiving.
+ * sr_rec LOCKED.
+ */
+static void
+svc_rqst_recv_ready(SVCXPRT *xprt, struct svc_rqst_rec *sr_rec)
+{
+	struct svc_rqst_recv *recv = xprt->xp_ev_recv;
+	bool ready;
+
+	mutex_lock(&recv->inq.qmutex);
+	ready = recv->bytes || recv->err;
+	mutex_unlock(&recv->inq.qmutex);
+
+	if (!ready
+	 || (atomic_postset_uint32_t_bits(&xprt->xp_ev_busy,
+					  SVC_XPRT_EV_ACTIVE
+					  | SVC_XPRT_EV_PENDING)
+	     & SVC_XPRT_EV_ACTIVE))
+		return;
+
+	/* callout will release, as svc_rqst_requeue() */
+	SVC_REF(xprt, SVC_REF_FLAG_NONE);
+	xprt->xp_wpe.fun = svc_rqst_getreq_task;
+	xprt->xp_wpe.arg = xprt;
+	TAILQ_INSERT_TAIL(&sr_rec->ready_q, &xprt->xp_wpe.pqe, q);
+	atomic_inc_uint64_t(&sr_rec->requeues);
+
+	if (svc_rqst_self != sr_rec)
+		ev_sig(sr_rec);
+}
+#endif
+
+static inline int
+svc_rqst_hook_events(SVCXPRT *xprt, struct svc_rqst_rec *sr_rec /* LOCKED */)
+{
+	int code = 0;
+
+#if defined(TIRPC_EPOLL) && defined(USE_IO_URING)
+	if (svc_rqst_recv_defer(xprt, sr_rec))
+		return (0);
+#endif
+	svc_rqst_busy_poll_sock(xprt, sr_rec);
+
+	switch (sr_rec->ev_type) {
+#if defined(TIRPC_EPOLL)
+	case SVC_EVENT_EPOLL:
+	{
+		struct epoll_event *ev = &xprt->ev_u.epoll.event;
+
+		/* set up epoll user data */
+		ev->data.ptr = xprt;
+
+		/* wait for read events, level triggered, oneshot; or edge
+		 * triggered, drained by svc_vc_recv() and never rearmed
+		 */
+		if (xprt->xp_flags & SVC_XPRT_FLAG_EDGE)
+			ev->events = EPOLLIN | EPOLLET;
+		else
+			ev->events = EPOLLIN | EPOLLONESHOT;
+
+		/* before the add, another thread may see an event at once
+		 * (an edge lost if not handled)
+		 */
+		atomic_set_uint16_t_bits(&xprt->xp_flags,
+					 SVC_XPRT_FLAG_ADDED);
+
+		/* add to epoll vector */
+		code = epoll_ctl(sr_rec->ev_u.epoll.epoll_fd,
+				 EPOLL_CTL_ADD, xprt->xp_fd, ev);
+		if (code) {
+			atomic_clear_uint16_t_bits(&xprt->xp_flags,
+						   SVC_XPRT_FLAG_ADDED);
+			__warnx(TIRPC_DEBUG_FLAG_ERROR,
+				"%s: %p epoll add failed fd %d "
+				"sr_rec %p epoll_fd %d "
+				"control fd %d (%d, %d)",
+				__func__, xprt, xprt->xp_fd,
+				sr_rec, sr_rec->ev_u.epoll.epoll_fd,
+				sr_rec->ev_fd,
+				code, errno);
+			code = errno;
+		} else {
+			__warnx(TIRPC_DEBUG_FLAG_SVC_RQST,
+				"%s: %p epoll add fd %d "
+				"sr_rec %p epoll_fd %d "
+				"control fd %d (%d, %d)",
+				__func__, xprt, xprt->xp_fd,
+				sr_rec, sr_rec->ev_u.epoll.epoll_fd,
+				sr_rec->ev_fd,
+				code, errno);
+		}
+		break;
+	}
+#endif
+#if defined(TIRPC_EPOLL) && defined(USE_IO_URING)
+	case SVC_EVENT_URING:
+		/* submitted by the event thread, after the wakeup below;
+		 * oneshot, or multishot for edge triggered, as above; or a
+		 * recv, completing with the input itself
+		 */
+		if (svc_rqst_recv_mode(sr_rec, xprt))
+			code = svc_rqst_recv_arm(sr_rec, xprt,
+						 xprt->xp_ev_recv);
+		else if (xprt->xp_flags & SVC_XPRT_FLAG_EDGE)
+			code = svc_uring_poll_multi(&sr_rec->ev_u.uring.ring,
+						    xprt->xp_fd, POLLIN,
+						    (uintptr_t)xprt);
+		else
+			code = svc_uring_poll_add(&sr_rec->ev_u.uring.ring,
+						  xprt->xp_fd, POLLIN,
+						  (uintptr_t)xprt);
+		if (code) {
+			__warnx(TIRPC_DEBUG_FLAG_ERROR,
+				"%s: %p uring poll add failed fd %d "
+				"sr_rec %p (%d)",
+				__func__, xprt, xprt->xp_fd, sr_rec, code);
+		} else {
+			atomic_set_uint16_t_bits(&xprt->xp_flags,
+						 SVC_XPRT_FLAG_ADDED);
+			if (svc_rqst_recv_mode(sr_rec, xprt))
+				svc_rqst_recv_ready(xprt, sr_rec);
+		}
+		break;
+#endif
+	default:
+		/* XXX formerly select/fd_set case, now placeholder for new
+		 * event systems, reworked select, etc. */
+		break;
+	}			/* switch */
+
+	return (code);
+}
+
+/*
+ * indirect on xp_ev and xp_evq protected by sr_rec lock
+ */
+static void
+svc_rqst_unreg(SVCXPRT *xprt, struct svc_rqst_rec *sr_rec /* LOCKED */)
+{
+	uint16_t xp_flags = atomic_postclear_uint16_t_bits(&xprt->xp_flags,
+							   SVC_XPRT_FLAG_ADDED
+							 | SVC_XPRT_FLAG_ADDED_SEND);
+
+	/* clear events */
+	if (xp_flags & SVC_XPRT_FLAG_ADDED)
+		(void)svc_rqst_unhook_events(xprt, sr_rec);
+	if (xp_flags & SVC_XPRT_FLAG_ADDED_SEND)
+		svc_rqst_unhook_send(xprt, sr_rec);
 
 	TAILQ_REMOVE(&sr_rec->xprt_q, xprt, xp_evq);
+	atomic_dec_uint32_t(&sr_rec->n_xprts);
 
 	__warnx(TIRPC_DEBUG_FLAG_REFCNT | TIRPC_DEBUG_FLAG_SVC_RQST,
 		"%s: %p xp_refs %" PRIu32
@@ -562,6 +1526,71 @@ svc_rqst_unreg(SVCXPRT *xprt, struct svc_rqst_rec *sr_rec /* LOCKED */)
 	--(sr_rec->refcnt);
 }
 
+/*
+ * Apply the commands posted so far, as one batch, on a thread running
+ * the channel.  sr_rec LOCKED, but dropped while releasing xprts: the
+ * last ref would unregister them.  An xprt whose events cannot be hooked
+ * is unregistered and destroyed, as no event would ever reach it.
+ */
+static void
+svc_rqst_cmd_apply(struct svc_rqst_rec *sr_rec)
+{
+	struct cmd_head cmds = TAILQ_HEAD_INITIALIZER(cmds);
+	struct svc_rqst_cmd *cmd;
+	SVCXPRT *xprt;
+	bool held = false;
+
+	/* unlocked peek; a post always signals after queueing */
+	if (TAILQ_EMPTY(&sr_rec->cmd_q))
+		return;
+
+	mutex_lock(&sr_rec->cmd_mtx);
+	TAILQ_CONCAT(&cmds, &sr_rec->cmd_q, q);
+	mutex_unlock(&sr_rec->cmd_mtx);
+
+	TAILQ_FOREACH(cmd, &cmds, q) {
+		switch (cmd->type) {
+		case SVC_RQST_CMD_REG:
+			xprt = cmd->xprt;
+			held = true;
+
+			/* unless unregistered or moved since */
+			if (xprt->xp_ev == sr_rec
+			 && !(atomic_fetch_uint16_t(&xprt->xp_flags)
+			      & (SVC_XPRT_FLAG_ADDED
+				 | SVC_XPRT_FLAG_DESTROYED))) {
+				cmd->code = svc_rqst_hook_events(xprt, sr_rec);
+				if (cmd->code)
+					svc_rqst_unreg(xprt, sr_rec);
+			}
+			break;
+		case SVC_RQST_CMD_SIGNAL:
+			sr_rec->signals |= cmd->signals;
+			break;
+		default:
+			break;
+		}
+	}
+
+	if (held)
+		mutex_unlock(&sr_rec->mtx);
+	while ((cmd = TAILQ_FIRST(&cmds))) {
+		TAILQ_REMOVE(&cmds, cmd, q);
+		if (cmd->code) {
+			__warnx(TIRPC_DEBUG_FLAG_ERROR,
+				"%s: %p fd %d registration failed (%d)",
+				__func__, cmd->xprt, cmd->xprt->xp_fd,
+				cmd->code);
+			SVC_DESTROY(cmd->xprt);
+		}
+		if (cmd->xprt)
+			SVC_RELEASE(cmd->xprt, SVC_RELEASE_FLAG_NONE);
+		mem_free(cmd, sizeof(*cmd));
+	}
+	if (held)
+		mutex_lock(&sr_rec->mtx);
+}
+
 int
 svc_rqst_evchan_reg(uint32_t chan_id, SVCXPRT *xprt, uint32_t flags)
 {
@@ -606,22 +1635,40 @@ svc_rqst_evchan_reg(uint32_t chan_id, SVCXPRT *xprt, uint32_t flags)
 				__func__, xprt, chan_id);
 			return (0);
 		}
+		/* Never hold two channel locks: migrations between two
+		 * channels in both directions would take them in opposite
+		 * orders.  The lookup reference keeps sr_rec meanwhile.
+		 */
+		mutex_unlock(&sr_rec->mtx);
 		mutex_lock(&xp_ev->mtx);
 		if (xp_ev == (struct svc_rqst_rec *)xprt->xp_ev)
 			svc_rqst_unreg(xprt, xp_ev);
 		mutex_unlock(&xp_ev->mtx);
+		mutex_lock(&sr_rec->mtx);
 	}
 
 	if (flags & SVC_XPRT_FLAG_MASK)
 		atomic_set_uint16_t_bits(&xprt->xp_flags, flags);
 
 	TAILQ_INSERT_TAIL(&sr_rec->xprt_q, xprt, xp_evq);
+	atomic_inc_uint32_t(&sr_rec->n_xprts);
 
 	/* link from xprt */
 	xprt->xp_ev = sr_rec;
 
-	/* register on event channel */
-	(void)svc_rqst_hook_events(xprt, sr_rec);
+	/* register on event channel: here, by its own thread or before any
+	 * runs it, else posted to its thread (see svc_rqst_cmd_apply())
+	 */
+	if (svc_rqst_self == sr_rec
+	 || !(sr_rec->states & SVC_RQST_STATE_ACTIVE)) {
+		code = svc_rqst_hook_events(xprt, sr_rec);
+		if (code) {
+			svc_rqst_unreg(xprt, sr_rec);
+			mutex_unlock(&sr_rec->mtx);
+			return (code);
+		}
+	} else
+		svc_rqst_post(sr_rec, SVC_RQST_CMD_REG, xprt, 0);
 
 	__warnx(TIRPC_DEBUG_FLAG_REFCNT | TIRPC_DEBUG_FLAG_SVC_RQST,
 		"%s: %p xp_refs %" PRIu32
@@ -637,6 +1684,129 @@ svc_rqst_evchan_reg(uint32_t chan_id, SVCXPRT *xprt, uint32_t flags)
 	return (0);
 }
 
+/*
+ * Refresh the rates, when at least a second has passed.
+ * svc_rqst_set.mtx LOCKED.
+ */
+static void
+svc_rqst_rate(struct svc_rqst_rec *sr_rec)
+{
+	struct timespec now;
+	uint64_t events = atomic_fetch_uint64_t(&sr_rec->events);
+	uint64_t bytes = atomic_fetch_uint64_t(&sr_rec->bytes);
+	uint64_t ms;
+
+	(void)clock_gettime(CLOCK_MONOTONIC_FAST, &now);
+	ms = (now.tv_sec - sr_rec->rate.ts.tv_sec) * 1000
+	   + (now.tv_nsec - sr_rec->rate.ts.tv_nsec) / 1000000;
+	if (ms < 1000)
+		return;
+
+	sr_rec->rate.events_sec = (events - sr_rec->rate.events) * 1000 / ms;
+	sr_rec->rate.bytes_sec = (bytes - sr_rec->rate.bytes) * 1000 / ms;
+	sr_rec->rate.events = events;
+	sr_rec->rate.bytes = bytes;
+	sr_rec->rate.ts = now;
+}
+
+/*
+ * SVC_RQST_FLAG_BALANCE: the least loaded channel, by events and bytes
+ * per second, then by registered xprts.  Returns chan_id if none.
+ */
+static uint32_t
+svc_rqst_balance(uint32_t chan_id)
+{
+	struct svc_rqst_rec *sr_rec;
+	uint64_t best_load = UINT64_MAX;
+	uint32_t best_xprts = UINT32_MAX;
+
+	mutex_lock(&svc_rqst_set.mtx);
+	TAILQ_FOREACH(sr_rec, &svc_rqst_set.balance_q, balance_q) {
+		uint64_t load;
+		uint32_t n_xprts;
+
+		if (sr_rec->states & SVC_RQST_STATE_DESTROYED)
+			continue;
+
+		svc_rqst_rate(sr_rec);
+		load = sr_rec->rate.events_sec
+		     + sr_rec->rate.bytes_sec / SVC_RQST_BALANCE_BYTES;
+		n_xprts = atomic_fetch_uint32_t(&sr_rec->n_xprts);
+
+		if (load < best_load
+		 || (load == best_load && n_xprts < best_xprts)) {
+			best_load = load;
+			best_xprts = n_xprts;
+			chan_id = sr_rec->id_k;
+		}
+	}
+	mutex_unlock(&svc_rqst_set.mtx);
+
+	return (chan_id);
+}
+
+/*
+ * Move a (hot) xprt to chan_id.  The xprt may be in the middle of
+ * handling an event, so the unhook/hook waits for its next
+ * svc_rqst_rearm_events().
+ */
+int
+svc_rqst_evchan_migrate(SVCXPRT *xprt, uint32_t chan_id)
+{
+	struct svc_rqst_rec *sr_rec;
+	struct rbtree_x_part *t;
+
+	if (svc_rqst_init_failure())
+		return (EINVAL);
+
+	sr_rec = svc_rqst_lookup_chan(chan_id, &t, SVC_RQST_FLAG_PART_UNLOCK);
+	if (!sr_rec) {
+		__warnx(TIRPC_DEBUG_FLAG_ERROR,
+			"%s: %p unknown chan_id %d",
+			__func__, xprt, chan_id);
+		return (ENOENT);
+	}
+	svc_rqst_release(sr_rec);
+
+	atomic_store_uint32_t(&xprt->xp_ev_next, chan_id);
+	return (0);
+}
+
+int
+svc_rqst_evchan_stats(uint32_t chan_id, struct svc_rqst_stats *stats)
+{
+	struct svc_rqst_rec *sr_rec;
+	struct rbtree_x_part *t;
+
+	if (svc_rqst_init_failure())
+		return (EINVAL);
+
+	sr_rec = svc_rqst_lookup_chan(chan_id, &t, SVC_RQST_FLAG_PART_UNLOCK);
+	if (!sr_rec) {
+		__warnx(TIRPC_DEBUG_FLAG_ERROR,
+			"%s: unknown chan_id %d",
+			__func__, chan_id);
+		return (ENOENT);
+	}
+
+	stats->n_xprts = atomic_fetch_uint32_t(&sr_rec->n_xprts);
+	stats->events = atomic_fetch_uint64_t(&sr_rec->events);
+	stats->bytes = atomic_fetch_uint64_t(&sr_rec->bytes);
+	stats->polls_busy = atomic_fetch_uint64_t(&sr_rec->polls_busy);
+	stats->polls_empty = atomic_fetch_uint64_t(&sr_rec->polls_empty);
+	stats->requeues = atomic_fetch_uint64_t(&sr_rec->requeues);
+	stats->batch = atomic_fetch_uint32_t(&sr_rec->ev_batch);
+
+	mutex_lock(&svc_rqst_set.mtx);
+	svc_rqst_rate(sr_rec);
+	stats->events_sec = sr_rec->rate.events_sec;
+	stats->bytes_sec = sr_rec->rate.bytes_sec;
+	mutex_unlock(&svc_rqst_set.mtx);
+
+	svc_rqst_release(sr_rec);
+	return (0);
+}
+
 /* register newxprt on an event channel, based on various
  * parameters */
 int
@@ -661,6 +1831,11 @@ svc_rqst_xprt_register(SVCXPRT *xprt, SVCXPRT *newxprt)
 					   newxprt,
 					   SVC_RQST_FLAG_CHAN_AFFINITY);
 
+	/* spread over the channels sharing the policy */
+	if (sr_rec->flags & SVC_RQST_FLAG_BALANCE)
+		return svc_rqst_evchan_reg(svc_rqst_balance(sr_rec->id_k),
+					   newxprt, SVC_RQST_FLAG_NONE);
+
 	/* follow policy if applied.  the client code will still normally
 	 * be called back to, e.g., adjust channel assignment */
 	if (!(sr_rec->flags & SVC_RQST_FLAG_CHAN_AFFINITY))
@@ -683,6 +1858,10 @@ svc_rqst_xprt_unregister(SVCXPRT *xprt)
 		mutex_unlock(&xp_ev->mtx);
 	}
 
+#if defined(TIRPC_EPOLL) && defined(USE_IO_URING)
+	svc_rqst_recv_detach(xprt);
+#endif
+
 	/* remove xprt from xprt table */
 	svc_xprt_clear(xprt, RPC_DPLX_FLAG_UNLOCK);
 }
@@ -691,21 +1870,116 @@ bool_t __svc_clean_idle2(int timeout, bool_t cleanblock);
 
 #ifdef TIRPC_EPOLL
 
-static inline void
+/*
+ * Bytes readable on the xprt, when needed for SVC_RQST_FLAG_BALANCE load
+ * or for inline_max; otherwise (or unknown) -1.
+ */
+static inline int
+svc_rqst_readable(struct svc_rqst_rec *sr_rec, SVCXPRT *xprt)
+{
+	int avail;
+
+	if (!(sr_rec->flags & SVC_RQST_FLAG_BALANCE)
+	 && !((sr_rec->flags & SVC_RQST_FLAG_WORKER)
+	      && __svc_params->inline_max && __svc_params->nonblock))
+		return (-1);
+	if (ioctl(xprt->xp_fd, FIONREAD, &avail) < 0)
+		return (-1);
+#if defined(USE_IO_URING)
+	/* and received already (a hint, racy) */
+	if (xprt->xp_ev_recv)
+		avail += atomic_fetch_uint32_t(&((struct svc_rqst_recv *)
+						 xprt->xp_ev_recv)->bytes);
+#endif
+	return (avail);
+}
+
+/*
+ * SVC_RQST_FLAG_WORKER: a request small enough to decode and dispatch on
+ * the event thread costs less than the handoff.  Only by the default
+ * getreq, of a nonblocking (SVC_XPRT_FLAG_EDGE) connection whose next
+ * record is whole, so it never waits for input; and only calls the
+ * svc_init_params nonblock accepts are dispatched there.  Anything else
+ * goes to svc_work_pool.
+ */
+static inline bool
+svc_rqst_inline(SVCXPRT *xprt, int avail)
+{
+	return (__svc_params->inline_max && __svc_params->nonblock
+		&& (atomic_fetch_uint16_t(&xprt->xp_flags)
+		    & SVC_XPRT_FLAG_EDGE)
+		&& xprt->xp_ops->xp_getreq == svc_getreq_default
+		&& svc_vc_inline_ready(xprt, avail));
+}
+
+/* SVC_XPRT_FLAG_EDGE xprts stay armed between events (EPOLLET, or a
+ * multishot poll)
+ */
+static inline bool
+svc_rqst_edge_armed(struct svc_rqst_rec *sr_rec)
+{
+	switch (sr_rec->ev_type) {
+	case SVC_EVENT_EPOLL:
+		return (true);
+#if defined(USE_IO_URING)
+	case SVC_EVENT_URING:
+		return (sr_rec->ev_u.uring.ring.multishot);
+#endif
+	default:
+		return (false);
+	}
+}
+
+/*
+ * Returns the number of tasks added to the batch (0 or 1).
+ */
+static inline int
 svc_rqst_handle_event(struct svc_rqst_rec *sr_rec, struct epoll_event *ev,
-		      uint32_t wakeups)
+		      uint32_t wakeups, struct work_pool_entry **batch)
 {
 	SVCXPRT *xprt = (SVCXPRT *) ev->data.ptr;
 	int code __attribute__ ((unused));
-
-	if (ev->data.fd != sr_rec->sv[1]) {
+	int queued = 0;
+	int avail;
+
+	if (ev->data.fd != sr_rec->ev_fd
+	 && (ev->data.u64 & SVC_RQST_EV_SEND)) {
+		/* room to write (or completions to reap); the waiting
+		 * writer holds a ref
+		 */
+		xprt = (SVCXPRT *)(uintptr_t)(ev->data.u64 & ~SVC_RQST_EV_SEND);
+		if ((ev->events & EPOLLERR)
+		 && (xprt->xp_flags & SVC_XPRT_FLAG_ZEROCOPY))
+			(void)svc_ioq_zerocopy_reap(xprt);
+		if (atomic_postclear_uint16_t_bits(&xprt->xp_flags,
+						   SVC_XPRT_FLAG_SEND_WAIT)
+		    & SVC_XPRT_FLAG_SEND_WAIT)
+			svc_ioq_resume(xprt);
+	} else if (ev->data.fd != sr_rec->ev_fd) {
 		uint16_t xp_flags = atomic_fetch_uint16_t(&xprt->xp_flags);
 
+		if ((ev->events & EPOLLERR)
+		 && (xp_flags & SVC_XPRT_FLAG_ZEROCOPY)
+		 && !(xp_flags & SVC_XPRT_FLAG_DESTROYED)
+		 && svc_ioq_zerocopy_reap(xprt)
+		 && !(ev->events & ~EPOLLERR)
+		 && (xp_flags & SVC_XPRT_FLAG_EDGE)
+		 && svc_rqst_edge_armed(sr_rec)) {
+			/* only send completions; still armed (EPOLLET) */
+			return (0);
+		}
 		if (!(xp_flags & SVC_XPRT_FLAG_DESTROYED)
 		 && (xp_flags & SVC_XPRT_FLAG_ADDED)
-		 && (xprt->xp_refs > 0)) {
+		 && (xprt->xp_refs > 0)
+		 && (!(xp_flags & SVC_XPRT_FLAG_EDGE)
+		     || !(atomic_postset_uint32_t_bits(&xprt->xp_ev_busy,
+						      SVC_XPRT_EV_ACTIVE
+						      | SVC_XPRT_EV_PENDING)
+			  & SVC_XPRT_EV_ACTIVE))) {
 			/* check for valid xprt. No need for lock;
 			 * (idempotent) xp_flags and xp_refs are set atomic.
+			 * Edge triggered, but already receiving: leave it
+			 * pending for that thread.
 			 */
 			__warnx(TIRPC_DEBUG_FLAG_REFCNT |
 				TIRPC_DEBUG_FLAG_SVC_RQST,
@@ -717,13 +1991,32 @@ svc_rqst_handle_event(struct svc_rqst_rec *sr_rec, struct epoll_event *ev,
 			/* take extra ref, callout will release */
 			SVC_REF(xprt, SVC_REF_FLAG_NONE);
 
-			/* ! LOCKED */
-			code = xprt->xp_ops->xp_getreq(xprt);
-			__warnx(TIRPC_DEBUG_FLAG_REFCNT,
-				"%s: %p xp_refs %" PRIu32
-				" post xp_getreq",
-				__func__, xprt,
-				xprt->xp_refs);
+			avail = svc_rqst_readable(sr_rec, xprt);
+			atomic_inc_uint64_t(&sr_rec->events);
+			if (avail > 0)
+				atomic_add_uint64_t(&sr_rec->bytes, avail);
+
+			if ((sr_rec->flags & SVC_RQST_FLAG_WORKER)
+			 && !svc_rqst_inline(xprt, avail)) {
+				/* EPOLLONESHOT (or SVC_XPRT_EV_ACTIVE), so
+				 * not already queued
+				 */
+				xprt->xp_wpe.fun = svc_rqst_getreq_task;
+				xprt->xp_wpe.arg = xprt;
+				*batch = &xprt->xp_wpe;
+				queued = 1;
+			} else if (sr_rec->flags & SVC_RQST_FLAG_WORKER) {
+				/* ! LOCKED */
+				(void)svc_getreq_inline(xprt);
+			} else {
+				/* ! LOCKED */
+				code = xprt->xp_ops->xp_getreq(xprt);
+				__warnx(TIRPC_DEBUG_FLAG_REFCNT,
+					"%s: %p xp_refs %" PRIu32
+					" post xp_getreq",
+					__func__, xprt,
+					xprt->xp_refs);
+			}
 		}
 		/* XXX failsafe idle processing */
 		if ((wakeups % 1000) == 0)
@@ -733,34 +2026,187 @@ svc_rqst_handle_event(struct svc_rqst_rec *sr_rec, struct epoll_event *ev,
 		 * top-of-loop) */
 		__warnx(TIRPC_DEBUG_FLAG_SVC_RQST,
 			"%s: wakeup fd %d (sr_rec %p)",
-			__func__, sr_rec->sv[1],
+			__func__, sr_rec->ev_fd,
 			sr_rec);
-		(void)consume_ev_sig_nb(sr_rec->sv[1]);
+		mutex_lock(&sr_rec->mtx);
+		svc_rqst_cmd_apply(sr_rec);
+		/* leave a shutdown pending, level triggered, so that it
+		 * wakes every thread running the channel
+		 */
+		if (!(sr_rec->signals & SVC_RQST_SIGNAL_SHUTDOWN))
+			consume_ev_sig_nb(sr_rec);
+		mutex_unlock(&sr_rec->mtx);
 		__warnx(TIRPC_DEBUG_FLAG_SVC_RQST,
 			"%s: after consume sig fd %d (sr_rec %p)",
-			__func__, sr_rec->sv[1],
+			__func__, sr_rec->ev_fd,
 			sr_rec);
 	}
+	return (queued);
+}
+
+/*
+ * Events per wait, adapted to the readiness seen: doubled (up to
+ * max_events) when a wait fills the vector, so heavy channels take more
+ * per system call; halved after SVC_RQST_BATCH_DECAY waits using under a
+ * quarter of it, so light ones get to their first event sooner.
+ */
+static inline void
+svc_rqst_batch_adapt(struct svc_rqst_rec *sr_rec, int n_events,
+		     u_int max_events)
+{
+	uint32_t batch = atomic_fetch_uint32_t(&sr_rec->ev_batch);
+
+	if (n_events <= 0)
+		return;
+
+	if ((uint32_t)n_events >= batch) {
+		sr_rec->ev_light = 0;
+		if (batch < max_events)
+			atomic_store_uint32_t(&sr_rec->ev_batch,
+					      batch * 2 < max_events
+					      ? batch * 2 : max_events);
+	} else if ((uint32_t)n_events * 4 <= batch
+		   && batch > SVC_RQST_BATCH_MIN) {
+		if (++(sr_rec->ev_light) < SVC_RQST_BATCH_DECAY)
+			return;
+		sr_rec->ev_light = 0;
+		atomic_store_uint32_t(&sr_rec->ev_batch,
+				      batch / 2 > SVC_RQST_BATCH_MIN
+				      ? batch / 2 : SVC_RQST_BATCH_MIN);
+	} else
+		sr_rec->ev_light = 0;
+}
+
+/* the xprts requeued so far, for this thread.  sr_rec LOCKED */
+static inline bool
+svc_rqst_ready_take(struct svc_rqst_rec *sr_rec, struct ready_head *ready)
+{
+	if (TAILQ_EMPTY(&sr_rec->ready_q))
+		return (false);
+	TAILQ_SWAP(ready, &sr_rec->ready_q, poolq_entry, q);
+	return (true);
+}
+
+/* ! LOCKED.  On shutdown, only drop their refs. */
+static inline void
+svc_rqst_ready_run(struct ready_head *ready, bool run)
+{
+	struct work_pool_entry *wpe;
+	struct poolq_entry *have;
+
+	while ((have = TAILQ_FIRST(ready))) {
+		TAILQ_REMOVE(ready, have, q);
+		wpe = opr_containerof(have, struct work_pool_entry, pqe);
+		if (run)
+			svc_rqst_getreq_task(wpe);
+		else
+			SVC_RELEASE((SVCXPRT *) wpe->arg,
+				    SVC_RELEASE_FLAG_NONE);
+	}
+}
+
+/* sr_rec LOCKED, unlocked meanwhile */
+static inline void
+svc_rqst_ready_drop(struct svc_rqst_rec *sr_rec)
+{
+	struct ready_head ready = TAILQ_HEAD_INITIALIZER(ready);
+
+	if (!svc_rqst_ready_take(sr_rec, &ready))
+		return;
+	mutex_unlock(&sr_rec->mtx);
+	svc_rqst_ready_run(&ready, false);
+	mutex_lock(&sr_rec->mtx);
+}
+
+/*
+ * SVC_RQST_FLAG_BUSY_POLL: the wait timeout, 0 while this thread is
+ * within busy_poll_us of its last event.  *spin_until is per thread.
+ */
+static inline int
+svc_rqst_poll_timeout(struct svc_rqst_rec *sr_rec, uint64_t *spin_until,
+		      int timeout_ms)
+{
+	struct timespec ts;
+
+	if (!(sr_rec->flags & SVC_RQST_FLAG_BUSY_POLL) || !*spin_until)
+		return (timeout_ms);
+
+	(void)clock_gettime(CLOCK_MONOTONIC, &ts);
+	if ((uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000 < *spin_until)
+		return (0);
+
+	/* window elapsed, block */
+	*spin_until = 0;
+	return (timeout_ms);
+}
+
+/* an event: (re)open the busy poll window; counts non-blocking polls */
+static inline void
+svc_rqst_poll_result(struct svc_rqst_rec *sr_rec, uint64_t *spin_until,
+		     int wait_ms, int n_events)
+{
+	struct timespec ts;
+
+	if (!(sr_rec->flags & SVC_RQST_FLAG_BUSY_POLL))
+		return;
+
+	if (!wait_ms) {
+		if (n_events > 0)
+			atomic_inc_uint64_t(&sr_rec->polls_busy);
+		else
+			atomic_inc_uint64_t(&sr_rec->polls_empty);
+	}
+	if (n_events > 0 && __svc_params->busy_poll_us) {
+		(void)clock_gettime(CLOCK_MONOTONIC, &ts);
+		*spin_until = (uint64_t)ts.tv_sec * 1000000
+			    + ts.tv_nsec / 1000 + __svc_params->busy_poll_us;
+	}
 }
 
 /*
  * - sr_rec LOCKED
  *  (sr_rec unlocked during loop).
  * - Returns with sr_rec locked.
+ *
+ * Any number of threads may run the same channel.  Each has its own
+ * event vector; xprts are armed EPOLLONESHOT, so an event goes to only
+ * one of them until svc_rqst_rearm_events(), and epoll_wait() itself
+ * wakes a single waiter per event.  SVC_XPRT_FLAG_EDGE xprts may be
+ * seen by several, but only the first takes SVC_XPRT_EV_ACTIVE.
+ *
+ * SVC_RQST_FLAG_BUSY_POLL threads poll without blocking for busy_poll_us
+ * after each event, trading a core for the wakeup latency.
  */
 static inline int
 svc_rqst_thrd_run_epoll(struct svc_rqst_rec *sr_rec, uint32_t
 			__attribute__ ((unused)) flags)
 {
 	struct epoll_event *ev;
+	struct epoll_event *events;
+	struct work_pool_entry **batch = NULL;
+	u_int max_events = sr_rec->ev_u.epoll.max_events;
 	int ix, code = 0;
 	int timeout_ms = 120 * 1000;	/* XXX */
+	struct ready_head ready = TAILQ_HEAD_INITIALIZER(ready);
+	bool have_ready;
+	int wait_ms;
 	int n_events;
-	static uint32_t wakeups;
+	int n_batch;
+	uint64_t spin_until = 0;
+	uint32_t wakeups = 0;	/* this thread's, several may run the channel */
+
+	events = mem_alloc(max_events * sizeof(struct epoll_event));
+	if (sr_rec->flags & SVC_RQST_FLAG_WORKER)
+		batch = mem_alloc(max_events *
+				  sizeof(struct work_pool_entry *));
+	svc_rqst_self = sr_rec;
 
 	for (;;) {
 		++(wakeups);
 
+		/* posted before this thread was waiting */
+		svc_rqst_cmd_apply(sr_rec);
+
 		/* check for signals */
 		if (sr_rec->signals & SVC_RQST_SIGNAL_SHUTDOWN)
 			break;
@@ -768,16 +2214,23 @@ svc_rqst_thrd_run_epoll(struct svc_rqst_rec *sr_rec, uint32_t
 		if (sr_rec->states & SVC_RQST_STATE_DESTROYED)
 			break;
 
+		have_ready = svc_rqst_ready_take(sr_rec, &ready);
 		mutex_unlock(&sr_rec->mtx);
 
 		__warnx(TIRPC_DEBUG_FLAG_SVC_RQST,
 			"%s: before epoll_wait fd %d", __func__,
 			sr_rec->ev_u.epoll.epoll_fd);
 
-		switch (n_events =
-			epoll_wait(sr_rec->ev_u.epoll.epoll_fd,
-				   sr_rec->ev_u.epoll.events,
-				   sr_rec->ev_u.epoll.max_events, timeout_ms)) {
+		wait_ms = svc_rqst_poll_timeout(sr_rec, &spin_until,
+						timeout_ms);
+		if (have_ready)
+			wait_ms = 0;
+		n_events = epoll_wait(sr_rec->ev_u.epoll.epoll_fd, events,
+				      atomic_fetch_uint32_t(&sr_rec->ev_batch),
+				      wait_ms);
+		svc_rqst_poll_result(sr_rec, &spin_until, wait_ms, n_events);
+
+		switch (n_events) {
 		case -1:
 			if (errno == EINTR)
 				break;
@@ -785,22 +2238,254 @@ svc_rqst_thrd_run_epoll(struct svc_rqst_rec *sr_rec, uint32_t
 				"%s: epoll_wait failed %d", __func__, errno);
 			break;
 		case 0:
+			/* busy polling */
+			if (!wait_ms)
+				break;
 			/* timed out (idle) */
 			__svc_clean_idle2(__svc_params->idle_timeout, true);
+			xdr_ioq_cache_flush_thread();
 			break;
 		default:
 			/* new events */
-			for (ix = 0; ix < n_events; ++ix) {
-				ev = &(sr_rec->ev_u.epoll.events[ix]);
-				svc_rqst_handle_event(sr_rec, ev, wakeups);
+			for (ix = 0, n_batch = 0; ix < n_events; ++ix) {
+				ev = &events[ix];
+				n_batch += svc_rqst_handle_event(sr_rec, ev,
+								 wakeups,
+								 batch
+								 ? &batch[n_batch]
+								 : NULL);
 			}
+			/* SVC_RQST_FLAG_WORKER */
+			if (n_batch)
+				work_pool_submit_batch(&svc_work_pool, batch,
+						       n_batch);
 		}
+		svc_rqst_batch_adapt(sr_rec, n_events, max_events);
+
+		/* after the xprts with new events */
+		if (have_ready)
+			svc_rqst_ready_run(&ready, true);
 
 		mutex_lock(&sr_rec->mtx);
 	}
 
+	svc_rqst_ready_drop(sr_rec);
+	svc_rqst_self = NULL;
+	if (batch)
+		mem_free(batch, max_events * sizeof(struct work_pool_entry *));
+	mem_free(events, max_events * sizeof(struct epoll_event));
 	return (code);
 }
+
+#if defined(USE_IO_URING)
+/*
+ * An input poll completion without IORING_CQE_F_MORE is no longer armed.
+ * Oneshot polls are re-armed by svc_rqst_rearm_events() once handled.  A
+ * multishot poll (SVC_XPRT_FLAG_EDGE) only ends early, when completions
+ * overflow, so is re-armed here; unless the xprt already left.
+ */
+static inline void
+svc_rqst_uring_multi_ended(struct svc_rqst_rec *sr_rec, SVCXPRT *xprt)
+{
+	struct svc_uring *ring = &sr_rec->ev_u.uring.ring;
+	uint16_t xp_flags;
+
+	if (!ring->multishot)
+		return;
+
+	mutex_lock(&sr_rec->mtx);
+	xp_flags = atomic_fetch_uint16_t(&xprt->xp_flags);
+	if ((xp_flags & SVC_XPRT_FLAG_EDGE)
+	 && (xp_flags & SVC_XPRT_FLAG_ADDED)
+	 && !(xp_flags & SVC_XPRT_FLAG_DESTROYED)
+	 && xprt->xp_ev == sr_rec) {
+		(void)svc_uring_poll_multi(ring, xprt->xp_fd, POLLIN,
+					   (uintptr_t)xprt);
+		__warnx(TIRPC_DEBUG_FLAG_SVC_RQST,
+			"%s: %p uring multishot ended fd %d sr_rec %p",
+			__func__, xprt, xprt->xp_fd, sr_rec);
+	}
+	mutex_unlock(&sr_rec->mtx);
+}
+
+/* recv completions become input events, see svc_rqst_uring_recvd() */
+static inline void
+svc_rqst_uring_reaped(struct svc_rqst_rec *sr_rec, struct io_uring_cqe *cqes,
+		      int n_events)
+{
+	bool refill = false;
+	int ix;
+
+	for (ix = 0; ix < n_events; ++ix) {
+		if (cqes[ix].user_data == SVC_URING_DATA_CTRL
+		 || cqes[ix].user_data == SVC_URING_DATA_NONE
+		 || !(cqes[ix].user_data & SVC_RQST_EV_RECV))
+			continue;
+		refill |= !!(cqes[ix].flags & IORING_CQE_F_BUFFER);
+		svc_rqst_uring_recvd(sr_rec, &cqes[ix]);
+	}
+	if (refill)
+		svc_uring_bufs_commit(&sr_rec->ev_u.uring.ring);
+}
+
+/*
+ * Same contract as svc_rqst_thrd_run_epoll().
+ *
+ * Completions are reaped under sr_rec->mtx, then handled as epoll events.
+ * Re-arms queued meanwhile go to the kernel in one io_uring_enter(),
+ * either the wait when idle, or a flush after each busy round.
+ */
+static inline int
+svc_rqst_thrd_run_uring(struct svc_rqst_rec *sr_rec, uint32_t
+			__attribute__ ((unused)) flags)
+{
+	struct svc_uring *ring = &sr_rec->ev_u.uring.ring;
+	struct io_uring_cqe *cqes;
+	struct work_pool_entry **batch = NULL;
+	struct epoll_event ev;
+	u_int max_events = sr_rec->ev_u.uring.max_events;
+	int ix, code = 0;
+	int timeout_ms = 120 * 1000;	/* XXX */
+	struct ready_head ready = TAILQ_HEAD_INITIALIZER(ready);
+	bool have_ready;
+	int wait_ms;
+	int n_events;
+	int n_batch;
+	uint64_t spin_until = 0;
+	uint32_t wakeups = 0;	/* this thread's, several may run the channel */
+
+	cqes = mem_alloc(max_events * sizeof(struct io_uring_cqe));
+	if (sr_rec->flags & SVC_RQST_FLAG_WORKER)
+		batch = mem_alloc(max_events *
+				  sizeof(struct work_pool_entry *));
+	svc_rqst_self = sr_rec;
+
+	for (;;) {
+		++(wakeups);
+
+		/* posted before this thread was waiting */
+		svc_rqst_cmd_apply(sr_rec);
+
+		/* check for signals */
+		if (sr_rec->signals & SVC_RQST_SIGNAL_SHUTDOWN)
+			break;
+
+		if (sr_rec->states & SVC_RQST_STATE_DESTROYED)
+			break;
+
+		n_events = svc_uring_reap(ring, cqes,
+					  atomic_fetch_uint32_t(&sr_rec->ev_batch));
+		svc_rqst_uring_reaped(sr_rec, cqes, n_events);
+		have_ready = svc_rqst_ready_take(sr_rec, &ready);
+		mutex_unlock(&sr_rec->mtx);
+
+		wait_ms = svc_rqst_poll_timeout(sr_rec, &spin_until,
+						timeout_ms);
+		if (have_ready)
+			wait_ms = 0;
+		svc_rqst_poll_result(sr_rec, &spin_until, wait_ms, n_events);
+		svc_rqst_batch_adapt(sr_rec, n_events, max_events);
+
+		if (!n_events && !wait_ms) {
+			/* busy polling, or requeued: submit, look again */
+			(void)svc_uring_enter(ring, false, 0);
+			if (have_ready)
+				svc_rqst_ready_run(&ready, true);
+			mutex_lock(&sr_rec->mtx);
+			continue;
+		}
+		if (!n_events) {
+			switch (svc_uring_enter(ring, true, wait_ms)) {
+			case 0:
+			case EINTR:
+				break;
+			case ETIME:
+				/* timed out (idle) */
+				__svc_clean_idle2(__svc_params->idle_timeout,
+						  true);
+				xdr_ioq_cache_flush_thread();
+				break;
+			default:
+				__warnx(TIRPC_DEBUG_FLAG_SVC_RQST,
+					"%s: io_uring_enter failed %d",
+					__func__, errno);
+				break;
+			}
+			mutex_lock(&sr_rec->mtx);
+			continue;
+		}
+
+		for (ix = 0, n_batch = 0; ix < n_events; ++ix) {
+			memset(&ev, 0, sizeof(ev));
+
+			if (cqes[ix].user_data == SVC_URING_DATA_NONE)
+				continue;
+			if (!(cqes[ix].flags & IORING_CQE_F_MORE)
+			 && cqes[ix].res >= 0
+			 && cqes[ix].user_data != SVC_URING_DATA_CTRL
+			 && !(cqes[ix].user_data & SVC_RQST_EV_SEND))
+				svc_rqst_uring_multi_ended(sr_rec,
+							   (SVCXPRT *)(uintptr_t)
+							   cqes[ix].user_data);
+			if (cqes[ix].res < 0) {
+				/* cancelled by svc_rqst_unhook_events() */
+				if (cqes[ix].res != -ECANCELED)
+					__warnx(TIRPC_DEBUG_FLAG_ERROR,
+						"%s: poll %p failed (%d)",
+						__func__,
+						(void *)(uintptr_t)
+						cqes[ix].user_data,
+						-cqes[ix].res);
+				/* a waiting writer finds the error itself */
+				if (cqes[ix].res == -ECANCELED
+				 || cqes[ix].user_data == SVC_URING_DATA_CTRL
+				 || !(cqes[ix].user_data & SVC_RQST_EV_SEND))
+					continue;
+				cqes[ix].res = POLLERR;
+			}
+
+			ev.events = cqes[ix].res;
+			if (cqes[ix].user_data == SVC_URING_DATA_CTRL)
+				ev.data.fd = sr_rec->ev_fd;
+			else
+				ev.data.ptr = (void *)(uintptr_t)
+					cqes[ix].user_data;
+
+			n_batch += svc_rqst_handle_event(sr_rec, &ev, wakeups,
+							 batch
+							 ? &batch[n_batch]
+							 : NULL);
+
+			if (cqes[ix].user_data == SVC_URING_DATA_CTRL) {
+				mutex_lock(&sr_rec->mtx);
+				(void)svc_uring_poll_add(ring, sr_rec->ev_fd,
+							 POLLIN,
+							 SVC_URING_DATA_CTRL);
+				mutex_unlock(&sr_rec->mtx);
+			}
+		}
+		/* SVC_RQST_FLAG_WORKER */
+		if (n_batch)
+			work_pool_submit_batch(&svc_work_pool, batch, n_batch);
+
+		/* after the xprts with new events */
+		if (have_ready)
+			svc_rqst_ready_run(&ready, true);
+
+		/* re-arms queued by inline getreq */
+		(void)svc_uring_enter(ring, false, 0);
+
+		mutex_lock(&sr_rec->mtx);
+	}
+
+	svc_rqst_ready_drop(sr_rec);
+	svc_rqst_self = NULL;
+	if (batch)
+		mem_free(batch, max_events * sizeof(struct work_pool_entry *));
+	mem_free(cqes, max_events * sizeof(struct io_uring_cqe));
+	return (code);
+}
+#endif				/* USE_IO_URING */
 #endif
 
 int
@@ -829,6 +2514,11 @@ svc_rqst_thrd_run(uint32_t chan_id, __attribute__ ((unused)) uint32_t flags)
 	case SVC_EVENT_EPOLL:
 		code = svc_rqst_thrd_run_epoll(sr_rec, flags);
 		break;
+#endif
+#if defined(TIRPC_EPOLL) && defined(USE_IO_URING)
+	case SVC_EVENT_URING:
+		code = svc_rqst_thrd_run_uring(sr_rec, flags);
+		break;
 #endif
 	default:
 		/* XXX formerly select/fd_set case, now placeholder for new
@@ -857,8 +2547,8 @@ svc_rqst_thrd_signal(uint32_t chan_id, uint32_t flags)
 		return (ENOENT);
 	}
 
-	sr_rec->signals |= (flags & SVC_RQST_SIGNAL_MASK);
-	ev_sig(sr_rec->sv[0], flags);	/* send wakeup */
+	svc_rqst_post(sr_rec, SVC_RQST_CMD_SIGNAL, NULL,
+		      flags & SVC_RQST_SIGNAL_MASK);
 
 	svc_rqst_release(sr_rec);
 	return (0);
@@ -889,13 +2579,13 @@ svc_rqst_delete_evchan(uint32_t chan_id)
 		svc_rqst_unreg(xprt, sr_rec);
 
 		/* wake up */
-		ev_sig(sr_rec->sv[0], 0);
+		ev_sig(sr_rec);
 		switch (sr_rec->ev_type) {
 #if defined(TIRPC_EPOLL)
 		case SVC_EVENT_EPOLL:
 			code =
 			    epoll_ctl(sr_rec->ev_u.epoll.epoll_fd,
-				      EPOLL_CTL_DEL, sr_rec->sv[1],
+				      EPOLL_CTL_DEL, sr_rec->ev_fd,
 				      &sr_rec->ev_u.epoll.ctrl_ev);
 			if (code == -1)
 				__warnx(TIRPC_DEBUG_FLAG_SVC_RQST,
@@ -910,6 +2600,12 @@ svc_rqst_delete_evchan(uint32_t chan_id)
 		xprt = next;
 	}
 
+	if (sr_rec->flags & SVC_RQST_FLAG_BALANCE) {
+		mutex_lock(&svc_rqst_set.mtx);
+		TAILQ_REMOVE(&svc_rqst_set.balance_q, sr_rec, balance_q);
+		mutex_unlock(&svc_rqst_set.mtx);
+	}
+
 	/* now remove sr_rec */
 	rbtree_x_cached_remove(&svc_rqst_set.xt, t, &sr_rec->node_k,
 			       sr_rec->id_k);
@@ -919,9 +2615,12 @@ svc_rqst_delete_evchan(uint32_t chan_id)
 #if defined(TIRPC_EPOLL)
 	case SVC_EVENT_EPOLL:
 		close(sr_rec->ev_u.epoll.epoll_fd);
-		mem_free(sr_rec->ev_u.epoll.events,
-			 sr_rec->ev_u.epoll.max_events *
-			 sizeof(struct epoll_event));
+		break;
+#endif
+#if defined(TIRPC_EPOLL) && defined(USE_IO_URING)
+	case SVC_EVENT_URING:
+		svc_uring_destroy(&sr_rec->ev_u.uring.ring);
+		svc_rqst_uring_bufs_free(sr_rec);
 		break;
 #endif
 	default:
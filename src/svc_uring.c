@@ -0,0 +1,520 @@
+/*
+ * Copyright (c) 2026 The libntirpc contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR `AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file svc_uring.c
+ * @brief io_uring rings for SVC_EVENT_URING event channels
+ *
+ * @section DESCRIPTION
+ *
+ * Just enough of io_uring for readiness polling, without liburing.
+ * Each registered xprt has one oneshot IORING_OP_POLL_ADD outstanding,
+ * the equivalent of EPOLLIN | EPOLLONESHOT, and another for POLLOUT while
+ * its output waits for room.  Re-arming only queues a
+ * new entry; the event thread submits it with its next wait, in the same
+ * io_uring_enter() call, so there is no separate epoll_ctl().
+ *
+ * Edge triggered xprts instead have one multishot poll (5.13), the
+ * equivalent of EPOLLIN | EPOLLET: a completion for each wakeup, and
+ * nothing to re-arm.
+ *
+ * Or, for SVC_INIT_VC_IOQ_RECV, a multishot recv (6.0) that completes
+ * with the data itself, in a buffer the kernel took from the ring's
+ * provided buffer ring: no read() at all.
+ */
+
+#include <config.h>
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <errno.h>
+#include <endian.h>
+#include <poll.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <rpc/types.h>
+#include <misc/portable.h>
+
+#include "svc_uring.h"
+
+static inline int
+svc_uring_sys_setup(uint32_t entries, struct io_uring_params *p)
+{
+	return (syscall(__NR_io_uring_setup, entries, p));
+}
+
+static inline int
+svc_uring_sys_enter(int fd, uint32_t to_submit, uint32_t min_complete,
+		    uint32_t flags, void *arg, size_t argsz)
+{
+	return (syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+			flags, arg, argsz));
+}
+
+static inline int
+svc_uring_sys_register(int fd, uint32_t opcode, void *arg, uint32_t nr_args)
+{
+	return (syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+static bool svc_uring_probe_multishot(struct svc_uring *ring);
+
+/**
+ * @brief Create and map a ring
+ *
+ * @param[in] ring	the ring
+ * @param[in] entries	submission entries (rounded up to a power of 2)
+ *
+ * @return 0 or errno (ENOSYS or EPERM when io_uring is not available).
+ */
+int
+svc_uring_setup(struct svc_uring *ring, uint32_t entries)
+{
+	struct io_uring_params p;
+	int code;
+
+	memset(ring, 0, sizeof(*ring));
+	memset(&p, 0, sizeof(p));
+
+	ring->fd = svc_uring_sys_setup(entries, &p);
+	if (ring->fd < 0) {
+		code = errno;
+		__warnx(TIRPC_DEBUG_FLAG_ERROR,
+			"%s() io_uring_setup failed (%d)",
+			__func__, code);
+		return (code);
+	}
+	if (!(p.features & IORING_FEAT_NODROP)
+	 || !(p.features & IORING_FEAT_EXT_ARG)) {
+		/* before 5.11, no wait timeout, and completions may drop */
+		__warnx(TIRPC_DEBUG_FLAG_ERROR,
+			"%s() io_uring features %x insufficient",
+			__func__, p.features);
+		close(ring->fd);
+		return (ENOSYS);
+	}
+
+	ring->sq_entries = p.sq_entries;
+	ring->sq_ring_sz = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+	ring->cq_ring_sz = p.cq_off.cqes
+			 + p.cq_entries * sizeof(struct io_uring_cqe);
+	ring->sqes_sz = p.sq_entries * sizeof(struct io_uring_sqe);
+
+	ring->sq_ring = mmap(NULL, ring->sq_ring_sz, PROT_READ | PROT_WRITE,
+			     MAP_SHARED | MAP_POPULATE, ring->fd,
+			     IORING_OFF_SQ_RING);
+	if (ring->sq_ring == MAP_FAILED)
+		goto err;
+	ring->cq_ring = mmap(NULL, ring->cq_ring_sz, PROT_READ | PROT_WRITE,
+			     MAP_SHARED | MAP_POPULATE, ring->fd,
+			     IORING_OFF_CQ_RING);
+	if (ring->cq_ring == MAP_FAILED)
+		goto err;
+	ring->sqes = mmap(NULL, ring->sqes_sz, PROT_READ | PROT_WRITE,
+			  MAP_SHARED | MAP_POPULATE, ring->fd,
+			  IORING_OFF_SQES);
+	if (ring->sqes == MAP_FAILED)
+		goto err;
+
+	ring->sq_head = (void *)((char *)ring->sq_ring + p.sq_off.head);
+	ring->sq_tail = (void *)((char *)ring->sq_ring + p.sq_off.tail);
+	ring->sq_mask = (void *)((char *)ring->sq_ring + p.sq_off.ring_mask);
+	ring->sq_array = (void *)((char *)ring->sq_ring + p.sq_off.array);
+	ring->cq_head = (void *)((char *)ring->cq_ring + p.cq_off.head);
+	ring->cq_tail = (void *)((char *)ring->cq_ring + p.cq_off.tail);
+	ring->cq_mask = (void *)((char *)ring->cq_ring + p.cq_off.ring_mask);
+	ring->cqes = (void *)((char *)ring->cq_ring + p.cq_off.cqes);
+
+	ring->multishot = svc_uring_probe_multishot(ring);
+	return (0);
+
+ err:
+	code = errno;
+	__warnx(TIRPC_DEBUG_FLAG_ERROR,
+		"%s() mmap failed (%d)",
+		__func__, code);
+	svc_uring_destroy(ring);
+	return (code);
+}
+
+void
+svc_uring_destroy(struct svc_uring *ring)
+{
+	if (ring->bufs)
+		munmap(ring->bufs, ring->bufs_sz);
+	if (ring->sqes && ring->sqes != MAP_FAILED)
+		munmap(ring->sqes, ring->sqes_sz);
+	if (ring->cq_ring && ring->cq_ring != MAP_FAILED)
+		munmap(ring->cq_ring, ring->cq_ring_sz);
+	if (ring->sq_ring && ring->sq_ring != MAP_FAILED)
+		munmap(ring->sq_ring, ring->sq_ring_sz);
+	close(ring->fd);
+	memset(ring, 0, sizeof(*ring));
+	ring->fd = -1;
+}
+
+/* the next free submission entry, or NULL when full even after submit */
+static struct io_uring_sqe *
+svc_uring_sqe(struct svc_uring *ring)
+{
+	uint32_t tail = *ring->sq_tail;
+	struct io_uring_sqe *sqe;
+
+	if (tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE)
+	    >= ring->sq_entries) {
+		(void)svc_uring_enter(ring, false, 0);
+		if (tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE)
+		    >= ring->sq_entries)
+			return (NULL);
+	}
+
+	sqe = &ring->sqes[tail & *ring->sq_mask];
+	memset(sqe, 0, sizeof(*sqe));
+	ring->sq_array[tail & *ring->sq_mask] = tail & *ring->sq_mask;
+	return (sqe);
+}
+
+static inline void
+svc_uring_queue(struct svc_uring *ring)
+{
+	__atomic_store_n(ring->sq_tail, *ring->sq_tail + 1, __ATOMIC_RELEASE);
+}
+
+static int
+svc_uring_poll(struct svc_uring *ring, int fd, uint32_t events,
+	       uint64_t user_data, uint32_t poll_flags)
+{
+	struct io_uring_sqe *sqe = svc_uring_sqe(ring);
+
+	if (!sqe)
+		return (EBUSY);
+
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = fd;
+	sqe->len = poll_flags;
+#if __BYTE_ORDER == __BIG_ENDIAN
+	/* the kernel swaps the half-words back (swahw32), as liburing */
+	sqe->poll32_events = (events << 16) | (events >> 16);
+#else
+	sqe->poll32_events = events;
+#endif
+	sqe->user_data = user_data;
+	svc_uring_queue(ring);
+	return (0);
+}
+
+int
+svc_uring_poll_add(struct svc_uring *ring, int fd, uint32_t events,
+		   uint64_t user_data)
+{
+	return (svc_uring_poll(ring, fd, events, user_data, 0));
+}
+
+/* oneshot without kernel support (see ring->multishot) */
+int
+svc_uring_poll_multi(struct svc_uring *ring, int fd, uint32_t events,
+		     uint64_t user_data)
+{
+	return (svc_uring_poll(ring, fd, events, user_data,
+			       ring->multishot ? IORING_POLL_ADD_MULTI : 0));
+}
+
+int
+svc_uring_poll_remove(struct svc_uring *ring, uint64_t user_data)
+{
+	struct io_uring_sqe *sqe = svc_uring_sqe(ring);
+
+	if (!sqe)
+		return (EBUSY);
+
+	/* not IORING_OP_POLL_REMOVE: that fails (-EALREADY) while a
+	 * wakeup is being handled, leaving a multishot poll armed
+	 */
+	sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	sqe->fd = -1;
+	sqe->addr = user_data;
+	sqe->user_data = SVC_URING_DATA_NONE;
+	svc_uring_queue(ring);
+	return (0);
+}
+
+#if defined(SVC_URING_RECV)
+static bool svc_uring_probe_recv(struct svc_uring *ring);
+
+/**
+ * @brief Register a provided buffer ring, for multishot recv
+ *
+ * The kernel takes buffers from it in order, and completes each recv
+ * with the id of the one filled.  The ring itself is ours, page aligned;
+ * closing the ring unregisters it.
+ *
+ * @param[in] ring	the ring
+ * @param[in] entries	buffers at most (a power of 2, 32768 at most)
+ *
+ * @return 0 or errno.
+ */
+int
+svc_uring_bufs_setup(struct svc_uring *ring, uint16_t entries)
+{
+	struct io_uring_buf_reg reg;
+	int code;
+
+	ring->bufs_sz = entries * sizeof(struct io_uring_buf);
+	ring->bufs = mmap(NULL, ring->bufs_sz, PROT_READ | PROT_WRITE,
+			  MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+	if (ring->bufs == MAP_FAILED) {
+		ring->bufs = NULL;
+		return (errno);
+	}
+	ring->bufs_mask = entries - 1;
+	ring->bufs_tail = 0;
+
+	memset(&reg, 0, sizeof(reg));
+	reg.ring_addr = (uintptr_t)ring->bufs;
+	reg.ring_entries = entries;
+	reg.bgid = 0;
+	if (svc_uring_sys_register(ring->fd, IORING_REGISTER_PBUF_RING,
+				   &reg, 1) < 0) {
+		code = errno;
+		goto err;
+	}
+
+	ring->recv_multi = svc_uring_probe_recv(ring);
+	if (ring->recv_multi)
+		return (0);
+
+	code = ENOSYS;
+	(void)svc_uring_sys_register(ring->fd, IORING_UNREGISTER_PBUF_RING,
+				     &reg, 1);
+ err:
+	__warnx(TIRPC_DEBUG_FLAG_ERROR,
+		"%s() no multishot recv (%d)",
+		__func__, code);
+	munmap(ring->bufs, ring->bufs_sz);
+	ring->bufs = NULL;
+	return (code);
+}
+
+void
+svc_uring_buf_add(struct svc_uring *ring, void *addr, uint32_t len,
+		  uint16_t bid)
+{
+	struct io_uring_buf *buf =
+		&ring->bufs->bufs[ring->bufs_tail & ring->bufs_mask];
+
+	buf->addr = (uintptr_t)addr;
+	buf->len = len;
+	buf->bid = bid;
+	ring->bufs_tail++;
+}
+
+void
+svc_uring_bufs_commit(struct svc_uring *ring)
+{
+	__atomic_store_n(&ring->bufs->tail, ring->bufs_tail, __ATOMIC_RELEASE);
+}
+
+int
+svc_uring_recv_multi(struct svc_uring *ring, int fd, uint64_t user_data)
+{
+	struct io_uring_sqe *sqe = svc_uring_sqe(ring);
+
+	if (!sqe)
+		return (EBUSY);
+
+	sqe->opcode = IORING_OP_RECV;
+	sqe->fd = fd;
+	sqe->ioprio = IORING_RECV_MULTISHOT;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = 0;
+	sqe->user_data = user_data;
+	svc_uring_queue(ring);
+	return (0);
+}
+#else
+int
+svc_uring_bufs_setup(struct svc_uring *ring, uint16_t entries)
+{
+	return (ENOSYS);
+}
+
+void
+svc_uring_buf_add(struct svc_uring *ring, void *addr, uint32_t len,
+		  uint16_t bid)
+{
+}
+
+void
+svc_uring_bufs_commit(struct svc_uring *ring)
+{
+}
+
+int
+svc_uring_recv_multi(struct svc_uring *ring, int fd, uint64_t user_data)
+{
+	return (ENOSYS);
+}
+#endif				/* SVC_URING_RECV */
+
+/**
+ * @brief Submit queued entries, and maybe wait for a completion
+ *
+ * Entries queued but not yet taken by the kernel are submitted, whoever
+ * queued them; the kernel takes each only once.
+ */
+int
+svc_uring_enter(struct svc_uring *ring, bool wait, int timeout_ms)
+{
+	struct __kernel_timespec ts = {
+		.tv_sec = timeout_ms / 1000,
+		.tv_nsec = (timeout_ms % 1000) * 1000000,
+	};
+	struct io_uring_getevents_arg arg = {
+		.ts = (uint64_t)(uintptr_t)&ts,
+	};
+	uint32_t to_submit = __atomic_load_n(ring->sq_tail, __ATOMIC_ACQUIRE)
+			   - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+	int rc;
+
+	if (!wait) {
+		if (!to_submit)
+			return (0);
+		rc = svc_uring_sys_enter(ring->fd, to_submit, 0, 0, NULL, 0);
+	} else {
+		rc = svc_uring_sys_enter(ring->fd, to_submit, 1,
+					 IORING_ENTER_GETEVENTS
+					 | IORING_ENTER_EXT_ARG,
+					 &arg, sizeof(arg));
+	}
+	return (rc < 0 ? errno : 0);
+}
+
+uint32_t
+svc_uring_reap(struct svc_uring *ring, struct io_uring_cqe *cqes,
+	       uint32_t max)
+{
+	uint32_t head = *ring->cq_head;
+	uint32_t tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+	uint32_t n = 0;
+
+	while (head != tail && n < max) {
+		cqes[n++] = ring->cqes[head & *ring->cq_mask];
+		head++;
+	}
+	__atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+	return (n);
+}
+
+/*
+ * Cancel a still armed probe, and reap the cancel's completion and the
+ * probe's last, so that the next probe's completion is the first.
+ */
+static void
+svc_uring_probe_cancel(struct svc_uring *ring)
+{
+	struct io_uring_cqe cqe;
+	uint32_t n = 0;
+
+	if (svc_uring_poll_remove(ring, SVC_URING_DATA_NONE))
+		return;
+	while (n < 2 && !svc_uring_enter(ring, true, 1000))
+		n += svc_uring_reap(ring, &cqe, 1);
+}
+
+/*
+ * Multishot poll (5.13): a poll of a ready eventfd completes at once, with
+ * IORING_CQE_F_MORE when still armed; older kernels fail it (-EINVAL).
+ * Called once at setup, so its completions are the only ones.
+ */
+static bool
+svc_uring_probe_multishot(struct svc_uring *ring)
+{
+	struct io_uring_cqe cqe;
+	uint64_t one = 1;
+	bool multishot = false;
+	int efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+	if (efd < 0)
+		return (false);
+	if (write(efd, &one, sizeof(one)) != sizeof(one))
+		goto out;
+
+	ring->multishot = true;
+	if (svc_uring_poll_multi(ring, efd, POLLIN, SVC_URING_DATA_NONE)
+	 || svc_uring_enter(ring, true, 1000)
+	 || !svc_uring_reap(ring, &cqe, 1))
+		goto out;
+	multishot = cqe.res >= 0 && (cqe.flags & IORING_CQE_F_MORE);
+
+	if (multishot)
+		svc_uring_probe_cancel(ring);
+ out:
+	close(efd);
+	return (multishot);
+}
+
+#if defined(SVC_URING_RECV)
+/*
+ * Multishot recv (6.0): a recv of a ready socket completes at once, into
+ * a provided buffer, with IORING_CQE_F_MORE when still armed; older
+ * kernels fail it (-EINVAL), or complete it once.  As above, at setup.
+ */
+static bool
+svc_uring_probe_recv(struct svc_uring *ring)
+{
+	static char probe[16];
+	struct io_uring_cqe cqe;
+	bool recv_multi = false;
+	int sv[2];
+
+	if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv))
+		return (false);
+	if (write(sv[1], "", 1) != 1)
+		goto out;
+
+	svc_uring_buf_add(ring, probe, sizeof(probe), 0);
+	svc_uring_bufs_commit(ring);
+	if (svc_uring_recv_multi(ring, sv[0], SVC_URING_DATA_NONE)
+	 || svc_uring_enter(ring, true, 1000)
+	 || !svc_uring_reap(ring, &cqe, 1))
+		goto out;
+	recv_multi = cqe.res == 1
+		  && (cqe.flags & IORING_CQE_F_BUFFER)
+		  && (cqe.flags & IORING_CQE_F_MORE);
+
+	if (recv_multi)
+		svc_uring_probe_cancel(ring);
+ out:
+	close(sv[0]);
+	close(sv[1]);
+	return (recv_multi);
+}
+#endif				/* SVC_URING_RECV */
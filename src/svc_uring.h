@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2026 The libntirpc contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR `AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TIRPC_SVC_URING_H
+#define TIRPC_SVC_URING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <linux/io_uring.h>
+
+/* 5.13, kernel ABI; probed at setup */
+#ifndef IORING_POLL_ADD_MULTI
+#define IORING_POLL_ADD_MULTI	(1U << 0)
+#endif
+#ifndef IORING_CQE_F_MORE
+#define IORING_CQE_F_MORE	(1U << 1)
+#endif
+/* 6.0, provided buffer rings (5.19) and multishot recv */
+#if defined(IORING_RECV_MULTISHOT)
+#define SVC_URING_RECV 1
+#endif
+
+/**
+ ** Minimal io_uring submission and completion rings for SVC_EVENT_URING,
+ ** on the raw system calls.  Callers serialize all calls on one ring,
+ ** except svc_uring_enter().
+ **/
+
+/* user_data not naming an xprt */
+#define SVC_URING_DATA_CTRL	1	/* event channel control socket */
+#define SVC_URING_DATA_NONE	2	/* completion to ignore */
+
+struct svc_uring {
+	int fd;
+	uint32_t sq_entries;
+	bool multishot;		/* IORING_POLL_ADD_MULTI supported */
+	bool recv_multi;	/* multishot recv into the buffer ring */
+
+	/* mapped from the kernel */
+	uint32_t *sq_head;
+	uint32_t *sq_tail;
+	uint32_t *sq_mask;
+	uint32_t *sq_array;
+	struct io_uring_sqe *sqes;
+	uint32_t *cq_head;
+	uint32_t *cq_tail;
+	uint32_t *cq_mask;
+	struct io_uring_cqe *cqes;
+
+	void *sq_ring;
+	size_t sq_ring_sz;
+	void *cq_ring;
+	size_t cq_ring_sz;
+	size_t sqes_sz;
+
+	/* provided buffer ring (group 0), see svc_uring_bufs_setup() */
+	struct io_uring_buf_ring *bufs;
+	size_t bufs_sz;
+	uint16_t bufs_mask;
+	uint16_t bufs_tail;
+};
+
+int svc_uring_setup(struct svc_uring *, uint32_t entries);
+void svc_uring_destroy(struct svc_uring *);
+
+/* queue without submitting; returns 0 or errno */
+int svc_uring_poll_add(struct svc_uring *, int fd, uint32_t events,
+		       uint64_t user_data);
+/* multishot: completions with IORING_CQE_F_MORE while still armed */
+int svc_uring_poll_multi(struct svc_uring *, int fd, uint32_t events,
+			 uint64_t user_data);
+int svc_uring_poll_remove(struct svc_uring *, uint64_t user_data);
+
+/* buffer ring of entries (a power of 2), for svc_uring_recv_multi();
+ * returns 0 or errno (ENOSYS when the kernel has no multishot recv)
+ */
+int svc_uring_bufs_setup(struct svc_uring *, uint16_t entries);
+/* give a buffer to the kernel; after svc_uring_bufs_commit() */
+void svc_uring_buf_add(struct svc_uring *, void *addr, uint32_t len,
+		       uint16_t bid);
+void svc_uring_bufs_commit(struct svc_uring *);
+/* multishot recv, each completion with IORING_CQE_F_BUFFER and the id
+ * (IORING_CQE_BUFFER_SHIFT) of the buffer it filled; -ENOBUFS when
+ * there was none
+ */
+int svc_uring_recv_multi(struct svc_uring *, int fd, uint64_t user_data);
+
+/* submit queued entries, and wait up to timeout_ms for a completion
+ * when wait; returns 0 or errno (ETIME on timeout)
+ */
+int svc_uring_enter(struct svc_uring *, bool wait, int timeout_ms);
+
+/* copy up to max completions */
+uint32_t svc_uring_reap(struct svc_uring *, struct io_uring_cqe *, uint32_t);
+
+#endif				/* TIRPC_SVC_URING_H */
@@ -49,6 +49,7 @@
 #include <sys/uio.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
+#include <linux/filter.h>
 
 #include <assert.h>
 #include <err.h>
@@ -77,6 +78,7 @@
 #include <rpc/xdr_inrec.h>
 #include <rpc/xdr_ioq.h>
 #include <getpeereid.h>
+#include <misc/city.h>
 #include "svc_ioq.h"
 
 int generic_read_vc(XDR *, void *, void *, int);
@@ -86,9 +88,13 @@ static void svc_vc_ops(SVCXPRT *);
 static void svc_vc_override_ops(SVCXPRT *, SVCXPRT *);
 
 bool __svc_clean_idle2(int, bool);
+static void svc_vc_idle_expire(struct timer_wheel_entry *);
+
+struct timer_wheel svc_idle_wheel = TIMER_WHEEL_INITIALIZER(1000);
 
 static SVCXPRT *makefd_xprt(const int, const u_int, const u_int,
 			    struct __rpc_sockinfo *, uint32_t *);
+static void svc_vc_segs_free(struct svc_vc_xprt *);
 
 extern pthread_mutex_t svc_ctr_lock;
 
@@ -107,10 +113,89 @@ extern pthread_mutex_t svc_ctr_lock;
  * original function with flags SVC_CREATE_FLAG_CLOSE.
  *
  */
+/*
+ * Freed svc_vc_xprts are kept for reuse, sparing the allocator during
+ * reconnect storms.  svc_vc_ncreatef() primes it for listeners, and
+ * svc_shutdown() drains it.
+ */
+#define SVC_VC_XPRT_POOL_MIN 64
+#define SVC_VC_XPRT_POOL_MAX 1024
+
+static struct {
+	mutex_t mtx;
+	SLIST_HEAD(sx_pool_head, svc_vc_xprt) head;
+	u_int count;
+} svc_vc_xprt_pool = {
+	.mtx = MUTEX_INITIALIZER,
+	.head = SLIST_HEAD_INITIALIZER(svc_vc_xprt_pool.head),
+};
+
+static void
+svc_vc_xprt_pool_put(struct svc_vc_xprt *xd)
+{
+	mutex_lock(&svc_vc_xprt_pool.mtx);
+	if (svc_vc_xprt_pool.count < SVC_VC_XPRT_POOL_MAX) {
+		SLIST_INSERT_HEAD(&svc_vc_xprt_pool.head, xd, sx_pool);
+		svc_vc_xprt_pool.count++;
+		xd = NULL;
+	}
+	mutex_unlock(&svc_vc_xprt_pool.mtx);
+
+	if (xd)
+		mem_free(xd, sizeof(struct svc_vc_xprt));
+}
+
+static struct svc_vc_xprt *
+svc_vc_xprt_pool_get(void)
+{
+	struct svc_vc_xprt *xd;
+
+	mutex_lock(&svc_vc_xprt_pool.mtx);
+	xd = SLIST_FIRST(&svc_vc_xprt_pool.head);
+	if (xd) {
+		SLIST_REMOVE_HEAD(&svc_vc_xprt_pool.head, sx_pool);
+		svc_vc_xprt_pool.count--;
+	}
+	mutex_unlock(&svc_vc_xprt_pool.mtx);
+
+	if (!xd)
+		return (mem_zalloc(sizeof(struct svc_vc_xprt)));
+	memset(xd, 0, sizeof(struct svc_vc_xprt));
+	return (xd);
+}
+
+static void
+svc_vc_xprt_pool_prime(void)
+{
+	u_int count;
+
+	mutex_lock(&svc_vc_xprt_pool.mtx);
+	count = svc_vc_xprt_pool.count;
+	mutex_unlock(&svc_vc_xprt_pool.mtx);
+
+	for (; count < SVC_VC_XPRT_POOL_MIN; count++)
+		svc_vc_xprt_pool_put(mem_alloc(sizeof(struct svc_vc_xprt)));
+}
+
+void
+svc_vc_xprt_pool_drain(void)
+{
+	struct svc_vc_xprt *xd;
+
+	mutex_lock(&svc_vc_xprt_pool.mtx);
+	while ((xd = SLIST_FIRST(&svc_vc_xprt_pool.head))) {
+		SLIST_REMOVE_HEAD(&svc_vc_xprt_pool.head, sx_pool);
+		mem_free(xd, sizeof(struct svc_vc_xprt));
+	}
+	svc_vc_xprt_pool.count = 0;
+	mutex_unlock(&svc_vc_xprt_pool.mtx);
+}
+
 static void
 svc_vc_xprt_free(struct svc_vc_xprt *xd)
 {
 	rpc_dplx_rec_destroy(&xd->sx_dr);
+	mutex_destroy(&xd->shared.ioq.qmutex);
 	mutex_destroy(&xd->sx_dr.xprt.xp_lock);
 	mutex_destroy(&xd->sx_dr.xprt.xp_auth_lock);
 
@@ -118,21 +203,30 @@ svc_vc_xprt_free(struct svc_vc_xprt *xd)
 	if (xd->sx_dr.xprt.blkin.svc_name)
 		mem_free(xd->sx_dr.xprt.blkin.svc_name, 2*INET6_ADDRSTRLEN);
 #endif
-	mem_free(xd, sizeof(struct svc_vc_xprt));
+	if (xd->shared.ring.base)
+		mem_free(xd->shared.ring.base, xd->shared.ring.size);
+	svc_vc_segs_free(xd);
+	svc_vc_xprt_pool_put(xd);
 }
 
 static struct svc_vc_xprt *
 svc_vc_xprt_zalloc(void)
 {
-	struct svc_vc_xprt *xd = mem_zalloc(sizeof(struct svc_vc_xprt));
+	struct svc_vc_xprt *xd = svc_vc_xprt_pool_get();
 
 	/* Init SVCXPRT locks, etc */
 	mutex_init(&xd->sx_dr.xprt.xp_lock, NULL);
 	mutex_init(&xd->sx_dr.xprt.xp_auth_lock, NULL);
 /*	TAILQ_INIT_ENTRY(&xd->sx_dr.xprt, xp_evq); sets NULL */
 	rpc_dplx_rec_init(&xd->sx_dr);
+	TAILQ_INIT(&xd->shared.ioq.qh);
+	mutex_init(&xd->shared.ioq.qmutex, NULL);
+	TAILQ_INIT(&xd->shared.zc_held);
+	TAILQ_INIT(&xd->shared.segs.qh);
+	TAILQ_INIT(&xd->shared.segs.recs);
 
 	xd->sx.strm_stat = XPRT_IDLE;
+	xd->sx_dr.xprt.xp_fd_send = -1;
 	xd->sx_dr.xprt.xp_refs = 1;
 	return (xd);
 }
@@ -150,6 +244,28 @@ svc_vc_xprt_setup(SVCXPRT **sxpp)
 	}
 }
 
+/*
+ * rendezvous_request() takes connections until EAGAIN from listeners
+ * made nonblocking here (SVC_CREATE_FLAG_LISTEN), or that were already;
+ * one per event from a blocking listener the caller supplied.
+ */
+static bool
+svc_vc_setnonblock(int fd, bool set)
+{
+	int flags = fcntl(fd, F_GETFL, 0);
+
+	if (flags != -1 && !set)
+		return (!!(flags & O_NONBLOCK));
+	if (flags == -1
+	 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+		__warnx(TIRPC_DEBUG_FLAG_ERROR,
+			"%s: fd %d fcntl failed (%d)",
+			__func__, fd, errno);
+		return (false);
+	}
+	return (true);
+}
+
 SVCXPRT *
 svc_vc_ncreatef(const int fd, const u_int sendsz, const u_int recvsz,
 		const uint32_t flags)
@@ -163,6 +279,7 @@ svc_vc_ncreatef(const int fd, const u_int sendsz, const u_int recvsz,
 	u_int sendsize;
 	u_int xp_flags;
 	int rc;
+	int one = 1;
 
 	/* atomically find or create shared fd state; ref+1; locked */
 	xprt = svc_xprt_lookup(fd, svc_vc_xprt_setup);
@@ -234,6 +351,15 @@ svc_vc_ncreatef(const int fd, const u_int sendsz, const u_int recvsz,
 		listen(fd, SOMAXCONN);
 	}
 
+	/* accepted connections inherit it, so set once here */
+	if (si.si_proto == IPPROTO_TCP)
+		(void) setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one,
+				  sizeof(one));
+	xd->shared.nonblock = svc_vc_setnonblock(fd,
+						 flags & SVC_CREATE_FLAG_LISTEN);
+	if (flags & SVC_CREATE_FLAG_LISTEN)
+		svc_vc_xprt_pool_prime();
+
 	__rpc_address_setup(&xprt->xp_local);
 	rc = getsockname(fd, xprt->xp_local.nb.buf, &xprt->xp_local.nb.len);
 	if (rc < 0) {
@@ -266,6 +392,132 @@ svc_vc_ncreatef(const int fd, const u_int sendsz, const u_int recvsz,
 	return (xprt);
 }
 
+#if defined(SO_ATTACH_REUSEPORT_CBPF)
+/*
+ * SVC_VC_REUSEPORT_CPU: select listener (receiving cpu % n), by its
+ * index in the group, the order of listen().
+ */
+static int
+svc_vc_reuseport_cbpf(int fd, int n)
+{
+	struct sock_filter code[] = {
+		/* A = raw_smp_processor_id() */
+		{ BPF_LD | BPF_W | BPF_ABS, 0, 0, SKF_AD_OFF + SKF_AD_CPU },
+		/* A = A % n */
+		{ BPF_ALU | BPF_MOD | BPF_K, 0, 0, n },
+		/* return A */
+		{ BPF_RET | BPF_A, 0, 0, 0 },
+	};
+	struct sock_fprog prog = {
+		.len = sizeof(code) / sizeof(code[0]),
+		.filter = code,
+	};
+
+	if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog,
+		       sizeof(prog)) < 0)
+		return (errno);
+	return (0);
+}
+#endif
+
+/*
+ * Create n SO_REUSEPORT listeners on addr, each registered on its own
+ * event channel (chan_ids[i]).  Connections accepted by a listener are
+ * served on its channel, when that has SVC_RQST_FLAG_CHAN_AFFINITY.
+ *
+ * With SVC_VC_REUSEPORT_CPU, the kernel hands a connection to listener
+ * (cpu % n) of the cpu receiving it; SVC_VC_REUSEPORT_INCOMING_CPU is a
+ * hint to the same effect (listener i prefers cpu i).  Either way, the
+ * threads running chan_ids[i] should be bound to those cpus.
+ *
+ * Returns 0 or errno; on failure, none are left open.
+ */
+int
+svc_vc_ncreate_reuseport(const struct sockaddr *addr, const socklen_t len,
+			 const u_int sendsz, const u_int recvsz,
+			 const uint32_t *chan_ids, const int n,
+			 const uint32_t flags, SVCXPRT **xprts)
+{
+	int fd, ix;
+	int code = 0;
+	int one = 1;
+
+	if (n < 1 || !chan_ids || !xprts)
+		return (EINVAL);
+
+	memset(xprts, 0, n * sizeof(SVCXPRT *));
+
+	for (ix = 0; ix < n; ix++) {
+		fd = socket(addr->sa_family, SOCK_STREAM, 0);
+		if (fd < 0) {
+			code = errno;
+			goto err;
+		}
+		(void)setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one,
+				 sizeof(one));
+		if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one,
+			       sizeof(one)) < 0) {
+			code = errno;
+			close(fd);
+			goto err;
+		}
+		if (flags & SVC_VC_REUSEPORT_INCOMING_CPU) {
+#if defined(SO_INCOMING_CPU)
+			/* hint only */
+			(void)setsockopt(fd, SOL_SOCKET, SO_INCOMING_CPU, &ix,
+					 sizeof(ix));
+#endif
+		}
+		if (bind(fd, addr, len) < 0) {
+			code = errno;
+			close(fd);
+			goto err;
+		}
+
+		/* joins the group in order, by listen() */
+		xprts[ix] = svc_vc_ncreatef(fd, sendsz, recvsz,
+					    SVC_CREATE_FLAG_CLOSE
+					    | SVC_CREATE_FLAG_LISTEN
+					    | SVC_CREATE_FLAG_XPRT_NOREG);
+		if (!xprts[ix]) {
+			code = EINVAL;
+			close(fd);
+			goto err;
+		}
+
+		code = svc_rqst_evchan_reg(chan_ids[ix], xprts[ix],
+					   SVC_RQST_FLAG_CHAN_AFFINITY);
+		if (code)
+			goto err;
+	}
+
+	if (flags & SVC_VC_REUSEPORT_CPU) {
+#if defined(SO_ATTACH_REUSEPORT_CBPF)
+		/* for the whole group */
+		code = svc_vc_reuseport_cbpf(xprts[0]->xp_fd, n);
+#else
+		code = ENOTSUP;
+#endif
+		if (code)
+			goto err;
+	}
+
+	__warnx(TIRPC_DEBUG_FLAG_SVC_VC,
+		"%s: %d listeners fd %d..%d",
+		__func__, n, xprts[0]->xp_fd, xprts[n - 1]->xp_fd);
+	return (0);
+
+ err:
+	__warnx(TIRPC_DEBUG_FLAG_ERROR,
+		"%s: listener %d failed (%d)",
+		__func__, ix, code);
+	for (ix = 0; ix < n && xprts[ix]; ix++) {
+		SVC_DESTROY(xprts[ix]);
+		xprts[ix] = NULL;
+	}
+	return (code);
+}
+
 /*
  * Like sv_fd_ncreate(), except export flags for additional control.
  */
@@ -426,122 +678,142 @@ makefd_xprt(const int fd, const u_int sendsz, const u_int recvsz,
 	return (xprt);
 }
 
- /*ARGSUSED*/
-static bool
-rendezvous_request(struct svc_req *req)
+static void
+svc_vc_accept(SVCXPRT *xprt, int fd, struct sockaddr_storage *addr,
+	      socklen_t len, struct timespec *now)
 {
-	SVCXPRT *xprt = req->rq_xprt;
 	struct svc_vc_xprt *req_xd = VC_DR(REC_XPRT(xprt));
 	SVCXPRT *newxprt;
 	struct svc_vc_xprt *xd;
-	struct sockaddr_storage addr;
 	struct __rpc_sockinfo si;
-	int fd;
-	int rc;
-	socklen_t len;
 	u_int make_flags;
-	static int n = 1;
-
- again:
-	len = sizeof(addr);
-	fd = accept(xprt->xp_fd, (struct sockaddr *)(void *)&addr, &len);
-	if (fd < 0) {
-		if (errno == EINTR)
-			goto again;
-		/*
-		 * Clean out the most idle file descriptor when we're
-		 * running out.
-		 */
-		if (errno == EMFILE || errno == ENFILE) {
-			switch (__svc_params->ev_type) {
-#if defined(TIRPC_EPOLL)
-			case SVC_EVENT_EPOLL:
-				break;
-#endif
-			default:
-				abort();	/* XXX */
-				break;
-			}	/* switch */
-			goto again;
-		}
-		return (FALSE);
-	}
-
-	(void) setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &n, sizeof(n));
+	int code;
 
 	/*
 	 * make a new transport (re-uses xprt)
 	 */
 	make_flags = SVC_XPRT_FLAG_CLOSE;
+	if (__svc_params->flags & SVC_FLAG_VC_ET)
+		make_flags |= SVC_XPRT_FLAG_EDGE;
 	newxprt = makefd_xprt(fd, req_xd->shared.sendsz, req_xd->shared.recvsz,
 			      &si, &make_flags);
-	if ((!newxprt) || (!(make_flags & SVC_XPRT_FLAG_ADDED)))
-		return (FALSE);
+	if (!newxprt) {
+		close(fd);
+		return;
+	}
+	if (!(make_flags & SVC_XPRT_FLAG_ADDED))
+		return;
+
+	/* before the first event */
+	xd = VC_DR(REC_XPRT(newxprt));
+	xd->shared.nonblock = !!(newxprt->xp_flags & SVC_XPRT_FLAG_EDGE);
+	xd->shared.ioq_recv = xd->shared.nonblock
+		&& (__svc_params->flags & SVC_FLAG_VC_IOQ_RECV);
+	if (xd->shared.ioq_recv)
+		atomic_set_uint16_t_bits(&newxprt->xp_flags,
+					 SVC_XPRT_FLAG_RECV_SEGS);
 
 	/*
 	 * propagate special ops
 	 */
 	svc_vc_override_ops(xprt, newxprt);
 
-	/* move xprt_register() out of makefd_xprt */
-	(void)svc_rqst_xprt_register(xprt, newxprt);
-
 	__rpc_address_setup(&newxprt->xp_remote);
-	memcpy(newxprt->xp_remote.nb.buf, &addr, len);
+	memcpy(newxprt->xp_remote.nb.buf, addr, len);
 	newxprt->xp_remote.nb.len = len;
-	XPRT_TRACE(newxprt, __func__, __func__, __LINE__);
 
-	/* XXX fvdl - is this useful? (Yes.  Matt) */
-	if (si.si_proto == IPPROTO_TCP) {
-		len = 1;
-		(void) setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &len,
-				  sizeof(len));
+	/* TCP_NODELAY from the listener */
+	if (!(__svc_params->flags & SVC_FLAG_LAZY_LOCAL))
+		(void)svc_xprt_local(newxprt);
+
+	xd->shared.recvsz = req_xd->shared.recvsz;
+	xd->shared.sendsz = req_xd->shared.sendsz;
+	xd->sx.maxrec = req_xd->sx.maxrec;
+	newxprt->xp_wpe.prio = xprt->xp_wpe.prio;
+
+	xd->sx.last_recv = *now;
+
+	/* as the scans did, reap only nonblocking connections */
+	if (__svc_params->idle_timeout > 0 && xd->shared.nonblock) {
+		xd->sx.idle.fun = svc_vc_idle_expire;
+		timer_wheel_add(&svc_idle_wheel, &xd->sx.idle,
+				__svc_params->idle_timeout * 1000);
 	}
 
-	__rpc_address_setup(&newxprt->xp_local);
-	rc = getsockname(fd, newxprt->xp_local.nb.buf,
-			 &newxprt->xp_local.nb.len);
-	if (rc < 0) {
-		newxprt->xp_local.nb.len = sizeof(struct sockaddr_storage);
-		memset(newxprt->xp_local.nb.buf, 0xfe,
-		       newxprt->xp_local.nb.len);
-		__warnx(TIRPC_DEBUG_FLAG_SVC_VC,
-			"%s: fd %d getsockname failed (%d)",
-			 __func__, fd, rc);
+	/* move xprt_register() out of makefd_xprt */
+	code = svc_rqst_xprt_register(xprt, newxprt);
+	if (code) {
+		__warnx(TIRPC_DEBUG_FLAG_ERROR,
+			"%s: fd %d registration failed (%d)",
+			__func__, fd, code);
+		SVC_DESTROY(newxprt);
+		return;
 	}
+	XPRT_TRACE(newxprt, __func__, __func__, __LINE__);
 
 #if defined(HAVE_BLKIN)
 	__rpc_set_blkin_endpoint(newxprt, "svc_vc");
 #endif
 
-	xd = VC_DR(REC_XPRT(newxprt));
-	xd->shared.recvsz = req_xd->shared.recvsz;
-	xd->shared.sendsz = req_xd->shared.sendsz;
-	xd->sx.maxrec = req_xd->sx.maxrec;
-
-#if 0  /* XXX vrec wont support atm (and it seems to need work) */
-	if (cd->maxrec != 0) {
-		flags = fcntl(fd, F_GETFL, 0);
-		if (flags == -1)
-			return (FALSE);
-		if (fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1)
-			return (FALSE);
-		if (xd->shared.recvsz > xd->sx.maxrec)
-			xd->shared.recvsz = xd->sx.maxrec;
-		xd->shared.nonblock = TRUE;
-		__xdrrec_setnonblock(&xd->shared.xdrs_in, xd->sx.maxrec);
-		__xdrrec_setnonblock(&xd->shared.xdrs_out, xd->sx.maxrec);
-	} else
-		cd->nonblock = FALSE;
-#else
-	xd->shared.nonblock = FALSE;
-#endif
-	(void)clock_gettime(CLOCK_MONOTONIC_FAST, &xd->sx.last_recv);
-
 	/* if parent has xp_recv_user_data, use it */
 	if (xprt->xp_ops->xp_recv_user_data)
 		xprt->xp_ops->xp_recv_user_data(xprt, newxprt,
 						SVC_RQST_FLAG_NONE, NULL);
+}
+
+/* connections taken per event; the rest wait for the rearm */
+#define SVC_VC_ACCEPT_MAX 64
+
+ /*ARGSUSED*/
+static bool
+rendezvous_request(struct svc_req *req)
+{
+	SVCXPRT *xprt = req->rq_xprt;
+	struct svc_vc_xprt *xd = VC_DR(REC_XPRT(xprt));
+	struct sockaddr_storage addr;
+	struct timespec now;
+	socklen_t len;
+	int flags = SOCK_CLOEXEC;
+	int fd;
+	int n;
+
+	if (__svc_params->flags & SVC_FLAG_VC_ET)
+		flags |= SOCK_NONBLOCK;
+	(void)clock_gettime(CLOCK_MONOTONIC_FAST, &now);
+
+	for (n = 0; n < SVC_VC_ACCEPT_MAX; n++) {
+		len = sizeof(addr);
+		fd = accept4(xprt->xp_fd, (struct sockaddr *)(void *)&addr,
+			     &len, flags);
+		if (fd >= 0) {
+			svc_vc_accept(xprt, fd, &addr, len, &now);
+			if (!xd->shared.nonblock)
+				break;
+			continue;
+		}
+		if (errno == EINTR)
+			continue;
+		/*
+		 * Clean out the most idle file descriptor when we're
+		 * running out.
+		 */
+		if (errno == EMFILE || errno == ENFILE) {
+			switch (__svc_params->ev_type) {
+#if defined(TIRPC_EPOLL)
+			case SVC_EVENT_EPOLL:
+				break;
+#endif
+			default:
+				abort();	/* XXX */
+				break;
+			}	/* switch */
+			__warnx(TIRPC_DEBUG_FLAG_ERROR,
+				"%s: fd %d accept failed (%d)",
+				__func__, xprt->xp_fd, errno);
+		}
+		/* EAGAIN: all taken */
+		break;
+	}
 
 	return (FALSE);	/* there is never an rpc msg to be processed */
 }
@@ -561,6 +833,9 @@ svc_vc_destroy_it(SVCXPRT *xprt, u_int flags, const char *tag, const int line)
 {
 	struct svc_vc_xprt *xd = VC_DR(REC_XPRT(xprt));
 
+	/* waits out svc_vc_idle_expire() */
+	(void)timer_wheel_del(&svc_idle_wheel, &xd->sx.idle);
+
 	/* clears xprt from the xprt table (eg, idle scans) */
 	svc_rqst_xprt_unregister(xprt);
 
@@ -569,9 +844,14 @@ svc_vc_destroy_it(SVCXPRT *xprt, u_int flags, const char *tag, const int line)
 		" should actually destroy things @ %s:%d",
 		__func__, xprt, xprt->xp_refs, tag, line);
 
+	/* reaps what it can from the open fd */
+	svc_ioq_zerocopy_drop(xprt);
 	if ((xprt->xp_flags & SVC_XPRT_FLAG_CLOSE)
 	    && xprt->xp_fd != RPC_ANYFD)
 		(void)close(xprt->xp_fd);
+	/* our own, for EPOLLOUT */
+	if (xprt->xp_fd_send >= 0)
+		(void)close(xprt->xp_fd_send);
 
 	if (xprt->xp_ops->xp_free_user_data) {
 		/* call free hook */
@@ -661,6 +941,14 @@ svc_vc_control(SVCXPRT *xprt, const u_int rq, void *in)
 		xprt->xp_ops->xp_free_user_data = *(xp_free_user_data_t) in;
 		mutex_unlock(&ops_lock);
 		break;
+	case SVCGET_XP_PRIO:
+		*(uint32_t *)in = xprt->xp_wpe.prio;
+		break;
+	case SVCSET_XP_PRIO:
+		if (*(uint32_t *)in >= WORK_POOL_PRIO_MAX)
+			return (FALSE);
+		xprt->xp_wpe.prio = *(uint32_t *)in;
+		break;
 	default:
 		return (FALSE);
 	}
@@ -729,12 +1017,570 @@ svc_vc_rendezvous_control(SVCXPRT *xprt, const u_int rq, void *in)
 		xprt->xp_ops->xp_free_user_data = *(xp_free_user_data_t) in;
 		mutex_unlock(&ops_lock);
 		break;
+	case SVCGET_XP_PRIO:
+		*(uint32_t *)in = xprt->xp_wpe.prio;
+		break;
+	case SVCSET_XP_PRIO:
+		if (*(uint32_t *)in >= WORK_POOL_PRIO_MAX)
+			return (FALSE);
+		xprt->xp_wpe.prio = *(uint32_t *)in;
+		break;
 	default:
 		return (FALSE);
 	}
 	return (TRUE);
 }
 
+/*
+ * SVC_XPRT_FLAG_EDGE receive
+ *
+ * Each event is drained into xd->shared.ring, until the socket is empty
+ * (or the ring is full of complete records), without re-arming.  The
+ * records completed are then received one after another by the same
+ * svc_getreq_default() loop, and fed to xdrs_in from memory.
+ */
+
+#define LAST_FRAG ((u_int32_t)(1 << 31))
+
+/* the largest record buffered, whether or not maxrec is set */
+static inline size_t
+svc_vc_maxrec(struct svc_vc_xprt *xd)
+{
+	if (xd->sx.maxrec > 0)
+		return (xd->sx.maxrec);
+	return (MAX((size_t)SVC_VC_MAXREC_BUFS * __svc_params->svc_ioq_maxbuf,
+		    (size_t)xd->shared.recvsz));
+}
+
+/* count the records completed; false when malformed */
+static bool
+svc_vc_ring_scan(struct svc_vc_xprt *xd)
+{
+	struct svc_vc_ring *ring = &xd->shared.ring;
+	u_int32_t header;
+	size_t end;
+
+	while (ring->tail - ring->scan >= sizeof(header)) {
+		memcpy(&header, ring->base + ring->scan, sizeof(header));
+		header = ntohl(header);
+
+		/* the same check as xdr_inrec */
+		if (header == 0)
+			return (false);
+
+		end = (size_t)ring->scan + sizeof(header)
+		    + (header & ~LAST_FRAG);
+		if (end - ring->ready > svc_vc_maxrec(xd))
+			return (false);
+		if (end > ring->tail)
+			break;
+
+		ring->scan = end;
+		if (header & LAST_FRAG) {
+			ring->ready = end;
+			ring->recs++;
+		}
+	}
+	return (true);
+}
+
+/* room to read into; false when full of records still to receive, or
+ * of one record over svc_vc_maxrec() (ring->recs is 0)
+ */
+static bool
+svc_vc_ring_room(struct svc_vc_xprt *xd)
+{
+	struct svc_vc_ring *ring = &xd->shared.ring;
+	size_t size;
+
+	if (unlikely(!ring->base)) {
+		ring->size = xd->shared.recvsz;
+		ring->base = mem_alloc(ring->size);
+	}
+	if (ring->tail < ring->size)
+		return (true);
+
+	if (ring->head) {
+		memmove(ring->base, ring->base + ring->head,
+			ring->tail - ring->head);
+		ring->ready -= ring->head;
+		ring->scan -= ring->head;
+		ring->tail -= ring->head;
+		ring->head = 0;
+		return (true);
+	}
+	if (ring->recs)
+		return (false);
+
+	/* a record larger than the ring, up to svc_vc_maxrec() and the
+	 * next fragment header (past that, ring_scan() has failed it)
+	 */
+	size = MIN((size_t)ring->size * 2,
+		   svc_vc_maxrec(xd) + sizeof(u_int32_t));
+	if (size <= ring->size || size > UINT_MAX)
+		return (false);
+	ring->base = mem_realloc(ring->base, size);
+	ring->size = size;
+	return (true);
+}
+
+static void
+svc_vc_drain(SVCXPRT *xprt, struct svc_vc_xprt *xd)
+{
+	struct svc_vc_ring *ring = &xd->shared.ring;
+	ssize_t n;
+	bool got = false;
+
+	/* events from here on are for us */
+	atomic_clear_uint32_t_bits(&xprt->xp_ev_busy, SVC_XPRT_EV_PENDING);
+
+	for (;;) {
+		if (!svc_vc_ring_room(xd)) {
+			if (!ring->recs) {
+				__warnx(TIRPC_DEBUG_FLAG_SVC_VC,
+					"%s: fd %d record too large (will set dead)",
+					__func__, xprt->xp_fd);
+				goto dead;
+			}
+			/* back for the rest after these */
+			atomic_set_uint32_t_bits(&xprt->xp_ev_busy,
+						 SVC_XPRT_EV_PENDING);
+			break;
+		}
+		n = read(xprt->xp_fd, ring->base + ring->tail,
+			 ring->size - ring->tail);
+		if (n > 0) {
+			ring->tail += n;
+			got = true;
+			if (!svc_vc_ring_scan(xd)) {
+				__warnx(TIRPC_DEBUG_FLAG_SVC_VC,
+					"%s: fd %d bad record (will set dead)",
+					__func__, xprt->xp_fd);
+				goto dead;
+			}
+			/* even when short, a FIN may follow without an edge */
+			continue;
+		}
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			break;
+
+		/* closed (or failed); records already read are received */
+		__warnx(TIRPC_DEBUG_FLAG_SVC_VC,
+			"%s: fd %d read returns %zd (will set dead)",
+			__func__, xprt->xp_fd, n);
+		goto dead;
+	}
+
+	if (got)
+		(void)clock_gettime(CLOCK_MONOTONIC_FAST, &xd->sx.last_recv);
+	return;
+
+ dead:
+	mutex_lock(&xprt->xp_lock);
+	xd->sx.strm_stat = XPRT_DIED;
+	mutex_unlock(&xprt->xp_lock);
+}
+
+/*
+ * SVC_INIT_VC_IOQ_RECV
+ *
+ * Instead of the ring, each event is drained with readv() into pooled
+ * page sized segments.  Fragment headers are parsed out, and each record
+ * becomes an xdr_ioq of views of its data in those segments, decoded in
+ * place.  The segments return to the pool once the records sharing them
+ * are decoded, for replies and further input.
+ *
+ * On a SVC_RQST_FLAG_URING channel with multishot recv, the kernel
+ * receives into such segments itself, and the reader only takes them
+ * (svc_rqst_recv_take()).
+ */
+
+#define SVC_VC_SEGS_IOV 16	/* segments per readv() */
+
+static inline u_int
+svc_vc_recs(struct svc_vc_xprt *xd)
+{
+	if (xd->shared.ioq_recv)
+		return (xd->shared.segs.nrecs);
+	return (xd->shared.ring.recs);
+}
+
+/*
+ * inline_max: whether the next record of an SVC_XPRT_FLAG_EDGE connection
+ * is whole, and no larger, received already or readable (avail bytes);
+ * so decoding it on the event thread will not wait for input.  Called
+ * holding SVC_XPRT_EV_ACTIVE: no other thread receives meanwhile.
+ */
+bool
+svc_vc_inline_ready(SVCXPRT *xprt, int avail)
+{
+	struct svc_vc_xprt *xd = VC_DR(REC_XPRT(xprt));
+	struct svc_vc_ring *ring = &xd->shared.ring;
+	struct svc_vc_segs *segs = &xd->shared.segs;
+	u_int32_t header;
+	size_t len;
+
+	if (xd->shared.ioq_recv) {
+		if (segs->nrecs)
+			return (segs->ready <= __svc_params->inline_max);
+		/* part of one read, or the channel receives for us */
+		if (segs->rec || segs->hlen || xprt->xp_ev_recv)
+			return (false);
+	} else {
+		if (ring->recs)
+			return (ring->ready - ring->head
+				<= __svc_params->inline_max);
+		if (ring->tail != ring->head)
+			return (false);
+	}
+
+	/* nothing buffered: a single fragment, all in the socket */
+	if (avail < (int)sizeof(header)
+	 || recv(xprt->xp_fd, &header, sizeof(header),
+		 MSG_PEEK | MSG_DONTWAIT) != sizeof(header))
+		return (false);
+	header = ntohl(header);
+	if (!(header & LAST_FRAG))
+		return (false);
+	len = sizeof(header) + (header & ~LAST_FRAG);
+	return (len <= (size_t)avail && len <= __svc_params->inline_max);
+}
+
+static void
+svc_vc_segs_view(struct svc_vc_segs *segs, struct xdr_ioq_uv *seg)
+{
+	struct xdr_ioq_uv *uv;
+
+	if (segs->mark == segs->scan)
+		return;
+
+	uv = svc_ioq_seg_view(seg, segs->mark, segs->scan);
+	(segs->rec->ioq_uv.uvqh.qcount)++;
+	TAILQ_INSERT_TAIL(&segs->rec->ioq_uv.uvqh.qh, &uv->uvq, q);
+	segs->mark = segs->scan;
+}
+
+/* the first segment, now at scan */
+static inline void
+svc_vc_segs_first(struct svc_vc_segs *segs)
+{
+	struct poolq_entry *have = TAILQ_FIRST(&segs->qh);
+
+	if (have) {
+		segs->scan = IOQ_(have)->v.vio_head;
+		segs->mark = segs->scan;
+	}
+}
+
+/* make views of the bytes read into records; false when malformed.
+ * taken: the segments are not read into again.
+ */
+static bool
+svc_vc_segs_scan(struct svc_vc_xprt *xd, bool taken)
+{
+	struct svc_vc_segs *segs = &xd->shared.segs;
+	struct poolq_entry *have;
+	struct xdr_ioq_uv *seg;
+	char *tail;
+	u_int n;
+
+	while ((have = TAILQ_FIRST(&segs->qh))) {
+		seg = IOQ_(have);
+		tail = seg->v.vio_tail;
+
+		if (segs->scan == tail) {
+			if (tail < (char *)seg->v.vio_wrap && !taken)
+				break;	/* read into it again */
+
+			/* done with it, but for the views */
+			svc_vc_segs_view(segs, seg);
+			TAILQ_REMOVE(&segs->qh, have, q);
+			svc_ioq_seg_unref(seg);
+			svc_vc_segs_first(segs);
+			continue;
+		}
+
+		if (segs->hlen < sizeof(segs->header)) {
+			n = MIN(tail - segs->scan,
+				sizeof(segs->header) - segs->hlen);
+			memcpy((char *)&segs->header + segs->hlen,
+			       segs->scan, n);
+			segs->hlen += n;
+			segs->scan += n;
+			segs->mark = segs->scan;
+			if (segs->hlen < sizeof(segs->header))
+				continue;
+
+			segs->header = ntohl(segs->header);
+
+			/* the same checks as svc_vc_ring_scan() */
+			if (segs->header == 0)
+				return (false);
+			segs->fbtbc = segs->header & ~LAST_FRAG;
+			if ((size_t)segs->rlen + segs->fbtbc
+			    > svc_vc_maxrec(xd))
+				return (false);
+
+			if (!segs->rec) {
+				segs->rec = mem_zalloc(sizeof(struct xdr_ioq));
+				xdr_ioq_setup(segs->rec);
+				segs->rec->xdrs[0].x_op = XDR_DECODE;
+			}
+		}
+
+		n = MIN(tail - segs->scan, segs->fbtbc);
+		segs->scan += n;
+		segs->fbtbc -= n;
+		segs->rlen += n;
+		if (segs->fbtbc)
+			continue;
+
+		/* end of fragment */
+		svc_vc_segs_view(segs, seg);
+		segs->hlen = 0;
+		if (!(segs->header & LAST_FRAG))
+			continue;
+
+		if (!segs->rec->ioq_uv.uvqh.qcount)
+			return (false);	/* empty record */
+		TAILQ_INSERT_TAIL(&segs->recs, &segs->rec->ioq_s, q);
+		segs->rec = NULL;
+		segs->ready += segs->rlen;
+		segs->rlen = 0;
+		segs->nrecs++;
+	}
+	return (true);
+}
+
+/* segments to read into, after those partly read; returns the count */
+static int
+svc_vc_segs_iov(struct svc_vc_segs *segs, struct iovec *iov,
+		struct xdr_ioq_uv **uvs)
+{
+	struct poolq_entry *have;
+	struct xdr_ioq_uv *seg;
+	int n = 0;
+
+	TAILQ_FOREACH(have, &segs->qh, q) {
+		seg = IOQ_(have);
+		if (seg->v.vio_tail == seg->v.vio_wrap)
+			continue;
+		if (n == SVC_VC_SEGS_IOV)
+			return (n);
+		iov[n].iov_base = seg->v.vio_tail;
+		iov[n].iov_len = (uintptr_t)seg->v.vio_wrap
+				- (uintptr_t)seg->v.vio_tail;
+		uvs[n++] = seg;
+	}
+
+	while (n < SVC_VC_SEGS_IOV) {
+		seg = svc_ioq_seg_get();
+		TAILQ_INSERT_TAIL(&segs->qh, &seg->uvq, q);
+		if (TAILQ_FIRST(&segs->qh) == &seg->uvq)
+			svc_vc_segs_first(segs);
+		iov[n].iov_base = seg->v.vio_tail;
+		iov[n].iov_len = ioquv_size(seg);
+		uvs[n++] = seg;
+	}
+	return (n);
+}
+
+/* return the segments not read into */
+static void
+svc_vc_segs_trim(struct svc_vc_segs *segs)
+{
+	struct poolq_entry *have;
+	struct xdr_ioq_uv *seg;
+
+	while ((have = TAILQ_LAST(&segs->qh, q_head))) {
+		seg = IOQ_(have);
+		if (seg->v.vio_tail != seg->v.vio_head)
+			break;
+		TAILQ_REMOVE(&segs->qh, have, q);
+		svc_ioq_seg_unref(seg);
+	}
+}
+
+static void
+svc_vc_segs_drain(SVCXPRT *xprt, struct svc_vc_xprt *xd)
+{
+	struct svc_vc_segs *segs = &xd->shared.segs;
+	struct q_head taken = TAILQ_HEAD_INITIALIZER(taken);
+	struct iovec iov[SVC_VC_SEGS_IOV];
+	struct xdr_ioq_uv *uvs[SVC_VC_SEGS_IOV];
+	ssize_t n;
+	size_t len;
+	bool got = false;
+	int ix, cnt;
+	int code;
+
+	/* events from here on are for us */
+	atomic_clear_uint32_t_bits(&xprt->xp_ev_busy, SVC_XPRT_EV_PENDING);
+
+	/* received by the channel (or left by the last), before reading */
+	code = svc_rqst_recv_take(xprt, &taken);
+	if (!TAILQ_EMPTY(&taken)) {
+		got = true;
+		if (TAILQ_EMPTY(&segs->qh)) {
+			TAILQ_CONCAT(&segs->qh, &taken, q);
+			svc_vc_segs_first(segs);
+		} else
+			TAILQ_CONCAT(&segs->qh, &taken, q);
+		if (!svc_vc_segs_scan(xd, true)) {
+			__warnx(TIRPC_DEBUG_FLAG_SVC_VC,
+				"%s: fd %d bad record (will set dead)",
+				__func__, xprt->xp_fd);
+			goto dead;
+		}
+	}
+	switch (code) {
+	case 0:
+		goto out;
+	case EAGAIN:
+		break;
+	default:
+		/* the records already scanned are still decoded */
+		__warnx(TIRPC_DEBUG_FLAG_SVC_VC,
+			"%s: fd %d recv failed (%d) (will set dead)",
+			__func__, xprt->xp_fd, code);
+		goto dead;
+	}
+
+	for (;;) {
+		if (segs->nrecs && segs->ready >= xd->shared.recvsz) {
+			/* back for the rest after these */
+			atomic_set_uint32_t_bits(&xprt->xp_ev_busy,
+						 SVC_XPRT_EV_PENDING);
+			break;
+		}
+		cnt = svc_vc_segs_iov(segs, iov, uvs);
+		n = readv(xprt->xp_fd, iov, cnt);
+		if (n > 0) {
+			got = true;
+			for (ix = 0; n > 0; ix++) {
+				len = MIN((size_t)n, iov[ix].iov_len);
+				uvs[ix]->v.vio_tail =
+					(char *)uvs[ix]->v.vio_tail + len;
+				n -= len;
+			}
+			if (!svc_vc_segs_scan(xd, false)) {
+				__warnx(TIRPC_DEBUG_FLAG_SVC_VC,
+					"%s: fd %d bad record (will set dead)",
+					__func__, xprt->xp_fd);
+				goto dead;
+			}
+			/* even when short, a FIN may follow without an edge */
+			continue;
+		}
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			break;
+
+		/* closed (or failed); records already read are received */
+		__warnx(TIRPC_DEBUG_FLAG_SVC_VC,
+			"%s: fd %d readv returns %zd (will set dead)",
+			__func__, xprt->xp_fd, n);
+		goto dead;
+	}
+	svc_rqst_recv_done(xprt);
+
+ out:
+	svc_vc_segs_trim(segs);
+	if (got)
+		(void)clock_gettime(CLOCK_MONOTONIC_FAST, &xd->sx.last_recv);
+	return;
+
+ dead:
+	if (code == EAGAIN)
+		svc_rqst_recv_done(xprt);
+	svc_vc_segs_trim(segs);
+	mutex_lock(&xprt->xp_lock);
+	xd->sx.strm_stat = XPRT_DIED;
+	mutex_unlock(&xprt->xp_lock);
+}
+
+/* the next complete record, to decode */
+static XDR *
+svc_vc_segs_next(struct svc_vc_xprt *xd)
+{
+	struct svc_vc_segs *segs = &xd->shared.segs;
+	struct poolq_entry *have = TAILQ_FIRST(&segs->recs);
+	struct xdr_ioq *xioq = _IOQ(have);
+
+	TAILQ_REMOVE(&segs->recs, have, q);
+	segs->nrecs--;
+	TAILQ_FOREACH(have, &xioq->ioq_uv.uvqh.qh, q)
+		segs->ready -= ioquv_length(IOQ_(have));
+
+	xdr_ioq_reset(xioq, 0);
+	xd->shared.xioq_in = xioq;
+	return (xioq->xdrs);
+}
+
+/* done decoding the record received */
+static inline void
+svc_vc_segs_done(struct svc_vc_xprt *xd)
+{
+	if (xd->shared.xioq_in) {
+		XDR_DESTROY(xd->shared.xioq_in->xdrs);
+		xd->shared.xioq_in = NULL;
+	}
+}
+
+/* as xdr_inrec_cksum(), of the start of the record */
+static uint64_t
+svc_vc_segs_cksum(struct xdr_ioq *xioq)
+{
+	struct xdr_ioq_uv *uv = IOQ_(TAILQ_FIRST(&xioq->ioq_uv.uvqh.qh));
+
+	return (CityHash64WithSeed(uv->v.vio_head,
+				   MIN(256, ioquv_length(uv)), 103));
+}
+
+static void
+svc_vc_segs_free(struct svc_vc_xprt *xd)
+{
+	struct svc_vc_segs *segs = &xd->shared.segs;
+	struct poolq_entry *have;
+
+	svc_vc_segs_done(xd);
+	while ((have = TAILQ_FIRST(&segs->recs))) {
+		TAILQ_REMOVE(&segs->recs, have, q);
+		XDR_DESTROY(_IOQ(have)->xdrs);
+	}
+	if (segs->rec) {
+		XDR_DESTROY(segs->rec->xdrs);
+		segs->rec = NULL;
+	}
+	while ((have = TAILQ_FIRST(&segs->qh))) {
+		TAILQ_REMOVE(&segs->qh, have, q);
+		svc_ioq_seg_unref(IOQ_(have));
+	}
+}
+
+/* SVC_XPRT_FLAG_EDGE: idle once drained, unless an event came since */
+static enum xprt_stat
+svc_vc_edge_stat(SVCXPRT *xprt, struct svc_vc_xprt *xd)
+{
+	uint32_t busy;
+
+	if (svc_vc_recs(xd))
+		return (XPRT_MOREREQS);
+	if (xd->sx.strm_stat == XPRT_DIED)
+		return (XPRT_DIED);
+
+	busy = atomic_fetch_uint32_t(&xprt->xp_ev_busy);
+	do {
+		if (busy & SVC_XPRT_EV_PENDING)
+			return (XPRT_MOREREQS);	/* svc_vc_recv() drains */
+	} while (!atomic_cas_uint32_t(&xprt->xp_ev_busy, &busy, 0));
+
+	return (XPRT_IDLE);
+}
+
 static enum xprt_stat
 svc_vc_stat(SVCXPRT *xprt)
 {
@@ -745,7 +1591,10 @@ svc_vc_stat(SVCXPRT *xprt)
 							SVC_XPRT_FLAG_BLOCKED);
 
 	if (xp_flags & SVC_XPRT_FLAG_BLOCKED) {
-		if (xd->sx.strm_stat == XPRT_DIED)
+		svc_vc_segs_done(xd);
+		if (xprt->xp_flags & SVC_XPRT_FLAG_EDGE)
+			result = svc_vc_edge_stat(xprt, xd);
+		else if (xd->sx.strm_stat == XPRT_DIED)
 			result = XPRT_DIED;
 		else if (!xdr_inrec_eof(&(xd->shared.xdrs_in)))
 			result = XPRT_MOREREQS;
@@ -779,23 +1628,39 @@ svc_vc_recv(struct svc_req *req)
 		rpc_dplx_rwi(rec);
 	} while (TRUE);
 
-	/* XXX assert(! cd->nonblock) */
-	if (xd->shared.nonblock) {
-		if (!__xdrrec_getrec(xdrs, &xd->sx.strm_stat, TRUE))
-			return FALSE;
+	if (xprt->xp_flags & SVC_XPRT_FLAG_EDGE) {
+		if (!svc_vc_recs(xd)
+		 && xd->sx.strm_stat != XPRT_DIED) {
+			if (xd->shared.ioq_recv)
+				svc_vc_segs_drain(xprt, xd);
+			else
+				svc_vc_drain(xprt, xd);
+		}
+		if (!svc_vc_recs(xd))
+			return (FALSE);
+		if (!xd->shared.ioq_recv)
+			xd->shared.ring.recs--;
 	}
 
 	xdrs->x_op = XDR_DECODE;
 	xdrs->x_lib[1] = (void *)xprt;	/* transiently thread xprt */
 
-	/* Consumes any remaining -fragment- bytes, and clears last_frag */
-	(void)xdr_inrec_skiprecord(xdrs);
+	if (xd->shared.ioq_recv) {
+		/* a whole record, in place */
+		xdrs = svc_vc_segs_next(xd);
+		xdrs->x_lib[1] = (void *)xprt;
+		rpc_msg_init(&req->rq_msg);
+	} else {
+		/* Consumes any remaining -fragment- bytes,
+		 * and clears last_frag */
+		(void)xdr_inrec_skiprecord(xdrs);
 
-	rpc_msg_init(&req->rq_msg);
+		rpc_msg_init(&req->rq_msg);
 
-	/* Advances to next record, will read up to 1024 bytes
-	 * into the stream. */
-	(void)xdr_inrec_readahead(xdrs, 1024);
+		/* Advances to next record, will read up to 1024 bytes
+		 * into the stream. */
+		(void)xdr_inrec_readahead(xdrs, 1024);
+	}
 
 	if (xdr_dplx_decode(xdrs, &req->rq_msg)) {
 		switch (req->rq_msg.rm_direction) {
@@ -831,7 +1696,7 @@ svc_vc_getargs(struct svc_req *req, xdrproc_t xdr_args, void *args_ptr,
 	       void *u_data)
 {
 	struct svc_vc_xprt *xd = VC_DR(REC_XPRT(req->rq_xprt));
-	XDR *xdrs = &xd->shared.xdrs_in;	/* recv queue */
+	XDR *xdrs = svc_vc_xdrs_in(xd);	/* recv queue */
 	bool rslt;
 
 	/* threads u_data for advanced decoders */
@@ -842,10 +1707,15 @@ svc_vc_getargs(struct svc_req *req, xdrproc_t xdr_args, void *args_ptr,
 	/* XXX Upstream TI-RPC lacks this call, but -does- call svc_dg_freeargs
 	 * in svc_dg_getargs if SVCAUTH_UNWRAP fails. */
 	if (rslt)
-		req->rq_cksum = xdr_inrec_cksum(xdrs);
+		req->rq_cksum = xd->shared.xioq_in
+			? svc_vc_segs_cksum(xd->shared.xioq_in)
+			: xdr_inrec_cksum(xdrs);
 	else
 		svc_vc_freeargs(req, xdr_args, args_ptr);
 
+	/* the arguments are decoded, its segments can take the reply */
+	svc_vc_segs_done(xd);
+
 	return (rslt);
 }
 
@@ -881,11 +1751,16 @@ svc_vc_reply(struct svc_req *req)
 	 * an equivalent for Windows.
 	 */
 	gss = (req->rq_msg.cb_cred.oa_flavor == RPCSEC_GSS);
-	xdrs_2 = xdr_ioq_create(8192 /* default segment size */ ,
-				__svc_params->svc_ioq_maxbuf + 8192,
-				gss
-				? UIO_FLAG_REALLOC | UIO_FLAG_FREE
-				: UIO_FLAG_FREE);
+	if (gss)
+		xdrs_2 = xdr_ioq_create(8192 /* default segment size */ ,
+					__svc_params->svc_ioq_maxbuf + 8192,
+					UIO_FLAG_REALLOC | UIO_FLAG_FREE);
+	else if (VC_DR(REC_XPRT(req->rq_xprt))->shared.ioq_recv)
+		xdrs_2 = svc_ioq_seg_xdr_create();
+	else
+		xdrs_2 = xdr_ioq_cache_create(8192 /* default segment size */ ,
+					      __svc_params->svc_ioq_maxbuf
+					      + 8192);
 	if (xdr_replymsg(xdrs_2, &req->rq_msg)
 	    && (!has_args
 		|| (req->rq_auth
@@ -1011,21 +1886,62 @@ __rpc_get_local_uid(SVCXPRT *transp, uid_t *uid)
  * API without changing the library's sonum.
  */
 
+
+static bool svc_clean_least_active(bool cleanblock);
+
 bool
 __svc_clean_idle(fd_set *fds, int timeout, bool cleanblock)
 {
+	if (timeout == 0)
+		return (svc_clean_least_active(cleanblock));
+
 	return (__svc_clean_idle2(timeout, cleanblock));
 
 }				/* __svc_clean_idle */
 
+static uint32_t svc_vc_idle_cleaned;
+
 /*
- * Like __svc_clean_idle but event-type independent.  For now no cleanfds.
+ * svc_idle_wheel callback, armed for each accepted connection.  Receives
+ * only update last_recv, so re-arm here for what remains.
  */
+static void
+svc_vc_idle_expire(struct timer_wheel_entry *twe)
+{
+	struct svc_vc_xprt *xd =
+		opr_containerof(twe, struct svc_vc_xprt, sx.idle);
+	SVCXPRT *xprt = &xd->sx_dr.xprt;
+	int32_t timeout = __svc_params->idle_timeout;
+	struct timespec ts;
+	time_t idle;
+
+	if (timeout <= 0)
+		return;
+
+	if (atomic_fetch_uint16_t(&xprt->xp_flags)
+	    & (SVC_XPRT_FLAG_DESTROYED | SVC_XPRT_FLAG_DESTROYING
+	       | SVC_XPRT_FLAG_UREG))
+		return;
+
+	(void)clock_gettime(CLOCK_MONOTONIC_FAST, &ts);
+	idle = ts.tv_sec - xd->sx.last_recv.tv_sec;
+	if (idle <= timeout) {
+		timer_wheel_add(&svc_idle_wheel, twe,
+				(timeout - idle + 1) * 1000);
+		return;
+	}
+
+	__warnx(TIRPC_DEBUG_FLAG_SVC_VC,
+		"%s: %p fd %d idle %ld s", __func__, xprt, xprt->xp_fd,
+		(long)idle);
+	atomic_inc_uint32_t(&svc_vc_idle_cleaned);
+	SVC_DESTROY(xprt);
+}
 
 struct svc_clean_idle_arg {
 	SVCXPRT *least_active;
 	struct timespec ts, tmax;
-	int cleanblock, ncleaned, timeout;
+	int cleanblock;
 };
 
 static uint32_t
@@ -1056,21 +1972,11 @@ svc_clean_idle2_func(SVCXPRT *xprt, void *arg)
 		if (!xd->shared.nonblock)
 			goto unlock;
 
-		if (acc->timeout == 0) {
-			tdiff = acc->ts;
-			timespecsub(&tdiff, &xd->sx.last_recv);
-			if (timespeccmp(&tdiff, &acc->tmax, >)) {
-				acc->tmax = tdiff;
-				acc->least_active = xprt;
-			}
-			goto unlock;
-		}
-		if (acc->ts.tv_sec - xd->sx.last_recv.tv_sec > acc->timeout) {
-			rflag = SVC_XPRT_FOREACH_CLEAR;
-			mutex_unlock(&xprt->xp_lock);
-			SVC_DESTROY(xprt);
-			acc->ncleaned++;
-			goto out;
+		tdiff = acc->ts;
+		timespecsub(&tdiff, &xd->sx.last_recv);
+		if (timespeccmp(&tdiff, &acc->tmax, >)) {
+			acc->tmax = tdiff;
+			acc->least_active = xprt;
 		}
 	}
 
@@ -1081,15 +1987,43 @@ svc_clean_idle2_func(SVCXPRT *xprt, void *arg)
 	return (rflag);
 }
 
+/*
+ * Legacy timeout 0: destroy the least active connection.  This is the
+ * only case that still scans every xprt.
+ */
+static bool
+svc_clean_least_active(bool cleanblock)
+{
+	struct svc_clean_idle_arg acc;
+
+	memset(&acc, 0, sizeof(struct svc_clean_idle_arg));
+	(void)clock_gettime(CLOCK_MONOTONIC_FAST, &acc.ts);
+	acc.cleanblock = cleanblock;
+
+	svc_xprt_foreach(svc_clean_idle2_func, (void *)&acc);
+
+	if (acc.least_active == NULL)
+		return (false);
+
+	SVC_DESTROY(acc.least_active);
+	return (true);
+}
+
 /* XXX move to svc_run */
 void authgss_ctx_gc_idle(void);
 
+/*
+ * Like __svc_clean_idle but event-type independent, and O(expired):
+ * connections are armed on svc_idle_wheel with __svc_params->idle_timeout
+ * when accepted, GSS contexts with their lifetime when cached.  So the
+ * timeout argument is not used, beyond selecting this path.
+ */
 bool
 __svc_clean_idle2(int timeout, bool cleanblock)
 {
-	struct svc_clean_idle_arg acc;
 	static mutex_t active_mtx = MUTEX_INITIALIZER;
 	static uint32_t active;
+	uint32_t cleaned;
 	bool_t rslt = FALSE;
 
 	if (mutex_trylock(&active_mtx) != 0)
@@ -1103,19 +2037,11 @@ __svc_clean_idle2(int timeout, bool cleanblock)
 	/* trim gss context cache */
 	authgss_ctx_gc_idle();
 
-	/* trim xprts (not sorted, not aggressive [but self limiting]) */
-	memset(&acc, 0, sizeof(struct svc_clean_idle_arg));
-	(void)clock_gettime(CLOCK_MONOTONIC_FAST, &acc.ts);
-	acc.cleanblock = cleanblock;
-	acc.timeout = timeout;
-
-	svc_xprt_foreach(svc_clean_idle2_func, (void *)&acc);
-
-	if (timeout == 0 && acc.least_active != NULL) {
-		SVC_DESTROY(acc.least_active);
-		acc.ncleaned++;
-	}
-	rslt = (acc.ncleaned > 0) ? TRUE : FALSE;
+	/* expire idle xprts and gss contexts */
+	cleaned = atomic_fetch_uint32_t(&svc_vc_idle_cleaned);
+	(void)timer_wheel_expire(&svc_idle_wheel);
+	rslt = (atomic_fetch_uint32_t(&svc_vc_idle_cleaned) != cleaned)
+		? TRUE : FALSE;
 	--active;
 
  unlock:
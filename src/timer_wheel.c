@@ -0,0 +1,243 @@
+/*
+ * Copyright (c) 2026 The libntirpc contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR `AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file timer_wheel.c
+ * @brief Hierarchical timer wheel
+ *
+ * @section DESCRIPTION
+ *
+ * TIMER_WHEEL_LEVELS wheels of TIMER_WHEEL_SLOTS slots each.  Level 0
+ * holds entries due in the next TIMER_WHEEL_SLOTS ticks, one slot per
+ * tick; each higher level spans TIMER_WHEEL_SLOTS times the one below.
+ * When level 0 wraps, the next slot of level 1 is cascaded down, and so
+ * on up, so an entry is moved at most once per level.
+ */
+
+#include <config.h>
+
+#include <sys/types.h>
+#include <stdint.h>
+#include <time.h>
+#include <rpc/types.h>
+#include <reentrant.h>
+#include <intrinsic.h>
+#include <misc/portable.h>
+#include <misc/timer_wheel.h>
+
+#define TIMER_WHEEL_MASK (TIMER_WHEEL_SLOTS - 1)
+#define TIMER_WHEEL_MAX (1ULL << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS))
+
+/* the current tick, or (rounded up, never early) the one after delay */
+static inline uint64_t
+timer_wheel_tick(struct timer_wheel *wheel, uint64_t delay_ms)
+{
+	struct timespec ts;
+	uint64_t ms;
+
+	(void)clock_gettime(CLOCK_MONOTONIC_FAST, &ts);
+	ms = ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+	if (!delay_ms)
+		return (ms / wheel->tick_ms);
+	return ((ms + delay_ms + wheel->tick_ms - 1) / wheel->tick_ms);
+}
+
+/* wheel LOCKED */
+static inline void
+timer_wheel_cond_init(struct timer_wheel *wheel)
+{
+	int lvl, ix;
+
+	if (likely(wheel->initialized))
+		return;
+
+	for (lvl = 0; lvl < TIMER_WHEEL_LEVELS; lvl++)
+		for (ix = 0; ix < TIMER_WHEEL_SLOTS; ix++)
+			TAILQ_INIT(&wheel->slots[lvl][ix]);
+	TAILQ_INIT(&wheel->expired);
+	wheel->now = timer_wheel_tick(wheel, 0);
+	wheel->initialized = true;
+}
+
+/*
+ * Queue at the level spanning its distance from base, the next tick to
+ * expire.  wheel LOCKED.
+ */
+static void
+timer_wheel_place(struct timer_wheel *wheel, struct timer_wheel_entry *twe,
+		  uint64_t base)
+{
+	uint64_t delta;
+	int lvl;
+
+	if (twe->expires < base)
+		twe->expires = base;
+	delta = twe->expires - base;
+	if (delta >= TIMER_WHEEL_MAX) {
+		twe->expires = base + TIMER_WHEEL_MAX - 1;
+		delta = TIMER_WHEEL_MAX - 1;
+	}
+
+	for (lvl = 0; lvl < TIMER_WHEEL_LEVELS - 1; lvl++)
+		if (delta < (1ULL << (TIMER_WHEEL_BITS * (lvl + 1))))
+			break;
+
+	twe->head = &wheel->slots[lvl][(twe->expires
+					>> (TIMER_WHEEL_BITS * lvl))
+				       & TIMER_WHEEL_MASK];
+	TAILQ_INSERT_TAIL(twe->head, twe, q);
+}
+
+/* wheel LOCKED */
+static inline void
+timer_wheel_unqueue(struct timer_wheel *wheel, struct timer_wheel_entry *twe)
+{
+	TAILQ_REMOVE(twe->head, twe, q);
+	twe->head = NULL;
+	wheel->count--;
+}
+
+void
+timer_wheel_add(struct timer_wheel *wheel, struct timer_wheel_entry *twe,
+		uint64_t delay_ms)
+{
+	mutex_lock(&wheel->mtx);
+	timer_wheel_cond_init(wheel);
+
+	if (twe->head)
+		timer_wheel_unqueue(wheel, twe);
+	if (!wheel->count && !wheel->expiring) {
+		/* idle, catch up without walking the ticks */
+		wheel->now = timer_wheel_tick(wheel, 0);
+	}
+
+	twe->expires = timer_wheel_tick(wheel, delay_ms);
+	timer_wheel_place(wheel, twe, wheel->now + 1);
+	wheel->count++;
+	mutex_unlock(&wheel->mtx);
+}
+
+bool
+timer_wheel_del(struct timer_wheel *wheel, struct timer_wheel_entry *twe)
+{
+	bool queued = false;
+
+	mutex_lock(&wheel->mtx);
+	for (;;) {
+		if (twe->head) {
+			timer_wheel_unqueue(wheel, twe);
+			queued = true;
+		}
+		if (wheel->running != twe
+		 || pthread_equal(wheel->running_thr, pthread_self()))
+			break;
+		/* its callback may re-add it */
+		cond_wait(&wheel->cv, &wheel->mtx);
+	}
+	mutex_unlock(&wheel->mtx);
+
+	return (queued);
+}
+
+/* move a slot of a higher level down for tick.  wheel LOCKED */
+static void
+timer_wheel_cascade(struct timer_wheel *wheel, uint64_t tick)
+{
+	struct timer_wheel_head *head;
+	struct timer_wheel_entry *twe;
+	int lvl;
+
+	for (lvl = 1; lvl < TIMER_WHEEL_LEVELS; lvl++) {
+		/* lower level did not wrap */
+		if ((tick >> (TIMER_WHEEL_BITS * (lvl - 1))) & TIMER_WHEEL_MASK)
+			break;
+
+		head = &wheel->slots[lvl][(tick >> (TIMER_WHEEL_BITS * lvl))
+					  & TIMER_WHEEL_MASK];
+		while ((twe = TAILQ_FIRST(head))) {
+			TAILQ_REMOVE(head, twe, q);
+			timer_wheel_place(wheel, twe, tick);
+		}
+	}
+}
+
+uint32_t
+timer_wheel_expire(struct timer_wheel *wheel)
+{
+	struct timer_wheel_head *head;
+	struct timer_wheel_entry *twe;
+	uint64_t target;
+	uint32_t due = 0;
+	uint32_t n = 0;
+
+	mutex_lock(&wheel->mtx);
+	timer_wheel_cond_init(wheel);
+
+	if (wheel->expiring) {
+		/* another thread is on it */
+		mutex_unlock(&wheel->mtx);
+		return (0);
+	}
+	wheel->expiring = true;
+
+	target = timer_wheel_tick(wheel, 0);
+	while (wheel->now < target) {
+		if (wheel->count == due) {
+			/* nothing left on the wheel */
+			wheel->now = target;
+			break;
+		}
+		wheel->now++;
+		timer_wheel_cascade(wheel, wheel->now);
+
+		head = &wheel->slots[0][wheel->now & TIMER_WHEEL_MASK];
+		while ((twe = TAILQ_FIRST(head))) {
+			TAILQ_REMOVE(head, twe, q);
+			TAILQ_INSERT_TAIL(&wheel->expired, twe, q);
+			twe->head = &wheel->expired;
+			due++;
+		}
+	}
+
+	/* still queued (on expired) until called, so may be deleted */
+	while ((twe = TAILQ_FIRST(&wheel->expired))) {
+		timer_wheel_unqueue(wheel, twe);
+		wheel->running = twe;
+		wheel->running_thr = pthread_self();
+		mutex_unlock(&wheel->mtx);
+
+		twe->fun(twe);
+		n++;
+
+		mutex_lock(&wheel->mtx);
+		wheel->running = NULL;
+		cond_broadcast(&wheel->cv);
+	}
+
+	wheel->expiring = false;
+	mutex_unlock(&wheel->mtx);
+
+	return (n);
+}
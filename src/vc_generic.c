@@ -32,12 +32,14 @@
 #include <assert.h>
 #include <err.h>
 #include <errno.h>
+#include <string.h>
 #include <rpc/types.h>
 #include <unistd.h>
 #include <signal.h>
 #include <misc/timespec.h>
 #include <rpc/types.h>
 #include <misc/portable.h>
+#include <intrinsic.h>
 #include <rpc/xdr.h>
 #include <rpc/rpc.h>
 #include <rpc/svc.h>
@@ -148,17 +150,20 @@ svc_read_vc(XDR *xdrs, void *ctp, void *buf, int len)
 	struct pollfd pollfd;
 
 	if (xd->shared.nonblock) {
-		len = read(xprt->xp_fd, buf, (size_t) len);
-		if (len < 0) {
-			if (errno == EAGAIN)
-				len = 0;
-			else
-				goto fatal_err;
+		/* SVC_XPRT_FLAG_EDGE, already read by svc_vc_recv() */
+		struct svc_vc_ring *ring = &xd->shared.ring;
+
+		len = MIN((u_int)len, ring->ready - ring->head);
+		if (unlikely(!len)) {
+			/* never past the records scanned */
+			__warnx(TIRPC_DEBUG_FLAG_SVC_VC,
+				"%s: read past record (will set dead)",
+				__func__);
+			goto fatal_err;
 		}
-		if (len != 0)
-			(void)clock_gettime(CLOCK_MONOTONIC_FAST,
-					    &xd->sx.last_recv);
-		return len;
+		memcpy(buf, ring->base + ring->head, len);
+		ring->head += len;
+		return (len);
 	}
 
 	do {
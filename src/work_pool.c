@@ -32,6 +32,44 @@
  *
  * This provides simple work queues using pthreads and TAILQ primitives.
  *
+ * With WORK_POOL_FLAG_STEAL, each worker has its own (lane) queue.  Workers
+ * submit to their own lane, other threads to a lane chosen once per thread.
+ * Idle workers steal from the other lanes before waiting on the pool.
+ *
+ * With WORK_POOL_FLAG_RING, the pool (or each lane) queue has a bounded
+ * lock-free ring.  Tasks are only queued under the mutex when the ring is
+ * full, and workers only take it to wait when the ring is empty.
+ *
+ * With params.spin_max_ns, a worker that runs out of tasks spins for a
+ * while before parking on its condition, so that tasks arriving close
+ * together are handed over without a futex wake and context switch.
+ * The spin is twice the average time between submits, bounded by
+ * spin_max_ns, and skipped entirely when tasks arrive further apart.
+ * The bound doubles on each hit and halves on each miss, so a pool that
+ * keeps missing only probes now and then.  Spinners are queued first,
+ * so they are handed the next task.  There is no spinning on a single
+ * cpu, where it would only delay the submitter.
+ *
+ * With WORK_POOL_FLAG_PRIO, tasks are queued by work_pool_entry prio, and
+ * workers take them round robin, each class up to its prio_weight tasks
+ * per round, high first.  So high priority tasks overtake a backlog of
+ * normal and bulk ones, without starving them.  It uses the shared queue
+ * only, overriding WORK_POOL_FLAG_STEAL and WORK_POOL_FLAG_RING.
+ *
+ * Without WORK_POOL_FLAG_ELASTIC, a worker about to run a task spawns
+ * another when fewer than thrd_min are waiting, and waiting workers above
+ * thrd_min exit after idle_max_ms.  With it, the queue delay of each task
+ * is measured, and the pool grows while the average is above delay_max_us
+ * (or spare workers are short), but by at most one thread per 10 ms.  It
+ * shrinks after idle_min_ms only when the average is below a quarter of
+ * that, and spares are left; otherwise after idle_max_ms.
+ *
+ * With WORK_POOL_FLAG_NUMA, the pool is split into one (part) pool per
+ * NUMA node, each with its share of thrd_max, and workers pinned to the
+ * cpus of that node.  Tasks go to the submitter's node (or the one given
+ * to work_pool_submit_node()), and only spill to another node with an
+ * idle worker when the local one cannot take more.
+ *
  * @note    Loosely based upon previous thrdpool by
  *          Matt Benjamin <matt@cohortfs.com>
  */
@@ -53,19 +91,49 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <unistd.h>
 #include <intrinsic.h>
+#if defined(__linux__)
+#include <sched.h>
+#include <stdio.h>
+#endif
 
 #include <rpc/work_pool.h>
 
 #define WORK_POOL_STACK_SIZE MAX(64 * 1024, PTHREAD_STACK_MIN)
 #define WORK_POOL_TIMEOUT_MS (120000)
+#define WORK_POOL_DELAY_MAX_US (1000)
+#define WORK_POOL_SPAWN_GAP_MS (10)
+#define WORK_POOL_LANES_MAX (64)
+#define WORK_POOL_RING_SLOTS (1024)
+#define WORK_POOL_SPIN_MIN_NS (1000)
+#define WORK_POOL_SPINNERS_MAX (2)
+#define WORK_POOL_SPIN_PROBE (64)
+#define WORK_POOL_SYSFS_NODE "/sys/devices/system/node"
 
 /* forward declaration in lieu of moving code, was inline */
 
 static int work_pool_spawn(struct work_pool *pool);
 
-int
-work_pool_init(struct work_pool *pool, const char *name,
+/* WORK_POOL_FLAG_PRIO default tasks per round, and dequeue order */
+static const uint32_t work_pool_prio_weight[WORK_POOL_PRIO_MAX] = {
+	[WORK_POOL_PRIO_NORMAL] = 4,
+	[WORK_POOL_PRIO_HIGH] = 16,
+	[WORK_POOL_PRIO_BULK] = 1,
+};
+static const uint32_t work_pool_prio_order[WORK_POOL_PRIO_MAX] = {
+	WORK_POOL_PRIO_HIGH,
+	WORK_POOL_PRIO_NORMAL,
+	WORK_POOL_PRIO_BULK,
+};
+
+/* WORK_POOL_FLAG_STEAL lane selection */
+static __thread struct work_pool_thread *work_pool_self;
+static __thread uint32_t work_pool_hint;
+static uint32_t work_pool_hints;
+
+static int
+work_pool_setup(struct work_pool *pool, const char *name,
 		struct work_pool_params *params)
 {
 	int rc;
@@ -90,6 +158,20 @@ work_pool_init(struct work_pool *pool, const char *name,
 		pool->params.thrd_min = 1;
 	};
 
+	if (pool->params.spin_max_ns && sysconf(_SC_NPROCESSORS_ONLN) < 2) {
+		/* nobody else to submit while spinning */
+		pool->params.spin_max_ns = 0;
+	}
+	pool->spin_cap_ns = pool->params.spin_max_ns;
+
+	if (!pool->params.idle_max_ms)
+		pool->params.idle_max_ms = WORK_POOL_TIMEOUT_MS;
+	if (!pool->params.idle_min_ms
+	 || pool->params.idle_min_ms > pool->params.idle_max_ms)
+		pool->params.idle_min_ms = pool->params.idle_max_ms;
+	if (!pool->params.delay_max_us)
+		pool->params.delay_max_us = WORK_POOL_DELAY_MAX_US;
+
 	rc = pthread_attr_init(&pool->attr);
 	if (rc) {
 		__warnx(TIRPC_DEBUG_FLAG_ERROR,
@@ -121,32 +203,519 @@ work_pool_init(struct work_pool *pool, const char *name,
 			__func__, strerror(rc), rc);
 	}
 
+	return (0);
+}
+
+static int
+work_pool_start(struct work_pool *pool)
+{
+	if (pool->params.flags & WORK_POOL_FLAG_PRIO) {
+		uint32_t ix;
+
+		if (pool->params.flags
+		    & (WORK_POOL_FLAG_STEAL | WORK_POOL_FLAG_RING)) {
+			__warnx(TIRPC_DEBUG_FLAG_ERROR,
+				"%s() %s prio uses the shared queue only",
+				__func__, pool->name);
+			pool->params.flags &= ~(WORK_POOL_FLAG_STEAL
+						| WORK_POOL_FLAG_RING);
+		}
+		for (ix = 0; ix < WORK_POOL_PRIO_MAX; ix++) {
+			TAILQ_INIT(&pool->prio_qh[ix]);
+			if (!pool->params.prio_weight[ix])
+				pool->params.prio_weight[ix] =
+					work_pool_prio_weight[ix];
+			pool->prio_credit[ix] = pool->params.prio_weight[ix];
+		}
+	}
+
+	if (pool->params.flags & WORK_POOL_FLAG_STEAL) {
+		uint32_t ix;
+
+		pool->n_lanes = MIN(pool->params.thrd_max, WORK_POOL_LANES_MAX);
+		pool->lanes = mem_calloc(pool->n_lanes,
+					 sizeof(struct work_pool_lane));
+		for (ix = 0; ix < pool->n_lanes; ix++) {
+			poolq_head_setup(&pool->lanes[ix].pqh);
+			if (pool->params.flags & WORK_POOL_FLAG_RING)
+				poolq_ring_setup(&pool->lanes[ix].pqh,
+						 WORK_POOL_RING_SLOTS);
+		}
+	} else if (pool->params.flags & WORK_POOL_FLAG_RING) {
+		poolq_ring_setup(&pool->pqh, WORK_POOL_RING_SLOTS);
+	}
+
 	/* initial spawn will spawn more threads as needed */
 	return work_pool_spawn(pool);
 }
 
+#if defined(__linux__)
+/**
+ * @brief Read a sysfs list, such as "0-3,8-11"
+ *
+ * @param[in] path	sysfs file
+ * @param[out] set	the listed numbers
+ *
+ * @return 0 on success, otherwise errno.
+ */
+static int
+work_pool_sysfs_list(const char *path, cpu_set_t *set)
+{
+	char buf[4096];
+	char *p = buf;
+	char *end;
+	FILE *fp;
+	long lo, hi;
+
+	CPU_ZERO(set);
+
+	fp = fopen(path, "r");
+	if (!fp)
+		return (errno);
+	if (!fgets(buf, sizeof(buf), fp)) {
+		fclose(fp);
+		return (EINVAL);
+	}
+	fclose(fp);
+
+	while (*p && *p != '\n') {
+		lo = hi = strtol(p, &end, 10);
+		if (end == p)
+			return (EINVAL);
+		if (*end == '-') {
+			p = end + 1;
+			hi = strtol(p, &end, 10);
+			if (end == p)
+				return (EINVAL);
+		}
+		for (; lo <= hi && lo < CPU_SETSIZE; lo++)
+			CPU_SET(lo, set);
+		p = end;
+		if (*p == ',')
+			p++;
+	}
+	return (0);
+}
+
+/* stop and free the parts, if any, including one partly setup */
+static void
+work_pool_shutdown_parts(struct work_pool *pool)
+{
+	uint32_t ix;
+
+	if (!pool->parts)
+		return;
+
+	for (ix = 0; ix < pool->n_parts; ix++) {
+		if (pool->parts[ix].name)
+			work_pool_shutdown(&pool->parts[ix]);
+	}
+	mem_free(pool->parts, pool->n_parts * sizeof(struct work_pool));
+	mem_free(pool->cpu_node, CPU_SETSIZE * sizeof(int16_t));
+	mem_free(pool->node_part, CPU_SETSIZE * sizeof(int16_t));
+	pool->parts = NULL;
+	pool->cpu_node = NULL;
+	pool->node_part = NULL;
+	pool->n_parts = 0;
+}
+
+/**
+ * @brief Split the pool by NUMA node (WORK_POOL_FLAG_NUMA)
+ *
+ * @param[in] pool	the work pool, already setup
+ *
+ * @return 0 on success, ENOENT for a single node, otherwise error.
+ */
+static int
+work_pool_setup_numa(struct work_pool *pool)
+{
+	struct work_pool_params params = pool->params;
+	cpu_set_t nodes;
+	cpu_set_t cpus;
+	char buf[PATH_MAX];
+	struct work_pool *part;
+	int node;
+	int cpu;
+	int rc;
+	uint32_t ix = 0;
+
+	rc = work_pool_sysfs_list(WORK_POOL_SYSFS_NODE "/online", &nodes);
+	if (rc || CPU_COUNT(&nodes) < 2)
+		return (ENOENT);
+
+	pool->n_parts = CPU_COUNT(&nodes);
+	pool->parts = mem_calloc(pool->n_parts, sizeof(struct work_pool));
+	pool->cpu_node = mem_calloc(CPU_SETSIZE, sizeof(int16_t));
+	pool->node_part = mem_calloc(CPU_SETSIZE, sizeof(int16_t));
+
+	/* round up, each node gets at least one worker */
+	params.flags &= ~WORK_POOL_FLAG_NUMA;
+	params.thrd_max = (params.thrd_max + pool->n_parts - 1)
+			/ pool->n_parts;
+	params.thrd_min = (params.thrd_min + pool->n_parts - 1)
+			/ pool->n_parts;
+
+	for (node = 0; node < CPU_SETSIZE && ix < pool->n_parts; node++) {
+		if (!CPU_ISSET(node, &nodes))
+			continue;
+
+		snprintf(buf, sizeof(buf), WORK_POOL_SYSFS_NODE
+			 "/node%d/cpulist", node);
+		rc = work_pool_sysfs_list(buf, &cpus);
+		if (rc) {
+			__warnx(TIRPC_DEBUG_FLAG_ERROR,
+				"%s() can't read %s: %s (%d)",
+				__func__, buf, strerror(rc), rc);
+			goto out;
+		}
+		pool->node_part[node] = ix;
+		for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+			if (CPU_ISSET(cpu, &cpus))
+				pool->cpu_node[cpu] = ix;
+		}
+
+		part = &pool->parts[ix++];
+		snprintf(buf, sizeof(buf), "%s.%d", pool->name, node);
+		rc = work_pool_setup(part, buf, &params);
+		if (rc)
+			goto out;
+
+		rc = pthread_attr_setaffinity_np(&part->attr, sizeof(cpus),
+						 &cpus);
+		if (rc) {
+			__warnx(TIRPC_DEBUG_FLAG_ERROR,
+				"%s() can't set pthread's affinity: %s (%d)",
+				__func__, strerror(rc), rc);
+		}
+
+		rc = work_pool_start(part);
+		if (rc)
+			goto out;
+	}
+
+	return (0);
+
+out:
+	work_pool_shutdown_parts(pool);
+	/* not a single node, the caller must not start the pool */
+	return (rc == ENOENT ? EINVAL : rc);
+}
+
+/* the parts index of the calling thread's node */
+static inline uint32_t
+work_pool_node(struct work_pool *pool)
+{
+	int cpu = sched_getcpu();
+
+	if (unlikely(cpu < 0 || cpu >= CPU_SETSIZE))
+		return (0);
+	return (pool->cpu_node[cpu]);
+}
+#endif /* __linux__ */
+
+int
+work_pool_init(struct work_pool *pool, const char *name,
+		struct work_pool_params *params)
+{
+	int rc = work_pool_setup(pool, name, params);
+
+	if (rc)
+		return (rc);
+
+	if (pool->params.flags & WORK_POOL_FLAG_NUMA) {
+#if defined(__linux__)
+		rc = work_pool_setup_numa(pool);
+		if (rc != ENOENT)
+			return (rc);
+#endif
+		/* single node, an ordinary pool */
+		pool->params.flags &= ~WORK_POOL_FLAG_NUMA;
+	}
+
+	return work_pool_start(pool);
+}
+
+static inline uint64_t
+work_pool_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec);
+}
+
+/* how long to wait for a task, before considering exit */
+static inline uint32_t
+work_pool_idle_ms(struct work_pool *pool)
+{
+	return ((pool->params.flags & WORK_POOL_FLAG_ELASTIC)
+		? pool->params.idle_min_ms
+		: pool->params.idle_max_ms);
+}
+
+/* ELASTIC: [0] < 1 us, [n] < 2^n us */
+static inline uint32_t
+work_pool_delay_bucket(uint64_t delay_ns)
+{
+	uint64_t us = delay_ns / 1000;
+	uint32_t n;
+
+	if (!us)
+		return (0);
+	n = 64 - __builtin_clzll(us);
+	return (MIN(n, WORK_POOL_DELAY_BUCKETS - 1));
+}
+
+/* workers waiting for tasks */
+static inline int32_t
+work_pool_spare(struct work_pool *pool)
+{
+	if (pool->lanes)
+		return ((int32_t)atomic_fetch_uint32_t(&pool->n_idle));
+	return (-atomic_fetch_int32_t(&pool->pqh.qcount));
+}
+
+/**
+ * @brief Before running a task, maybe add a worker
+ *
+ * With WORK_POOL_FLAG_ELASTIC, also accounts the task's queue delay.
+ *
+ * @param[in] pool	the work pool
+ * @param[in] wpt	the calling worker, with its task
+ */
+static inline void
+work_pool_grow(struct work_pool *pool, struct work_pool_thread *wpt)
+{
+	uint64_t now;
+	uint64_t delay;
+	uint64_t avg;
+	uint32_t last;
+	uint32_t ms;
+
+	if (!(pool->params.flags & WORK_POOL_FLAG_ELASTIC)) {
+		/* n_threads lags pthread_create(), so count the spawns */
+		if (work_pool_spare(pool) < pool->params.thrd_min
+		 && atomic_fetch_uint64_t(&pool->stats.spawned)
+		    - atomic_fetch_uint64_t(&pool->stats.exited)
+		    < pool->params.thrd_max) {
+			/* busy, so dynamically add another thread */
+			(void)work_pool_spawn(pool);
+		}
+		return;
+	}
+
+	wpt->idle_since = 0;
+	now = work_pool_ns();
+	delay = (now > wpt->work->enqueued) ? now - wpt->work->enqueued : 0;
+	atomic_inc_uint64_t(&pool->stats.delay[work_pool_delay_bucket(delay)]);
+
+	/* 1/8 weight for the newest, racing workers only lose a sample */
+	avg = atomic_fetch_uint64_t(&pool->delay_ns);
+	avg = avg - (avg >> 3) + (delay >> 3);
+	atomic_store_uint64_t(&pool->delay_ns, avg);
+
+	/* n_threads lags pthread_create(), so count the spawns instead */
+	if (atomic_fetch_uint64_t(&pool->stats.spawned)
+	    - atomic_fetch_uint64_t(&pool->stats.exited)
+	    >= pool->params.thrd_max)
+		return;
+	if (avg < (uint64_t)pool->params.delay_max_us * 1000
+	 && work_pool_spare(pool) >= pool->params.thrd_min)
+		return;
+
+	/* one spawn per gap, however many workers see the need */
+	ms = (uint32_t)(now / 1000000);
+	last = atomic_fetch_uint32_t(&pool->spawn_last_ms);
+	if (ms - last < WORK_POOL_SPAWN_GAP_MS
+	 || !atomic_cas_uint32_t(&pool->spawn_last_ms, &last, ms))
+		return;
+
+	(void)work_pool_spawn(pool);
+}
+
+/**
+ * @brief After waiting without a task, keep the worker?
+ *
+ * @param[in] pool	the work pool
+ * @param[in] wpt	the calling worker
+ */
+static inline bool
+work_pool_keep(struct work_pool *pool, struct work_pool_thread *wpt)
+{
+	uint64_t now;
+	uint64_t avg;
+
+	/* no task for a timeout */
+	if (pool->params.idle)
+		pool->params.idle(pool);
+
+	if (unlikely(!pool->params.thrd_max))
+		return (false);
+	if (pool->n_threads <= pool->params.thrd_min)
+		return (true);
+	if (!(pool->params.flags & WORK_POOL_FLAG_ELASTIC))
+		return (false);
+
+	now = work_pool_ns();
+	if (!wpt->idle_since) {
+		/* first timeout since the last task */
+		wpt->idle_since = now
+				- (uint64_t)pool->params.idle_min_ms * 1000000;
+	}
+	if (now - wpt->idle_since
+	    >= (uint64_t)pool->params.idle_max_ms * 1000000)
+		return (false);
+
+	/* no task in idle_min_ms is a zero delay sample, so the average
+	 * settles after a burst
+	 */
+	avg = atomic_fetch_uint64_t(&pool->delay_ns) >> 1;
+	atomic_store_uint64_t(&pool->delay_ns, avg);
+
+	/* hysteresis: only shrink well below the grow threshold */
+	return (avg >= (uint64_t)pool->params.delay_max_us * 250
+		|| work_pool_spare(pool) < pool->params.thrd_min);
+}
+
+/* params.spin_max_ns: keep an average of the time between submits.
+ * Unlocked, racing submitters only lose a sample.
+ */
+static inline void
+work_pool_arrival(struct work_pool *pool)
+{
+	uint64_t now = work_pool_ns();
+	uint64_t last = atomic_fetch_uint64_t(&pool->arrival_last);
+	uint64_t avg;
+
+	atomic_store_uint64_t(&pool->arrival_last, now);
+	if (unlikely(!last || now < last))
+		return;
+
+	/* 1/8 weight for the newest */
+	avg = atomic_fetch_uint64_t(&pool->arrival_ns);
+	atomic_store_uint64_t(&pool->arrival_ns,
+			      avg - (avg >> 3) + ((now - last) >> 3));
+}
+
+/**
+ * @brief Queue a waiting worker
+ *
+ * Spinning workers go first, so that they are handed the next task.
+ * Called with the pool _head mutex held.
+ *
+ * @param[in] pool	the work pool
+ * @param[in] wpt	the calling worker
+ *
+ * @return the spin budget (ns), 0 to park at once.
+ */
+static inline uint64_t
+work_pool_waiter(struct work_pool *pool, struct work_pool_thread *wpt)
+{
+	uint64_t avg;
+	uint32_t cap;
+
+	wpt->pqe.qflags |= WORK_POOL_THREAD_WAITING;
+
+	if (pool->params.spin_max_ns
+	 && pool->n_spinning < WORK_POOL_SPINNERS_MAX) {
+		avg = atomic_fetch_uint64_t(&pool->arrival_ns);
+		cap = pool->spin_cap_ns;
+
+		if (cap < WORK_POOL_SPIN_MIN_NS
+		 && !(++(pool->n_parked) % WORK_POOL_SPIN_PROBE))
+			cap = WORK_POOL_SPIN_MIN_NS;
+
+		/* arriving further apart than the spin, park at once */
+		if (cap >= WORK_POOL_SPIN_MIN_NS && avg <= cap) {
+			pool->n_spinning++;
+			TAILQ_INSERT_HEAD(&pool->pqh.qh, &wpt->pqe, q);
+			return (MIN(MAX(2 * avg, WORK_POOL_SPIN_MIN_NS), cap));
+		}
+	}
+
+	TAILQ_INSERT_TAIL(&pool->pqh.qh, &wpt->pqe, q);
+	return (0);
+}
+
+/**
+ * @brief Spin waiting for a hand off
+ *
+ * Called with the pool _head mutex held, which is released while
+ * spinning.
+ *
+ * @param[in] pool	the work pool
+ * @param[in] wpt	the calling worker, queued by work_pool_waiter()
+ * @param[in] budget	ns to spin
+ *
+ * @return true when handed off (wpt->work may have been set).
+ */
+static inline bool
+work_pool_spin(struct work_pool *pool, struct work_pool_thread *wpt,
+	       uint64_t budget)
+{
+	uint64_t start;
+	uint32_t n = 0;
+	bool hit;
+
+	pthread_mutex_unlock(&pool->pqh.qmutex);
+
+	start = work_pool_ns();
+	while (atomic_fetch_uint32_t(&wpt->pqe.qflags)
+	       & WORK_POOL_THREAD_WAITING) {
+		cpu_relax();
+		/* check the clock now and then */
+		if (!(++n & 0x3f) && work_pool_ns() - start >= budget)
+			break;
+	}
+
+	pthread_mutex_lock(&pool->pqh.qmutex);
+	pool->n_spinning--;
+
+	hit = !(wpt->pqe.qflags & WORK_POOL_THREAD_WAITING);
+	if (hit) {
+		atomic_inc_uint64_t(&pool->stats.spin_hits);
+		pool->spin_cap_ns = MIN(MAX(pool->spin_cap_ns,
+					    WORK_POOL_SPIN_MIN_NS) * 2,
+					pool->params.spin_max_ns);
+	} else {
+		atomic_inc_uint64_t(&pool->stats.spin_misses);
+		pool->spin_cap_ns /= 2;
+	}
+	return (hit);
+}
+
 static inline int
-work_pool_wait(struct work_pool *pool, struct work_pool_thread *wpt)
+work_pool_wait(struct work_pool *pool, struct work_pool_thread *wpt,
+	       uint64_t budget)
 {
 	struct timespec ts;
-	int rc;
+	int rc = 0;
+
+	if (budget && work_pool_spin(pool, wpt, budget))
+		return (0);
 
 	clock_gettime(CLOCK_REALTIME_FAST, &ts);
-	timespec_addms(&ts, WORK_POOL_TIMEOUT_MS);
+	timespec_addms(&ts, work_pool_idle_ms(pool));
 
 	/* Note: the mutex is the pool _head,
 	 * but the condition is per worker,
 	 * making the signal efficient!
 	 */
-	rc = pthread_cond_timedwait(&wpt->pqcond, &pool->pqh.qmutex, &ts);
+	while (wpt->pqe.qflags & WORK_POOL_THREAD_WAITING) {
+		rc = pthread_cond_timedwait(&wpt->pqcond, &pool->pqh.qmutex,
+					    &ts);
+		if (rc)
+			break;
+	}
 	if (rc) {
-		if (!wpt->work) {
+		if (wpt->pqe.qflags & WORK_POOL_THREAD_WAITING) {
 			/* Allow for possible timing race: work entry can be
 			 * set by another thread with the timeout result?
 			 * Then, has already been removed there.
-			 * Only remove with no work here.
+			 * Only remove when still waiting here.
 			 */
 			TAILQ_REMOVE(&pool->pqh.qh, &wpt->pqe, q);
+			wpt->pqe.qflags &= ~WORK_POOL_THREAD_WAITING;
 			++(pool->pqh.qcount);
 		}
 		if (rc != ETIMEDOUT) {
@@ -160,6 +729,247 @@ work_pool_wait(struct work_pool *pool, struct work_pool_thread *wpt)
 	return (0);
 }
 
+/**
+ * @brief Take a task from the lanes (WORK_POOL_FLAG_STEAL)
+ *
+ * Tries the worker's own lane first, then steals from the others in turn.
+ *
+ * @param[in] pool	the work pool
+ * @param[in] wpt	the calling worker
+ *
+ * @return the task, or NULL when all lanes are empty.
+ */
+static inline struct work_pool_entry *
+work_pool_steal(struct work_pool *pool, struct work_pool_thread *wpt)
+{
+	struct poolq_head *lane;
+	struct poolq_entry *have;
+	uint32_t ix = wpt->worker_index;
+	uint32_t n;
+
+	for (n = 0; n < pool->n_lanes; n++, ix++) {
+		lane = &pool->lanes[ix % pool->n_lanes].pqh;
+
+		if (lane->qring) {
+			have = poolq_ring_pop(lane->qring);
+			if (have) {
+				atomic_dec_uint32_t(&pool->n_pending);
+				return ((struct work_pool_entry *)have);
+			}
+		}
+
+		/* unlocked peek, checked again under the lane mutex */
+		if (atomic_fetch_int32_t(&lane->qcount) <= 0)
+			continue;
+
+		pthread_mutex_lock(&lane->qmutex);
+		have = TAILQ_FIRST(&lane->qh);
+		if (have) {
+			TAILQ_REMOVE(&lane->qh, have, q);
+			(lane->qcount)--;
+		}
+		pthread_mutex_unlock(&lane->qmutex);
+
+		if (have) {
+			atomic_dec_uint32_t(&pool->n_pending);
+			return ((struct work_pool_entry *)have);
+		}
+	}
+
+	return (NULL);
+}
+
+/*
+ * Hand off to the first waiting worker (WORK_POOL_FLAG_STEAL).
+ * work may be NULL, then the worker looks at the lanes itself.
+ *
+ * Called with the pool _head mutex held.
+ */
+static inline void
+work_pool_wake(struct work_pool *pool, struct work_pool_entry *work)
+{
+	struct work_pool_thread *wpt = (struct work_pool_thread *)
+		TAILQ_FIRST(&pool->pqh.qh);
+
+	TAILQ_REMOVE(&pool->pqh.qh, &wpt->pqe, q);
+	(pool->pqh.qcount)++;
+	atomic_dec_uint32_t(&pool->n_idle);
+
+	/* work before the flag, for work_pool_spin() */
+	wpt->work = work;
+	atomic_clear_uint32_t_bits(&wpt->pqe.qflags,
+				   WORK_POOL_THREAD_WAITING);
+	pthread_cond_signal(&wpt->pqcond);
+}
+
+/**
+ * @brief Wait for work (WORK_POOL_FLAG_STEAL)
+ *
+ * @param[in] pool	the work pool
+ * @param[in] wpt	the calling worker
+ *
+ * @return 0 when woken (wpt->work may have been set), ETIMEDOUT,
+ *	   or another error.
+ */
+static inline int
+work_pool_park(struct work_pool *pool, struct work_pool_thread *wpt)
+{
+	struct timespec ts;
+	uint64_t budget;
+	int rc = 0;
+
+	pthread_mutex_lock(&pool->pqh.qmutex);
+	atomic_inc_uint32_t(&pool->n_idle);
+
+	/* Pairs with work_pool_submit_steal(): either the submitter sees
+	 * this worker idle, or this worker sees the task it queued.
+	 */
+	if (atomic_fetch_uint32_t(&pool->n_pending)
+	 || !pool->params.thrd_max) {
+		atomic_dec_uint32_t(&pool->n_idle);
+		pthread_mutex_unlock(&pool->pqh.qmutex);
+		return (0);
+	}
+
+	budget = work_pool_waiter(pool, wpt);
+	(pool->pqh.qcount)--;
+
+	__warnx(TIRPC_DEBUG_FLAG_EVENT,
+		"%s() %s waiting for task",
+		__func__, pool->name);
+
+	if (budget && work_pool_spin(pool, wpt, budget)) {
+		pthread_mutex_unlock(&pool->pqh.qmutex);
+		return (0);
+	}
+
+	clock_gettime(CLOCK_REALTIME_FAST, &ts);
+	timespec_addms(&ts, work_pool_idle_ms(pool));
+
+	while (wpt->pqe.qflags & WORK_POOL_THREAD_WAITING) {
+		rc = pthread_cond_timedwait(&wpt->pqcond, &pool->pqh.qmutex,
+					    &ts);
+		if (rc)
+			break;
+	}
+
+	if (wpt->pqe.qflags & WORK_POOL_THREAD_WAITING) {
+		/* nobody removed us */
+		TAILQ_REMOVE(&pool->pqh.qh, &wpt->pqe, q);
+		wpt->pqe.qflags &= ~WORK_POOL_THREAD_WAITING;
+		(pool->pqh.qcount)++;
+		atomic_dec_uint32_t(&pool->n_idle);
+	} else {
+		/* woken, ignore any timeout racing with it */
+		rc = 0;
+	}
+	pthread_mutex_unlock(&pool->pqh.qmutex);
+
+	if (rc && rc != ETIMEDOUT) {
+		__warnx(TIRPC_DEBUG_FLAG_ERROR,
+			"%s() cond_timedwait failed (%d)\n",
+			__func__, rc);
+	}
+	return (rc);
+}
+
+/**
+ * @brief The worker thread loop (WORK_POOL_FLAG_STEAL)
+ *
+ * @param[in] pool	the work pool
+ * @param[in] wpt	the calling worker
+ */
+static void
+work_pool_thread_steal(struct work_pool *pool, struct work_pool_thread *wpt)
+{
+	int rc;
+
+	for (;;) {
+		if (wpt->work) {
+			work_pool_grow(pool, wpt);
+
+			__warnx(TIRPC_DEBUG_FLAG_EVENT,
+				"%s() %s task %p",
+				__func__, pool->name, wpt->work);
+			wpt->work->fun(wpt->work);
+			wpt->work = NULL;
+		}
+
+		wpt->work = work_pool_steal(pool, wpt);
+		if (wpt->work)
+			continue;
+
+		if (unlikely(!pool->params.thrd_max)) {
+			/* queue is drained */
+			break;
+		}
+
+		rc = work_pool_park(pool, wpt);
+		if (wpt->work || !rc)
+			continue;
+		if (rc != ETIMEDOUT)
+			break;
+		if (!work_pool_keep(pool, wpt))
+			break;
+	}
+}
+
+/**
+ * @brief Take the next task by priority (WORK_POOL_FLAG_PRIO)
+ *
+ * Weighted round robin: the highest class with both tasks and credit
+ * left in this round goes first.  When none has, a new round starts.
+ *
+ * Called with the pool _head mutex held, and tasks queued.
+ *
+ * @param[in] pool	the work pool
+ *
+ * @return the task.
+ */
+static inline struct poolq_entry *
+work_pool_prio_dequeue(struct work_pool *pool)
+{
+	struct poolq_entry *have;
+	uint32_t prio;
+	uint32_t ix;
+	int round;
+
+	for (round = 0; round < 2; round++) {
+		for (ix = 0; ix < WORK_POOL_PRIO_MAX; ix++) {
+			prio = work_pool_prio_order[ix];
+			if (!pool->prio_credit[prio])
+				continue;
+			have = TAILQ_FIRST(&pool->prio_qh[prio]);
+			if (!have)
+				continue;
+
+			TAILQ_REMOVE(&pool->prio_qh[prio], have, q);
+			pool->prio_credit[prio]--;
+			return (have);
+		}
+
+		for (ix = 0; ix < WORK_POOL_PRIO_MAX; ix++)
+			pool->prio_credit[ix] = pool->params.prio_weight[ix];
+	}
+
+	/* not reached, weights are not zero */
+	abort();
+}
+
+/* WORK_POOL_FLAG_PRIO: queue by class.
+ * Called with the pool _head mutex held.
+ */
+static inline void
+work_pool_prio_enqueue(struct work_pool *pool, struct work_pool_entry *work)
+{
+	uint32_t prio = work->prio;
+
+	if (unlikely(prio >= WORK_POOL_PRIO_MAX))
+		prio = WORK_POOL_PRIO_NORMAL;
+
+	TAILQ_INSERT_TAIL(&pool->prio_qh[prio], &work->pqe, q);
+}
+
 /**
  * @brief The worker thread
  *
@@ -178,18 +988,20 @@ work_pool_thread(void *arg)
 
 	atomic_inc_uint32_t(&pool->n_threads);
 	pthread_cond_init(&wpt->pqcond, NULL);
+	work_pool_self = wpt;
+
+	if (pool->lanes) {
+		work_pool_thread_steal(pool, wpt);
+		goto out;
+	}
 
 	do {
 		/* testing at top of loop allows pre-specification of work,
 		 * and thread termination after timeout with no work (below).
 		 */
 		if (wpt->work) {
-			if (pool->pqh.qcount > -pool->params.thrd_min
-			 && pool->n_threads < pool->params.thrd_max) {
-				/* busy, so dynamically add another thread */
-				(void)work_pool_spawn(pool);
-			}
-	
+			work_pool_grow(pool, wpt);
+
 			__warnx(TIRPC_DEBUG_FLAG_EVENT,
 				"%s() %s task %p",
 				__func__, pool->name, wpt->work);
@@ -197,26 +1009,43 @@ work_pool_thread(void *arg)
 			wpt->work = NULL;
 		}
 
+		if (pool->pqh.qring) {
+			wpt->work = (struct work_pool_entry *)
+				poolq_ring_pop(pool->pqh.qring);
+			if (wpt->work)
+				continue;
+		}
+
 		pthread_mutex_lock(&pool->pqh.qmutex);
 
-		if (0 < pool->pqh.qcount--) {
+		/* atomic, pairs with work_pool_submit() ring check */
+		if (0 < atomic_postdec_int32_t(&pool->pqh.qcount)) {
 			/* positive for task(s) */
-			have = TAILQ_FIRST(&pool->pqh.qh);
-			TAILQ_REMOVE(&pool->pqh.qh, have, q);
+			if (pool->params.flags & WORK_POOL_FLAG_PRIO) {
+				have = work_pool_prio_dequeue(pool);
+			} else {
+				have = TAILQ_FIRST(&pool->pqh.qh);
+				TAILQ_REMOVE(&pool->pqh.qh, have, q);
+			}
 
+			wpt->work = (struct work_pool_entry *)have;
+		} else if (pool->pqh.qring
+			&& (have = poolq_ring_pop(pool->pqh.qring))) {
+			/* submitted to the ring since checked above */
+			(pool->pqh.qcount)++;
 			wpt->work = (struct work_pool_entry *)have;
 		} else {
 			/* negative for waiting worker(s):
 			 * use the otherwise empty pool to hold them,
 			 * simplifying mutex and pointer setup.
 			 */
-			TAILQ_INSERT_TAIL(&pool->pqh.qh, &wpt->pqe, q);
+			uint64_t budget = work_pool_waiter(pool, wpt);
 
 			__warnx(TIRPC_DEBUG_FLAG_EVENT,
 				"%s() %s waiting for task",
 				__func__, pool->name);
 
-			if (unlikely(work_pool_wait(pool, wpt))) {
+			if (unlikely(work_pool_wait(pool, wpt, budget))) {
 				/* failed, not timeout */
 				pthread_mutex_unlock(&pool->pqh.qmutex);
 				break;
@@ -224,10 +1053,12 @@ work_pool_thread(void *arg)
 		}
 
 		pthread_mutex_unlock(&pool->pqh.qmutex);
-	} while (wpt->work || pool->n_threads <= pool->params.thrd_min);
+	} while (wpt->work || work_pool_keep(pool, wpt));
 
+ out:
 	/* cleanup thread context */
 	atomic_dec_uint32_t(&pool->n_threads);
+	atomic_inc_uint64_t(&pool->stats.exited);
 	cond_destroy(&wpt->pqcond);
 	mem_free(wpt, sizeof(*wpt));
 
@@ -241,7 +1072,11 @@ work_pool_dispatch(struct work_pool *pool, struct work_pool_entry *work)
 		TAILQ_FIRST(&pool->pqh.qh);
 
 	TAILQ_REMOVE(&pool->pqh.qh, &wpt->pqe, q);
+
+	/* work before the flag, for work_pool_spin() */
 	wpt->work = work;
+	atomic_clear_uint32_t_bits(&wpt->pqe.qflags,
+				   WORK_POOL_THREAD_WAITING);
 
 	/* Note: the mutex is the pool _head,
 	 * but the condition is per worker,
@@ -257,18 +1092,141 @@ work_pool_spawn(struct work_pool *pool)
 	struct work_pool_thread *wpt = mem_zalloc(sizeof(*wpt));
 
 	wpt->pool = pool;
+	wpt->worker_index = atomic_postinc_uint32_t(&pool->next_index);
 
 	rc = pthread_create(&wpt->id, &pool->attr, work_pool_thread, wpt);
 	if (rc) {
 		__warnx(TIRPC_DEBUG_FLAG_ERROR,
 			"%s() pthread_create failed (%d)\n",
 			__func__, rc);
+		mem_free(wpt, sizeof(*wpt));
 		return rc;
 	}
+	atomic_inc_uint64_t(&pool->stats.spawned);
 
 	return (0);
 }
 
+/* WORK_POOL_FLAG_STEAL: the submitting worker's own lane, otherwise one
+ * chosen once per submitting thread.
+ */
+static inline struct poolq_head *
+work_pool_lane(struct work_pool *pool)
+{
+	struct work_pool_thread *self = work_pool_self;
+
+	if (self && self->pool == pool)
+		return (&pool->lanes[self->worker_index % pool->n_lanes].pqh);
+
+	if (unlikely(!work_pool_hint))
+		work_pool_hint = atomic_inc_uint32_t(&work_pool_hints);
+
+	return (&pool->lanes[work_pool_hint % pool->n_lanes].pqh);
+}
+
+static inline int
+work_pool_submit_steal(struct work_pool *pool, struct work_pool_entry *work)
+{
+	struct poolq_head *lane;
+
+	if (atomic_fetch_uint32_t(&pool->n_idle)) {
+		/* hand directly to a waiting worker, as the shared queue */
+		pthread_mutex_lock(&pool->pqh.qmutex);
+		if (likely(0 > pool->pqh.qcount)) {
+			work_pool_wake(pool, work);
+			pthread_mutex_unlock(&pool->pqh.qmutex);
+			return (0);
+		}
+		pthread_mutex_unlock(&pool->pqh.qmutex);
+	}
+
+	lane = work_pool_lane(pool);
+	if (!lane->qring || !poolq_ring_push(lane->qring, &work->pqe)) {
+		pthread_mutex_lock(&lane->qmutex);
+		TAILQ_INSERT_TAIL(&lane->qh, &work->pqe, q);
+		(lane->qcount)++;
+		pthread_mutex_unlock(&lane->qmutex);
+	}
+
+	atomic_inc_uint32_t(&pool->n_pending);
+
+	/* a worker went idle since the check above? see work_pool_park() */
+	if (unlikely(atomic_fetch_uint32_t(&pool->n_idle))) {
+		pthread_mutex_lock(&pool->pqh.qmutex);
+		if (0 > pool->pqh.qcount)
+			work_pool_wake(pool, NULL);
+		pthread_mutex_unlock(&pool->pqh.qmutex);
+	}
+	return (0);
+}
+
+/* no idle worker, and no room to spawn another */
+static inline bool
+work_pool_saturated(struct work_pool *pool)
+{
+	return (atomic_fetch_int32_t(&pool->pqh.qcount) >= 0
+		&& atomic_fetch_uint32_t(&pool->n_threads)
+		   >= pool->params.thrd_max);
+}
+
+/**
+ * @brief Choose the part for a node (WORK_POOL_FLAG_NUMA)
+ *
+ * Spills to the next node with a waiting worker only when the given node
+ * is saturated.
+ *
+ * @param[in] pool	the work pool
+ * @param[in] ix	parts index
+ */
+static struct work_pool *
+work_pool_part(struct work_pool *pool, uint32_t ix)
+{
+	struct work_pool *part = &pool->parts[ix % pool->n_parts];
+	struct work_pool *other;
+	uint32_t n;
+
+	if (unlikely(work_pool_saturated(part))) {
+		for (n = 1; n < pool->n_parts; n++) {
+			other = &pool->parts[(ix + n) % pool->n_parts];
+			if (atomic_fetch_int32_t(&other->pqh.qcount) < 0) {
+				__warnx(TIRPC_DEBUG_FLAG_EVENT,
+					"%s() %s spill to %s",
+					__func__, part->name, other->name);
+				part = other;
+				break;
+			}
+		}
+	}
+	return (part);
+}
+
+/**
+ * @brief Submit to the pool part for a NUMA node
+ *
+ * For callers that know where the task's data lives (such as the node of
+ * the thread that received a request).  Without WORK_POOL_FLAG_NUMA, or
+ * on a single node, the same as work_pool_submit().
+ *
+ * @param[in] pool	the work pool
+ * @param[in] work	the task
+ * @param[in] node	NUMA node number, or -1 for the submitter's node
+ */
+int
+work_pool_submit_node(struct work_pool *pool, struct work_pool_entry *work,
+		      int node)
+{
+#if defined(__linux__)
+	if (pool->parts) {
+		uint32_t ix = (node < 0 || node >= CPU_SETSIZE)
+			? work_pool_node(pool)
+			: pool->node_part[node];
+
+		return work_pool_submit(work_pool_part(pool, ix), work);
+	}
+#endif
+	return work_pool_submit(pool, work);
+}
+
 int
 work_pool_submit(struct work_pool *pool, struct work_pool_entry *work)
 {
@@ -278,11 +1236,48 @@ work_pool_submit(struct work_pool *pool, struct work_pool_entry *work)
 		/* queue is draining */
 		return (0);
 	}
+#if defined(__linux__)
+	if (pool->parts)
+		return work_pool_submit(work_pool_part(pool,
+							work_pool_node(pool)),
+					work);
+#endif
+	if (pool->params.spin_max_ns)
+		work_pool_arrival(pool);
+	if (pool->params.flags & WORK_POOL_FLAG_ELASTIC)
+		work->enqueued = work_pool_ns();
+
+	if (pool->lanes)
+		return work_pool_submit_steal(pool, work);
+
+	if (pool->pqh.qring
+	 && 0 <= atomic_fetch_int32_t(&pool->pqh.qcount)
+	 && poolq_ring_push(pool->pqh.qring, &work->pqe)) {
+		struct poolq_entry *have;
+
+		/* a worker started waiting since? see work_pool_thread() */
+		if (likely(0 <= atomic_fetch_int32_t(&pool->pqh.qcount)))
+			return (0);
+
+		pthread_mutex_lock(&pool->pqh.qmutex);
+		while (0 > pool->pqh.qcount
+		    && (have = poolq_ring_pop(pool->pqh.qring))) {
+			pool->pqh.qcount++;
+			work_pool_dispatch(pool,
+					   (struct work_pool_entry *)have);
+		}
+		pthread_mutex_unlock(&pool->pqh.qmutex);
+		return (0);
+	}
+
+	/* no ring, full, or waiting worker(s) */
 	pthread_mutex_lock(&pool->pqh.qmutex);
 
 	if (likely(0 > pool->pqh.qcount++)) {
 		/* negative for waiting worker(s) */
 		work_pool_dispatch(pool, work);
+	} else if (pool->params.flags & WORK_POOL_FLAG_PRIO) {
+		work_pool_prio_enqueue(pool, work);
 	} else {
 		/* positive for task(s) */
 		TAILQ_INSERT_TAIL(&pool->pqh.qh, &work->pqe, q);
@@ -292,6 +1287,166 @@ work_pool_submit(struct work_pool *pool, struct work_pool_entry *work)
 	return rc;
 }
 
+/**
+ * @brief Submit several tasks at once
+ *
+ * Takes each queue mutex once for the batch, rather than once per task,
+ * and wakes only as many waiting workers as there are tasks.
+ *
+ * @param[in] pool	the work pool
+ * @param[in] works	the tasks
+ * @param[in] n		number of tasks
+ */
+int
+work_pool_submit_batch(struct work_pool *pool, struct work_pool_entry **works,
+		       int n)
+{
+	struct poolq_head *lane;
+	int queued;
+	int ix = 0;
+
+	if (unlikely(!pool->params.thrd_max)) {
+		/* queue is draining */
+		return (0);
+	}
+	if (unlikely(n <= 0))
+		return (0);
+#if defined(__linux__)
+	if (pool->parts)
+		return work_pool_submit_batch(work_pool_part(pool,
+							     work_pool_node(pool)),
+					      works, n);
+#endif
+	if (pool->params.spin_max_ns)
+		work_pool_arrival(pool);
+	if (pool->params.flags & WORK_POOL_FLAG_ELASTIC) {
+		uint64_t now = work_pool_ns();
+
+		for (ix = 0; ix < n; ix++)
+			works[ix]->enqueued = now;
+		ix = 0;
+	}
+
+	if (!pool->lanes) {
+		pthread_mutex_lock(&pool->pqh.qmutex);
+		for (; ix < n; ix++) {
+			if (0 > pool->pqh.qcount++) {
+				/* negative for waiting worker(s) */
+				work_pool_dispatch(pool, works[ix]);
+			} else if (pool->params.flags & WORK_POOL_FLAG_PRIO) {
+				work_pool_prio_enqueue(pool, works[ix]);
+			} else {
+				/* positive for task(s) */
+				TAILQ_INSERT_TAIL(&pool->pqh.qh,
+						  &works[ix]->pqe, q);
+			}
+		}
+		pthread_mutex_unlock(&pool->pqh.qmutex);
+		return (0);
+	}
+
+	/* WORK_POOL_FLAG_STEAL, hand directly to waiting workers first */
+	if (atomic_fetch_uint32_t(&pool->n_idle)) {
+		pthread_mutex_lock(&pool->pqh.qmutex);
+		while (ix < n && 0 > pool->pqh.qcount)
+			work_pool_wake(pool, works[ix++]);
+		pthread_mutex_unlock(&pool->pqh.qmutex);
+		if (ix == n)
+			return (0);
+	}
+
+	queued = n - ix;
+	lane = work_pool_lane(pool);
+	if (lane->qring) {
+		while (ix < n && poolq_ring_push(lane->qring, &works[ix]->pqe))
+			ix++;
+	}
+	if (ix < n) {
+		pthread_mutex_lock(&lane->qmutex);
+		for (; ix < n; ix++) {
+			TAILQ_INSERT_TAIL(&lane->qh, &works[ix]->pqe, q);
+			(lane->qcount)++;
+		}
+		pthread_mutex_unlock(&lane->qmutex);
+	}
+
+	atomic_add_uint32_t(&pool->n_pending, queued);
+
+	/* worker(s) went idle since the check above? see work_pool_park() */
+	if (unlikely(atomic_fetch_uint32_t(&pool->n_idle))) {
+		pthread_mutex_lock(&pool->pqh.qmutex);
+		while (queued-- && 0 > pool->pqh.qcount)
+			work_pool_wake(pool, NULL);
+		pthread_mutex_unlock(&pool->pqh.qmutex);
+	}
+	return (0);
+}
+
+/**
+ * @brief Get the pool counters
+ *
+ * With WORK_POOL_FLAG_NUMA, the sum over the parts.
+ *
+ * @param[in] pool	the work pool
+ * @param[out] stats	the counters
+ */
+void
+work_pool_get_stats(struct work_pool *pool, struct work_pool_stats *stats)
+{
+	struct poolq_ring *ring = pool->pqh.qring;
+	int32_t qcount;
+	uint32_t ix;
+
+	memset(stats, 0, sizeof(*stats));
+
+	if (pool->parts) {
+		struct work_pool_stats part;
+
+		for (ix = 0; ix < pool->n_parts; ix++) {
+			uint32_t b;
+
+			work_pool_get_stats(&pool->parts[ix], &part);
+			stats->spawned += part.spawned;
+			stats->exited += part.exited;
+			stats->spin_hits += part.spin_hits;
+			stats->spin_misses += part.spin_misses;
+			for (b = 0; b < WORK_POOL_DELAY_BUCKETS; b++)
+				stats->delay[b] += part.delay[b];
+			stats->delay_avg_ns += part.delay_avg_ns
+					     / pool->n_parts;
+			stats->n_threads += part.n_threads;
+			stats->n_idle += part.n_idle;
+			stats->depth += part.depth;
+		}
+		return;
+	}
+
+	stats->spawned = atomic_fetch_uint64_t(&pool->stats.spawned);
+	stats->exited = atomic_fetch_uint64_t(&pool->stats.exited);
+	stats->spin_hits = atomic_fetch_uint64_t(&pool->stats.spin_hits);
+	stats->spin_misses = atomic_fetch_uint64_t(&pool->stats.spin_misses);
+	for (ix = 0; ix < WORK_POOL_DELAY_BUCKETS; ix++)
+		stats->delay[ix] =
+			atomic_fetch_uint64_t(&pool->stats.delay[ix]);
+	stats->delay_avg_ns = atomic_fetch_uint64_t(&pool->delay_ns);
+	stats->n_threads = atomic_fetch_uint32_t(&pool->n_threads);
+
+	if (pool->lanes) {
+		stats->n_idle = atomic_fetch_uint32_t(&pool->n_idle);
+		stats->depth = atomic_fetch_uint32_t(&pool->n_pending);
+		return;
+	}
+
+	qcount = atomic_fetch_int32_t(&pool->pqh.qcount);
+	if (qcount < 0)
+		stats->n_idle = -qcount;
+	else
+		stats->depth = qcount;
+	if (ring)
+		stats->depth += atomic_fetch_uint32_t(&ring->enq)
+			      - atomic_fetch_uint32_t(&ring->deq);
+}
+
 int
 work_pool_shutdown(struct work_pool *pool)
 {
@@ -303,9 +1458,17 @@ work_pool_shutdown(struct work_pool *pool)
 	pool->params.thrd_max =
 	pool->params.thrd_min = 0;
 
+#if defined(__linux__)
+	work_pool_shutdown_parts(pool);
+#endif
+
 	pthread_mutex_lock(&pool->pqh.qmutex);
 
 	while (0 > pool->pqh.qcount) {
+		if (pool->lanes) {
+			work_pool_wake(pool, NULL);
+			continue;
+		}
 		/* unlike _submit, only increment negatives */
 		pool->pqh.qcount++;
 		work_pool_dispatch(pool, NULL);
@@ -317,6 +1480,16 @@ work_pool_shutdown(struct work_pool *pool)
 		nanosleep(&ts, NULL);
 	}
 
+	if (pool->lanes) {
+		uint32_t ix;
+
+		for (ix = 0; ix < pool->n_lanes; ix++)
+			poolq_head_destroy(&pool->lanes[ix].pqh);
+		mem_free(pool->lanes,
+			 pool->n_lanes * sizeof(struct work_pool_lane));
+		pool->lanes = NULL;
+	}
+
 	mem_free(pool->name, 0);
 	poolq_head_destroy(&pool->pqh);
 
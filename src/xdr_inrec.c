@@ -80,12 +80,12 @@ static u_int xdr_inrec_getpos(XDR *);
 static bool xdr_inrec_setpos(XDR *, u_int);
 static int32_t *xdr_inrec_inline(XDR *, u_int);
 static void xdr_inrec_destroy(XDR *);
+static bool xdr_inrec_getbufs(XDR *, xdr_uio *, u_int, u_int);
 static bool xdr_inrec_noop(void);
 
 extern bool xdr_inrec_readahead(XDR *, u_int);
 
 typedef bool (*dummyfunc3) (XDR *, int, void *);
-typedef bool (*dummy_getbufs) (XDR *, xdr_uio *, u_int);
 typedef bool (*dummy_putbufs) (XDR *, xdr_uio *, u_int);
 
 static const struct  xdr_ops xdr_inrec_ops = {
@@ -98,7 +98,7 @@ static const struct  xdr_ops xdr_inrec_ops = {
 	xdr_inrec_inline,
 	xdr_inrec_destroy,
 	(dummyfunc3) xdr_inrec_noop, /* x_control */
-	(dummy_getbufs) xdr_inrec_noop, /* x_getbufs */
+	xdr_inrec_getbufs,
 	(dummy_putbufs) xdr_inrec_noop  /* x_putbufs */
 };
 
@@ -373,6 +373,76 @@ xdr_inrec_inline(XDR *xdrs, u_int len)
 	return (buf);
 }
 
+/*
+ * Receive len bytes of the current record into the caller's buffers,
+ * uio_count vectors filled from vio_tail up to vio_wrap.  Bytes already
+ * buffered are copied; the rest are read directly into the vectors,
+ * never through in_base.  For bulk opaque payloads; the XDR padding
+ * that follows is left to the caller.
+ */
+static bool
+xdr_inrec_getbufs(XDR *xdrs, xdr_uio *uio, u_int len, u_int flags)
+{
+	RECSTREAM *rstrm = (RECSTREAM *) (xdrs->x_private);
+	xdr_vio *vio;
+	size_t room = 0;
+	size_t ix;
+	int32_t current;
+	int n;
+
+	for (ix = 0; ix < uio->uio_count; ix++)
+		room += (uintptr_t)uio->uio_vio[ix].vio_wrap
+			- (uintptr_t)uio->uio_vio[ix].vio_tail;
+	if (room < len)
+		return (false);
+
+	/* the checksummed head is in_base, before it is overwritten */
+	if ((xdrs->x_flags & XDR_FLAG_CKSUM) && rstrm->cklen
+	    && !rstrm->cksum)
+		compute_buffer_cksum(rstrm);
+
+	vio = uio->uio_vio;
+	while (len > 0) {
+		current = (int32_t)rstrm->fbtbc;
+		if (current == 0) {
+			if (rstrm->last_frag)
+				return (false);
+			if (!set_input_fragment(rstrm, INT_MAX))
+				return (false);
+			continue;
+		}
+		room = (uintptr_t)vio->vio_wrap - (uintptr_t)vio->vio_tail;
+		if (!room) {
+			vio++;
+			continue;
+		}
+		current = MIN(MIN((u_int)current, len), room);
+
+		n = PtrToUlong(rstrm->in_boundry) - PtrToUlong(rstrm->in_finger);
+		if (n) {
+			/* buffered by an earlier read ahead */
+			current = MIN(current, n);
+			memcpy(vio->vio_tail, rstrm->in_finger, current);
+			rstrm->in_finger += current;
+		} else {
+			current = (*(rstrm->readit)) (xdrs, rstrm->tcp_handle,
+						      vio->vio_tail, current);
+			if (current <= 0)
+				return (false);
+			/* empty, keeping the stream alignment for the next */
+			rstrm->in_finger = rstrm->in_base
+				+ ((PtrToUlong(rstrm->in_boundry) + current)
+				   % BYTES_PER_XDR_UNIT);
+			rstrm->in_boundry = rstrm->in_finger;
+			rstrm->offset += current;
+		}
+		vio->vio_tail = (char *)vio->vio_tail + current;
+		rstrm->fbtbc -= current;
+		len -= current;
+	}
+	return (true);
+}
+
 static void
 xdr_inrec_destroy(XDR *xdrs)
 {
@@ -53,8 +53,7 @@
 #include <rpc/xdr_ioq.h>
 
 static bool xdr_ioq_noop(void) __attribute__ ((unused));
-
-#define VREC_MAXBUFS 24
+static bool xdr_ioq_getbytes(XDR *, char *, u_int);
 
 static uint64_t next_id;
 
@@ -84,6 +83,19 @@ xdr_ioq_uv_create(u_int size, u_int uio_flags)
 	return (uv);
 }
 
+/* added directly to the queue.
+ * this lock is needed for context header queues,
+ * but is not a burden on uncontested data queues.
+ */
+static inline void
+xdr_ioq_uv_append(struct xdr_ioq *xioq, struct poolq_entry *have)
+{
+	pthread_mutex_lock(&xioq->ioq_uv.uvqh.qmutex);
+	(xioq->ioq_uv.uvqh.qcount)++;
+	TAILQ_INSERT_TAIL(&xioq->ioq_uv.uvqh.qh, have, q);
+	pthread_mutex_unlock(&xioq->ioq_uv.uvqh.qmutex);
+}
+
 struct poolq_entry *
 xdr_ioq_uv_fetch(struct xdr_ioq *xioq, struct poolq_head *ioqh,
 		 char *comment, u_int count, u_int ioq_flags)
@@ -93,22 +105,35 @@ xdr_ioq_uv_fetch(struct xdr_ioq *xioq, struct poolq_head *ioqh,
 	__warnx(TIRPC_DEBUG_FLAG_XDR,
 		"%s() %u %s",
 		__func__, count, comment);
+
+	if (ioqh->qring && count == 1) {
+		/* no mutex while the ring has buffers.
+		 * Only for a single buffer: a multi-buffer fetch must not
+		 * hold a partial set while it waits (see
+		 * xdr_rdma_chunk_fetch()), so it stays serialized under
+		 * the mutex and is served in order by xdr_ioq_uv_handoff().
+		 */
+		have = poolq_ring_pop(ioqh->qring);
+		if (have) {
+			xdr_ioq_uv_append(xioq, have);
+			return have;
+		}
+	}
+
 	pthread_mutex_lock(&ioqh->qmutex);
 
 	while (count--) {
-		if (likely(0 < ioqh->qcount--)) {
+		/* atomic, pairs with xdr_ioq_uv_recycle() ring check */
+		if (likely(0 < atomic_postdec_int32_t(&ioqh->qcount))) {
 			/* positive for buffer(s) */
 			have = TAILQ_FIRST(&ioqh->qh);
 			TAILQ_REMOVE(&ioqh->qh, have, q);
-
-			/* added directly to the queue.
-			 * this lock is needed for context header queues,
-			 * but is not a burden on uncontested data queues.
-			 */
-			pthread_mutex_lock(&xioq->ioq_uv.uvqh.qmutex);
-			(xioq->ioq_uv.uvqh.qcount)++;
-			TAILQ_INSERT_TAIL(&xioq->ioq_uv.uvqh.qh, have, q);
-			pthread_mutex_unlock(&xioq->ioq_uv.uvqh.qmutex);
+			xdr_ioq_uv_append(xioq, have);
+		} else if (ioqh->qring
+			&& (have = poolq_ring_pop(ioqh->qring))) {
+			/* recycled to the ring since checked above */
+			(ioqh->qcount)++;
+			xdr_ioq_uv_append(xioq, have);
 		} else {
 			u_int saved = xioq->xdrs[0].x_handy;
 
@@ -150,35 +175,59 @@ xdr_ioq_uv_fetch_nothing(struct xdr_ioq *xioq, struct poolq_head *ioqh,
 	return NULL;
 }
 
+/* negative for waiting worker(s), qcount already incremented.
+ * Called with the pool _head mutex held.
+ */
+static inline void
+xdr_ioq_uv_handoff(struct poolq_head *ioqh, struct poolq_entry *have)
+{
+	struct xdr_ioq *wait = _IOQ(TAILQ_FIRST(&ioqh->qh));
+
+	/* added directly to the queue.
+	 * no need to lock here, the mutex is the pool _head.
+	 */
+	(wait->ioq_uv.uvqh.qcount)++;
+	TAILQ_INSERT_TAIL(&wait->ioq_uv.uvqh.qh, have, q);
+
+	/* Nota Bene: x_handy was decremented count,
+	 * will be zero for last one needed,
+	 * then will wrap as unsigned.
+	 */
+	if (0 < wait->xdrs[0].x_handy--) {
+		/* not removed */
+		ioqh->qcount--;
+	} else {
+		TAILQ_REMOVE(&ioqh->qh, &wait->ioq_s, q);
+		pthread_cond_signal(&wait->ioq_cond);
+	}
+}
+
 static inline void
 xdr_ioq_uv_recycle(struct poolq_head *ioqh, struct poolq_entry *have)
 {
+	if (ioqh->qring && poolq_ring_push(ioqh->qring, have)) {
+		/* a fetch started waiting since? see xdr_ioq_uv_fetch() */
+		if (likely(0 <= atomic_fetch_int32_t(&ioqh->qcount)))
+			return;
+
+		pthread_mutex_lock(&ioqh->qmutex);
+		while (0 > ioqh->qcount
+		    && (have = poolq_ring_pop(ioqh->qring))) {
+			ioqh->qcount++;
+			xdr_ioq_uv_handoff(ioqh, have);
+		}
+		pthread_mutex_unlock(&ioqh->qmutex);
+		return;
+	}
+
+	/* no ring, or full */
 	pthread_mutex_lock(&ioqh->qmutex);
 
 	if (likely(0 <= ioqh->qcount++)) {
 		/* positive for buffer(s) */
 		TAILQ_INSERT_TAIL(&ioqh->qh, have, q);
 	} else {
-		/* negative for waiting worker(s) */
-		struct xdr_ioq *wait = _IOQ(TAILQ_FIRST(&ioqh->qh));
-
-		/* added directly to the queue.
-		 * no need to lock here, the mutex is the pool _head.
-		 */
-		(wait->ioq_uv.uvqh.qcount)++;
-		TAILQ_INSERT_TAIL(&wait->ioq_uv.uvqh.qh, have, q);
-
-		/* Nota Bene: x_handy was decremented count,
-		 * will be zero for last one needed,
-		 * then will wrap as unsigned.
-		 */
-		if (0 < wait->xdrs[0].x_handy--) {
-			/* not removed */
-			ioqh->qcount--;
-		} else {
-			TAILQ_REMOVE(&ioqh->qh, &wait->ioq_s, q);
-			pthread_cond_signal(&wait->ioq_cond);
-		}
+		xdr_ioq_uv_handoff(ioqh, have);
 	}
 
 	pthread_mutex_unlock(&ioqh->qmutex);
@@ -357,15 +406,15 @@ xdr_ioq_uv_next(struct xdr_ioq *xioq, u_int ioq_flags)
 			/* XXX empty buffer slot (not supported for now) */
 			uv = xdr_ioq_uv_create(0, UIO_FLAG_NONE);
 		}
-	}
 
-	if (uv) {
 		if (!xioq->ioq_uv.uvq_fetch) {
 			/* new xdr_ioq_uv */
 			(xioq->ioq_uv.uvqh.qcount)++;
 			TAILQ_INSERT_TAIL(&xioq->ioq_uv.uvqh.qh, &uv->uvq, q);
 		}
+	}
 
+	if (uv) {
 		/* advance iterator */
 		xioq->xdrs[0].x_data = uv->v.vio_head;
 		xioq->xdrs[0].x_base = &uv->v;
@@ -385,11 +434,13 @@ xdr_ioq_getlong(XDR *xdrs, long *lp)
 
 	while (future > xdrs->x_v.vio_tail) {
 		if (unlikely(xdrs->x_data != xdrs->x_v.vio_tail)) {
-			/* FIXME: insufficient data or unaligned? stop! */
-			__warnx(TIRPC_DEBUG_FLAG_ERROR,
-				"%s() x_data != x_v.vio_tail\n",
-				__func__);
-			return (false);
+			/* split between segments, as received */
+			uint32_t u;
+
+			if (!xdr_ioq_getbytes(xdrs, (char *)&u, sizeof(u)))
+				return (false);
+			*lp = (long)ntohl(u);
+			return (true);
 		}
 		uv = xdr_ioq_uv_next(XIOQ(xdrs), IOQ_FLAG_NONE);
 		if (!uv) {
@@ -491,56 +542,33 @@ xdr_ioq_putbytes(XDR *xdrs, const char *addr, u_int len)
 	return (true);
 }
 
-/* Get buffers from the queue. */
+/*
+ * Get len bytes into the caller's buffers, uio_count vectors filled from
+ * vio_tail up to vio_wrap, as xdr_inrec.  The XDR padding is left to the
+ * caller.
+ */
 static bool
-xdr_ioq_getbufs(XDR *xdrs, xdr_uio *uio, u_int flags)
+xdr_ioq_getbufs(XDR *xdrs, xdr_uio *uio, u_int len, u_int flags)
 {
-    /* XXX finalize */
-#if 0
-
-	struct xdr_ioq_uv *uv;
-	ssize_t delta;
-	int ix;
-
-	/* allocate sufficient slots to empty the queue, else MAX */
-	uio->xbs_cnt = XIOQ(xdrs)->ioq_uv.uvqh.qsize - XIOQ(xdrs)->ioq_uv.pcount;
-	if (uio->xbs_cnt > VREC_MAXBUFS) {
-		uio->xbs_cnt = VREC_MAXBUFS;
-	}
-
-	/* fail if no segments available */
-	if (unlikely(! uio->xbs_cnt))
-		return (FALSE);
-
-	uio->xbs_buf = mem_alloc(uio->xbs_cnt);
-	uio->xbs_resid = 0;
-	ix = 0;
-
-	/* re-consuming bytes in a stream (after SETPOS/rewind) */
-	while (len > 0
-		&& XIOQ(xdrs)->ioq_uv.pcount < XIOQ(xdrs)->ioq_uv.uvqh.qcount) {
-		delta = (uintptr_t)XDR_VIO(xioq->xdrs)->vio_tail
-			- (uintptr_t)xdrs->x_data;
-
-		if (unlikely(delta > len)) {
-			delta = len;
-		} else if (unlikely(!delta)) {
-			uv = xdr_ioq_uv_next(XIOQ(xdrs), IOQ_FLAG_NONE);
-			if (!uv)
-				return (false);
-			continue;
-		}
-		(uio->xbs_buf[ix]).xb_p1 = uv;
-		uv->u.uio_references)++;
-		(uio->xbs_buf[ix]).xb_base = xdrs->x_data;
-		XIOQ(xdrs)->ioq_uv.plength += delta;
-		xdrs->x_data += delta;
-		len -= delta;
+	xdr_vio *vio;
+	size_t room = 0;
+	size_t ix;
+
+	for (ix = 0; ix < uio->uio_count; ix++)
+		room += (uintptr_t)uio->uio_vio[ix].vio_wrap
+			- (uintptr_t)uio->uio_vio[ix].vio_tail;
+	if (room < len)
+		return (false);
+
+	for (vio = uio->uio_vio; len > 0; vio++) {
+		room = (uintptr_t)vio->vio_wrap - (uintptr_t)vio->vio_tail;
+		room = MIN(room, len);
+		if (!xdr_ioq_getbytes(xdrs, vio->vio_tail, room))
+			return (false);
+		vio->vio_tail = (char *)vio->vio_tail + room;
+		len -= room;
 	}
-#endif /* 0 */
-
-	/* assert(len == 0); */
-	return (TRUE);
+	return (true);
 }
 
 /* Post buffers on the queue, or, if indicated in flags, return buffers
@@ -702,9 +730,18 @@ xdr_ioq_inline(XDR *xdrs, u_int len)
 void
 xdr_ioq_release(struct poolq_head *ioqh)
 {
-	struct poolq_entry *have = TAILQ_FIRST(&ioqh->qh);
+	struct poolq_entry *have;
+
+	if (ioqh->qring) {
+		/* gather the ring onto the queue */
+		while ((have = poolq_ring_pop(ioqh->qring))) {
+			TAILQ_INSERT_TAIL(&ioqh->qh, have, q);
+			(ioqh->qcount)++;
+		}
+	}
 
 	/* release queued buffers */
+	have = TAILQ_FIRST(&ioqh->qh);
 	while (have) {
 		struct poolq_entry *next = TAILQ_NEXT(have, q);
 
@@ -0,0 +1,470 @@
+/*
+ * Copyright (c) 2026 The libntirpc contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR `AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file xdr_ioq_cache.c
+ * @brief Size-classed cache of xdr_ioq_uv segments
+ *
+ * @section DESCRIPTION
+ *
+ * A free segment keeps its header and buffer.  Each thread holds two
+ * magazines (arrays of free segments) per size class, loaded and
+ * previous, and takes and returns segments without locking while either
+ * has room.  When both are empty (or both full), the previous magazine is
+ * exchanged with the class depot for a full (or empty) one, so segments
+ * freed by one thread return to another a magazine at a time.  With the
+ * depot full, segments are freed.
+ */
+
+#include <config.h>
+
+#include <sys/types.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <rpc/types.h>
+#include <reentrant.h>
+#include <intrinsic.h>
+#include <misc/portable.h>
+#include <misc/abstract_atomic.h>
+#include <misc/queue.h>
+#include <rpc/xdr_ioq.h>
+
+#define XDR_IOQ_MAG_ROUNDS (64)
+
+struct xdr_ioq_mag {
+	struct xdr_ioq_mag *next;	/* in the depot */
+	u_int rounds;
+	struct xdr_ioq_uv *uv[XDR_IOQ_MAG_ROUNDS];
+};
+
+struct xdr_ioq_cache_class {
+	mutex_t mtx;
+	struct xdr_ioq_mag *full;
+	struct xdr_ioq_mag *empty;
+	u_int nfull;
+
+	u_int size;
+	u_int rounds;		/* per magazine, at most XDR_IOQ_MAG_ROUNDS */
+	u_int depot_max;	/* full magazines kept */
+};
+
+/*
+ * Fewer rounds for the larger sizes, bounding what each thread holds to
+ * two magazines of each class: 512 KiB + 512 KiB + 1 MiB + 4 MiB, 6 MiB.
+ * Each depot holds up to 16 MiB, 64 MiB for all.
+ */
+static struct xdr_ioq_cache_class xdr_ioq_cache_classes[] = {
+	[XDR_IOQ_CACHE_4K] = {
+		.mtx = MUTEX_INITIALIZER,
+		.size = 4096,
+		.rounds = 64,
+		.depot_max = 64,
+	},
+	[XDR_IOQ_CACHE_8K] = {
+		.mtx = MUTEX_INITIALIZER,
+		.size = 8192,
+		.rounds = 32,
+		.depot_max = 64,
+	},
+	[XDR_IOQ_CACHE_64K] = {
+		.mtx = MUTEX_INITIALIZER,
+		.size = 65536,
+		.rounds = 8,
+		.depot_max = 32,
+	},
+	[XDR_IOQ_CACHE_1M] = {
+		.mtx = MUTEX_INITIALIZER,
+		.size = 1048576,
+		.rounds = 2,
+		.depot_max = 8,
+	},
+};
+
+struct xdr_ioq_cache_mags {
+	struct xdr_ioq_mag *loaded;
+	struct xdr_ioq_mag *previous;
+
+	/* only the owner updates, read unlocked by xdr_ioq_cache_stats() */
+	struct xdr_ioq_cache_stats st;
+};
+
+struct xdr_ioq_cache_thread {
+	TAILQ_ENTRY(xdr_ioq_cache_thread) q;
+	struct xdr_ioq_cache_mags mags[XDR_IOQ_CACHE_CLASSES];
+};
+
+static TAILQ_HEAD(xdr_ioq_cache_threads, xdr_ioq_cache_thread)
+	xdr_ioq_cache_threads = TAILQ_HEAD_INITIALIZER(xdr_ioq_cache_threads);
+static struct xdr_ioq_cache_stats xdr_ioq_cache_exited[XDR_IOQ_CACHE_CLASSES];
+static mutex_t xdr_ioq_cache_mtx = MUTEX_INITIALIZER;
+
+static pthread_once_t xdr_ioq_cache_once = PTHREAD_ONCE_INIT;
+static thread_key_t xdr_ioq_cache_key;
+static __thread struct xdr_ioq_cache_thread *xdr_ioq_cache_self;
+
+static void xdr_ioq_cache_release(struct xdr_uio *, u_int);
+
+/* the smallest class holding size, or -1 */
+static inline int
+xdr_ioq_cache_index(u_int size)
+{
+	int ix;
+
+	for (ix = 0; ix < XDR_IOQ_CACHE_CLASSES; ix++)
+		if (size <= xdr_ioq_cache_classes[ix].size)
+			return (ix);
+	return (-1);
+}
+
+static inline void
+xdr_ioq_cache_free(struct xdr_ioq_uv *uv)
+{
+	mem_free(uv->v.vio_base, ioquv_size(uv));
+	mem_free(uv, sizeof(*uv));
+}
+
+static inline void
+xdr_ioq_cache_stats_add(struct xdr_ioq_cache_stats *to,
+			struct xdr_ioq_cache_stats *from)
+{
+	to->allocs += atomic_fetch_uint64_t(&from->allocs);
+	to->hits += atomic_fetch_uint64_t(&from->hits);
+	to->misses += atomic_fetch_uint64_t(&from->misses);
+	to->frees += atomic_fetch_uint64_t(&from->frees);
+	to->releases += atomic_fetch_uint64_t(&from->releases);
+	to->depot += atomic_fetch_uint64_t(&from->depot);
+}
+
+/* a magazine of an exiting (or idle) thread to the depot, or freed */
+static void
+xdr_ioq_cache_flush(struct xdr_ioq_cache_class *cls,
+		    struct xdr_ioq_cache_mags *m, struct xdr_ioq_mag *mag)
+{
+	if (!mag)
+		return;
+
+	mutex_lock(&cls->mtx);
+	if (!mag->rounds) {
+		mag->next = cls->empty;
+		cls->empty = mag;
+		mag = NULL;
+	} else if (cls->nfull < cls->depot_max) {
+		mag->next = cls->full;
+		cls->full = mag;
+		cls->nfull++;
+		mag = NULL;
+	}
+	mutex_unlock(&cls->mtx);
+
+	if (!mag)
+		return;
+
+	while (mag->rounds) {
+		xdr_ioq_cache_free(mag->uv[--mag->rounds]);
+		m->st.releases++;
+	}
+	mem_free(mag, sizeof(*mag));
+}
+
+static void
+xdr_ioq_cache_flush_mags(struct xdr_ioq_cache_thread *self)
+{
+	struct xdr_ioq_cache_mags *m;
+	int ix;
+
+	for (ix = 0; ix < XDR_IOQ_CACHE_CLASSES; ix++) {
+		m = &self->mags[ix];
+		xdr_ioq_cache_flush(&xdr_ioq_cache_classes[ix], m, m->loaded);
+		xdr_ioq_cache_flush(&xdr_ioq_cache_classes[ix], m, m->previous);
+		m->loaded = NULL;
+		m->previous = NULL;
+	}
+}
+
+static void
+xdr_ioq_cache_thread_exit(void *arg)
+{
+	struct xdr_ioq_cache_thread *self = arg;
+	int ix;
+
+	xdr_ioq_cache_flush_mags(self);
+
+	mutex_lock(&xdr_ioq_cache_mtx);
+	TAILQ_REMOVE(&xdr_ioq_cache_threads, self, q);
+	for (ix = 0; ix < XDR_IOQ_CACHE_CLASSES; ix++)
+		xdr_ioq_cache_stats_add(&xdr_ioq_cache_exited[ix],
+					&self->mags[ix].st);
+	mutex_unlock(&xdr_ioq_cache_mtx);
+
+	xdr_ioq_cache_self = NULL;
+	mem_free(self, sizeof(*self));
+}
+
+static void
+xdr_ioq_cache_key_init(void)
+{
+	thr_keycreate(&xdr_ioq_cache_key, xdr_ioq_cache_thread_exit);
+}
+
+static inline struct xdr_ioq_cache_thread *
+xdr_ioq_cache_thread(void)
+{
+	struct xdr_ioq_cache_thread *self = xdr_ioq_cache_self;
+
+	if (likely(self))
+		return (self);
+
+	/* magazines are taken as needed */
+	thr_once(&xdr_ioq_cache_once, xdr_ioq_cache_key_init);
+	self = mem_zalloc(sizeof(*self));
+
+	mutex_lock(&xdr_ioq_cache_mtx);
+	TAILQ_INSERT_TAIL(&xdr_ioq_cache_threads, self, q);
+	mutex_unlock(&xdr_ioq_cache_mtx);
+
+	thr_setspecific(xdr_ioq_cache_key, self);
+	xdr_ioq_cache_self = self;
+	return (self);
+}
+
+/**
+ * @brief Get an empty segment, with one reference
+ *
+ * @param[in] size	at least
+ *
+ * Segments of a class have its size.  Over the largest class, the segment
+ * is not cached (UIO_FLAG_FREE).  Released by xdr_ioq_uv_release(), or
+ * by uio_release at the last reference.
+ */
+struct xdr_ioq_uv *
+xdr_ioq_cache_get(u_int size)
+{
+	struct xdr_ioq_cache_class *cls;
+	struct xdr_ioq_cache_mags *m;
+	struct xdr_ioq_mag *mag;
+	struct xdr_ioq_uv *uv;
+	int ix = xdr_ioq_cache_index(size);
+
+	if (unlikely(ix < 0))
+		return (xdr_ioq_uv_create(size, UIO_FLAG_FREE));
+
+	cls = &xdr_ioq_cache_classes[ix];
+	m = &xdr_ioq_cache_thread()->mags[ix];
+	m->st.allocs++;
+
+	if (likely(m->loaded && m->loaded->rounds))
+		goto hit;
+
+	if (m->previous && m->previous->rounds) {
+		mag = m->loaded;
+		m->loaded = m->previous;
+		m->previous = mag;
+		goto hit;
+	}
+
+	/* both empty, exchange previous for a full magazine */
+	mutex_lock(&cls->mtx);
+	mag = cls->full;
+	if (mag) {
+		cls->full = mag->next;
+		cls->nfull--;
+		if (m->previous) {
+			m->previous->next = cls->empty;
+			cls->empty = m->previous;
+		}
+		m->previous = m->loaded;
+		m->loaded = mag;
+	}
+	mutex_unlock(&cls->mtx);
+
+	if (mag) {
+		m->st.depot++;
+		goto hit;
+	}
+
+	m->st.misses++;
+	uv = xdr_ioq_uv_create(cls->size, UIO_FLAG_BUFQ);
+	uv->u.uio_p1 = cls;
+	uv->u.uio_release = xdr_ioq_cache_release;
+	return (uv);
+
+ hit:
+	m->st.hits++;
+	return (m->loaded->uv[--(m->loaded->rounds)]);
+}
+
+/* uio_release, at the last reference */
+static void
+xdr_ioq_cache_release(struct xdr_uio *uio, u_int flags)
+{
+	struct xdr_ioq_uv *uv = IOQU(uio);
+	struct xdr_ioq_cache_class *cls = uio->uio_p1;
+	struct xdr_ioq_cache_mags *m;
+	struct xdr_ioq_mag *mag;
+
+	uv->u.uio_references = 1;
+	uv->v.vio_head = uv->v.vio_base;
+	uv->v.vio_tail = uv->v.vio_base;
+
+	m = &xdr_ioq_cache_thread()->mags[cls - xdr_ioq_cache_classes];
+	m->st.frees++;
+
+	if (likely(m->loaded && m->loaded->rounds < cls->rounds))
+		goto push;
+
+	if (m->previous && !m->previous->rounds) {
+		mag = m->loaded;
+		m->loaded = m->previous;
+		m->previous = mag;
+		goto push;
+	}
+
+	/* both full (or none), exchange previous for an empty magazine */
+	mutex_lock(&cls->mtx);
+	if (m->previous) {
+		if (cls->nfull >= cls->depot_max) {
+			mutex_unlock(&cls->mtx);
+			m->st.releases++;
+			xdr_ioq_cache_free(uv);
+			return;
+		}
+		m->previous->next = cls->full;
+		cls->full = m->previous;
+		cls->nfull++;
+		m->st.depot++;
+	}
+	m->previous = m->loaded;
+	mag = cls->empty;
+	if (mag)
+		cls->empty = mag->next;
+	mutex_unlock(&cls->mtx);
+
+	if (!mag)
+		mag = mem_zalloc(sizeof(*mag));
+	m->loaded = mag;
+
+ push:
+	m->loaded->uv[(m->loaded->rounds)++] = uv;
+}
+
+/**
+ * @brief Return the calling thread's magazines
+ *
+ * Segments held by a thread are otherwise only returned at its exit, up
+ * to 6 MiB for each thread.  Called by svc_work_pool workers and event
+ * channel threads idle for their timeout, so that only busy threads hold
+ * any; the depots keep what they have room for, and free the rest.
+ */
+void
+xdr_ioq_cache_flush_thread(void)
+{
+	struct xdr_ioq_cache_thread *self = xdr_ioq_cache_self;
+
+	if (self)
+		xdr_ioq_cache_flush_mags(self);
+}
+
+/*
+ * Segments grow with the stream, from min_bsize to the largest class
+ * not over both the bytes already in it and max_bsize.
+ */
+static inline u_int
+xdr_ioq_cache_bsize(struct xdr_ioq_uv_head *uvh)
+{
+	u_int size = uvh->min_bsize;
+	u_int next;
+	int ix;
+
+	for (ix = 0; ix < XDR_IOQ_CACHE_CLASSES; ix++) {
+		next = xdr_ioq_cache_classes[ix].size;
+		if (next > uvh->plength || next > uvh->max_bsize)
+			break;
+		if (next > size)
+			size = next;
+	}
+	return (size);
+}
+
+/* uvq_fetch for output streams of cached segments */
+struct poolq_entry *
+xdr_ioq_cache_fetch(struct xdr_ioq *xioq, struct poolq_head *ioqh,
+		    char *comment, u_int count, u_int ioq_flags)
+{
+	struct xdr_ioq_uv *uv = NULL;
+	u_int size = xdr_ioq_cache_bsize(&xioq->ioq_uv);
+
+	__warnx(TIRPC_DEBUG_FLAG_XDR,
+		"%s() %u %s size %u",
+		__func__, count, comment, size);
+
+	while (count--) {
+		uv = xdr_ioq_cache_get(size);
+		(xioq->ioq_uv.uvqh.qcount)++;
+		TAILQ_INSERT_TAIL(&xioq->ioq_uv.uvqh.qh, &uv->uvq, q);
+	}
+	return (uv ? &uv->uvq : NULL);
+}
+
+/**
+ * @brief Create an output stream of cached segments
+ *
+ * @param[in] min_bsize	first segment size
+ * @param[in] max_bsize	largest segment size, as the stream grows
+ */
+XDR *
+xdr_ioq_cache_create(u_int min_bsize, u_int max_bsize)
+{
+	XDR *xdrs = xdr_ioq_create(min_bsize, max_bsize, UIO_FLAG_BUFQ);
+	struct xdr_ioq *xioq = XIOQ(xdrs);
+
+	xioq->ioq_uv.uvq_fetch = xdr_ioq_cache_fetch;
+	(void)xdr_ioq_cache_fetch(xioq, NULL, "first buffer", 1,
+				  IOQ_FLAG_NONE);
+	xdr_ioq_reset(xioq, 0);
+	return (xdrs);
+}
+
+/**
+ * @brief Counters of each size class, for all threads
+ *
+ * The hit rate of a class is hits / allocs.
+ */
+void
+xdr_ioq_cache_stats(struct xdr_ioq_cache_stats stats[XDR_IOQ_CACHE_CLASSES])
+{
+	struct xdr_ioq_cache_thread *self;
+	int ix;
+
+	mutex_lock(&xdr_ioq_cache_mtx);
+	memcpy(stats, xdr_ioq_cache_exited, sizeof(xdr_ioq_cache_exited));
+	TAILQ_FOREACH(self, &xdr_ioq_cache_threads, q) {
+		for (ix = 0; ix < XDR_IOQ_CACHE_CLASSES; ix++)
+			xdr_ioq_cache_stats_add(&stats[ix],
+						&self->mags[ix].st);
+	}
+	mutex_unlock(&xdr_ioq_cache_mtx);
+}
@@ -54,7 +54,7 @@
 #include "un-namespace.h"
 
 typedef bool (*dummyfunc3)(XDR *, int, void *);
-typedef bool (*dummy_getbufs)(XDR *, xdr_uio *, u_int);
+typedef bool (*dummy_getbufs)(XDR *, xdr_uio *, u_int, u_int);
 typedef bool (*dummy_putbufs)(XDR *, xdr_uio *, u_int);
 
 static const struct xdr_ops xdrmem_ops_aligned;
@@ -999,10 +999,12 @@ xdr_rdma_create(XDR *xdrs, RDMAXPRT *xprt, const u_int sendsize,
 				IBV_ACCESS_REMOTE_READ);
 
 	poolq_head_setup(&xprt->inbufs.uvqh);
+	poolq_ring_setup(&xprt->inbufs.uvqh, xprt->xa->rq_depth);
 	xprt->inbufs.min_bsize = ps;
 	xprt->inbufs.max_bsize = xprt->recvsize;
 
 	poolq_head_setup(&xprt->outbufs.uvqh);
+	poolq_ring_setup(&xprt->outbufs.uvqh, xprt->xa->sq_depth);
 	xprt->outbufs.min_bsize = ps;
 	xprt->outbufs.max_bsize = xprt->sendsize;
 
@@ -0,0 +1,274 @@
+/*
+ * Copyright (c) 2026 The libntirpc contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR `AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * svc_rqst_migrate_stress: xprts crossing between two event channels in
+ * both directions at once, by svc_rqst_evchan_migrate() from the
+ * dispatcher, so that their svc_rqst_rearm_events() move some from
+ * channel 1 to 2 while others move from 2 to 1.
+ *
+ *	svc_rqst_migrate_stress [-c connections] [-n calls] [-t seconds] [-e]
+ *				[-u]
+ *
+ * Each connection makes its null calls one at a time, each asking to move
+ * to the other channel than its last, and out of step with the next
+ * connection.  Fails if every reply has not arrived within the time
+ * limit.  -e makes edge triggered connections (still armed while moved),
+ * -u runs io_uring channels.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include <rpc/rpc.h>
+#include <rpc/svc_rqst.h>
+
+#define STRESS_PROG 0x20000099
+#define STRESS_CHANS 2
+
+static uint32_t chans[STRESS_CHANS];
+static uint64_t migrates;
+
+struct stress_conn {
+	struct sockaddr_in sa;
+	uint32_t calls;
+	uint32_t index;
+	uint32_t replies;
+	pthread_t id;
+};
+
+/* xid (call number + connection index) parity picks the channel */
+static void
+stress_dispatch(struct svc_req *req)
+{
+	uint32_t next = chans[req->rq_msg.rm_xid % STRESS_CHANS];
+
+	if (!svc_rqst_evchan_migrate(req->rq_xprt, next))
+		__atomic_add_fetch(&migrates, 1, __ATOMIC_RELAXED);
+	svc_sendreply(req, (xdrproc_t) xdr_void, NULL);
+}
+
+static void *
+stress_chan(void *arg)
+{
+	svc_rqst_thrd_run(*(uint32_t *)arg, 0);
+	return (NULL);
+}
+
+static char *
+stress_put(char *p, uint32_t v)
+{
+	v = htonl(v);
+	memcpy(p, &v, sizeof(v));
+	return (p + sizeof(v));
+}
+
+static bool
+stress_read(int fd, char *buf, size_t len)
+{
+	ssize_t n;
+
+	while (len) {
+		n = read(fd, buf, len);
+		if (n <= 0)
+			return (false);
+		buf += n;
+		len -= n;
+	}
+	return (true);
+}
+
+static void *
+stress_client(void *arg)
+{
+	struct stress_conn *conn = arg;
+	char call[4 + 40];
+	char reply[256];
+	uint32_t header;
+	uint32_t ix;
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+	if (connect(fd, (struct sockaddr *)&conn->sa, sizeof(conn->sa))) {
+		perror("connect");
+		exit(1);
+	}
+
+	for (ix = 0; ix < conn->calls; ix++) {
+		char *p = stress_put(call, 0x80000000 | 40);
+
+		p = stress_put(p, ix + conn->index);	/* xid */
+		p = stress_put(p, CALL);
+		p = stress_put(p, RPC_MSG_VERSION);
+		p = stress_put(p, STRESS_PROG);
+		p = stress_put(p, 1);
+		p = stress_put(p, NULLPROC);
+		memset(p, 0, 4 * sizeof(uint32_t));	/* AUTH_NONE x 2 */
+
+		if (write(fd, call, sizeof(call)) != sizeof(call)) {
+			perror("write");
+			exit(1);
+		}
+		if (!stress_read(fd, (char *)&header, sizeof(header)))
+			break;
+		header = ntohl(header) & ~0x80000000;
+		if (header > sizeof(reply)
+		 || !stress_read(fd, reply, header))
+			break;
+		conn->replies++;
+	}
+	close(fd);
+	return (NULL);
+}
+
+static void
+stress_timeout(int sig)
+{
+	static const char msg[] = "timed out, channels deadlocked?\n";
+
+	(void)write(STDERR_FILENO, msg, sizeof(msg) - 1);
+	_exit(2);
+}
+
+int
+main(int argc, char *argv[])
+{
+	struct sockaddr_in sa;
+	socklen_t sl = sizeof(sa);
+	struct stress_conn *conns;
+	struct svc_rqst_stats stats;
+	pthread_t chan_thrds[STRESS_CHANS * 2];
+	SVCXPRT *xprt;
+	uint32_t connections = 16;
+	uint32_t calls = 20000;
+	uint32_t seconds = 60;
+	uint32_t ev_flag = 0;
+	uint32_t init_flags = SVC_INIT_EPOLL;
+	uint64_t replies = 0;
+	int opt, fd, ix;
+
+	while ((opt = getopt(argc, argv, "c:n:t:eu")) != -1) {
+		switch (opt) {
+		case 'c':
+			connections = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			calls = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			seconds = strtoul(optarg, NULL, 0);
+			break;
+		case 'e':
+			init_flags |= SVC_INIT_VC_ET;
+			break;
+		case 'u':
+			ev_flag = SVC_RQST_FLAG_URING;
+			break;
+		default:
+			fprintf(stderr,
+				"usage: %s [-c connections] [-n calls] "
+				"[-t seconds] [-e] [-u]\n",
+				argv[0]);
+			return (1);
+		}
+	}
+
+	signal(SIGALRM, stress_timeout);
+	alarm(seconds);
+
+	svc_init(&(svc_init_params) {
+		 .flags = init_flags,
+		 .max_connections = connections + 8,
+		 .max_events = 64,
+		 .gss_ctx_hash_partitions = 13,
+		 .gss_max_ctx = 64,
+		 .gss_max_idle_gen = 64,
+		 .gss_max_gc = 8,
+		 });
+
+	/* worker getreq, so that rearms (and migrations) run in parallel */
+	for (ix = 0; ix < STRESS_CHANS; ix++) {
+		if (svc_rqst_new_evchan(&chans[ix], NULL,
+					SVC_RQST_FLAG_CHAN_AFFINITY
+					| SVC_RQST_FLAG_WORKER | ev_flag)) {
+			fprintf(stderr, "svc_rqst_new_evchan failed\n");
+			return (1);
+		}
+	}
+
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	memset(&sa, 0, sizeof(sa));
+	sa.sin_family = AF_INET;
+	sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(fd, (struct sockaddr *)&sa, sizeof(sa))
+	 || getsockname(fd, (struct sockaddr *)&sa, &sl)) {
+		perror("bind");
+		return (1);
+	}
+
+	xprt = svc_vc_ncreatef(fd, 0, 0,
+			       SVC_CREATE_FLAG_LISTEN
+			       | SVC_CREATE_FLAG_XPRT_NOREG);
+	svc_reg(xprt, STRESS_PROG, 1, stress_dispatch, NULL);
+	svc_rqst_evchan_reg(chans[0], xprt, SVC_RQST_FLAG_CHAN_AFFINITY);
+
+	for (ix = 0; ix < STRESS_CHANS * 2; ix++)
+		pthread_create(&chan_thrds[ix], NULL, stress_chan,
+			       &chans[ix % STRESS_CHANS]);
+
+	conns = calloc(connections, sizeof(*conns));
+	for (ix = 0; ix < connections; ix++) {
+		conns[ix].sa = sa;
+		conns[ix].calls = calls;
+		conns[ix].index = ix;
+		pthread_create(&conns[ix].id, NULL, stress_client, &conns[ix]);
+	}
+	for (ix = 0; ix < connections; ix++) {
+		pthread_join(conns[ix].id, NULL);
+		replies += conns[ix].replies;
+	}
+
+	printf("connections %u calls %u replies %llu migrates %llu\n",
+	       connections, calls, (unsigned long long)replies,
+	       (unsigned long long)migrates);
+	for (ix = 0; ix < STRESS_CHANS; ix++) {
+		svc_rqst_evchan_stats(chans[ix], &stats);
+		printf("chan %u events %llu\n", chans[ix],
+		       (unsigned long long)stats.events);
+	}
+
+	for (ix = 0; ix < STRESS_CHANS; ix++)
+		svc_rqst_thrd_signal(chans[ix], SVC_RQST_SIGNAL_SHUTDOWN);
+	for (ix = 0; ix < STRESS_CHANS * 2; ix++)
+		pthread_join(chan_thrds[ix], NULL);
+
+	return (replies == (uint64_t)connections * calls ? 0 : 1);
+}
@@ -0,0 +1,586 @@
+/*
+ * Copyright (c) 2026 The libntirpc contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR `AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * work_pool_bench: compare the shared mutex+condvar queue with the
+ * WORK_POOL_FLAG_STEAL per-worker queues, each with and without the
+ * WORK_POOL_FLAG_RING lock-free ring or with spin_max_ns spinning, and
+ * with the lanes split by WORK_POOL_FLAG_NUMA (the same as steal on a
+ * single node), and with WORK_POOL_FLAG_ELASTIC growing from 1 worker.
+ *
+ *	work_pool_bench [-t tasks per submitter] [-w workers] [-b batch]
+ *
+ * Each run starts N submitter threads, each submitting its tasks as fast
+ * as it can (batch at a time with work_pool_submit_batch() when more
+ * than 1), and reports the time until every task has been run.
+ *
+ * Then, with and without WORK_POOL_FLAG_PRIO, it queues a backlog of
+ * bulk tasks (each busy for 50us), with a high priority task after every
+ * 20, and reports the p50, p99 and max latency of the high priority
+ * tasks.  The "idle" row has the same high priority tasks without the
+ * bulk backlog: with prio, their p99 should stay close to it.
+ *
+ * Last, through svc_work_pool with SVC_INIT_WORK_PRIO: one connection
+ * alternates a bulk call (busy for 50us) and a high priority call, one at
+ * a time, while 2 connections per worker keep 4 bulk calls each in
+ * flight.  It reports the round trip of the high priority calls, with
+ * calls classed by connection only ("xconn", all NORMAL), and by
+ * procedure through svc_init_params classify ("xcall").  The "xidle" row
+ * is the lone connection, classed by procedure.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include <rpc/rpc.h>
+#include <rpc/svc_rqst.h>
+#include <rpc/work_pool.h>
+
+struct bench_run {
+	struct work_pool *pool;
+	struct work_pool_entry *entries;
+	uint32_t tasks;
+	uint32_t batch;
+	pthread_t id;
+};
+
+static uint64_t completed;
+
+struct bench_prio_entry {
+	struct work_pool_entry wpe;	/*** 1st ***/
+	uint64_t submitted;
+	uint64_t latency;
+};
+
+#define BENCH_PRIO_BULK 4000
+#define BENCH_PRIO_EVERY 20
+#define BENCH_PRIO_BUSY_NS 50000
+
+#define BENCH_PROG 0x20000098
+#define BENCH_PROC_BULK 1
+#define BENCH_PROC_HIGH 2
+#define BENCH_CALL_ROUNDS 400
+#define BENCH_CALL_DEPTH 4
+
+static bool bench_classify_calls;
+static bool bench_flooding;
+
+static void
+bench_task(struct work_pool_entry *wpe)
+{
+	__atomic_add_fetch(&completed, 1, __ATOMIC_RELAXED);
+}
+
+static uint64_t
+bench_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec);
+}
+
+static void
+bench_bulk_task(struct work_pool_entry *wpe)
+{
+	uint64_t start = bench_ns();
+
+	while (bench_ns() - start < BENCH_PRIO_BUSY_NS)
+		;
+	__atomic_add_fetch(&completed, 1, __ATOMIC_RELAXED);
+}
+
+static void
+bench_high_task(struct work_pool_entry *wpe)
+{
+	struct bench_prio_entry *bpe = (struct bench_prio_entry *)wpe;
+
+	bpe->latency = bench_ns() - bpe->submitted;
+	__atomic_add_fetch(&completed, 1, __ATOMIC_RELAXED);
+}
+
+static int
+bench_cmp(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+
+	return (x < y) ? -1 : (x > y);
+}
+
+static void
+bench_prio(const char *name, uint32_t flags, int workers, bool loaded)
+{
+	struct work_pool pool;
+	struct work_pool_params params = {
+		.thrd_max = workers,
+		.thrd_min = workers,
+		.flags = flags,
+	};
+	uint32_t n_high = BENCH_PRIO_BULK / BENCH_PRIO_EVERY;
+	struct work_pool_entry *bulk =
+		calloc(BENCH_PRIO_BULK, sizeof(struct work_pool_entry));
+	struct bench_prio_entry *high =
+		calloc(n_high, sizeof(struct bench_prio_entry));
+	uint64_t *latency = calloc(n_high, sizeof(uint64_t));
+	uint32_t ix, h = 0, b = 0;
+
+	if (work_pool_init(&pool, name, &params)) {
+		fprintf(stderr, "work_pool_init %s failed\n", name);
+		exit(1);
+	}
+
+	__atomic_store_n(&completed, 0, __ATOMIC_RELAXED);
+
+	for (ix = 0; ix < BENCH_PRIO_BULK; ix++) {
+		if (loaded) {
+			bulk[b].fun = bench_bulk_task;
+			bulk[b].prio = WORK_POOL_PRIO_BULK;
+			work_pool_submit(&pool, &bulk[b++]);
+		}
+
+		if ((ix % BENCH_PRIO_EVERY) == 0) {
+			high[h].wpe.fun = bench_high_task;
+			high[h].wpe.prio = WORK_POOL_PRIO_HIGH;
+			high[h].submitted = bench_ns();
+			work_pool_submit(&pool, &high[h].wpe);
+			h++;
+		}
+	}
+
+	while (__atomic_load_n(&completed, __ATOMIC_RELAXED)
+	       < b + h)
+		sched_yield();
+
+	work_pool_shutdown(&pool);
+
+	for (ix = 0; ix < h; ix++)
+		latency[ix] = high[ix].latency;
+	qsort(latency, h, sizeof(uint64_t), bench_cmp);
+
+	printf("%-6s %12.3f %12.3f %12.3f\n", name,
+	       latency[h / 2] / 1000000.0,
+	       latency[h * 99 / 100] / 1000000.0,
+	       latency[h - 1] / 1000000.0);
+
+	free(latency);
+	free(high);
+	free(bulk);
+}
+
+static uint32_t
+bench_classify(struct svc_req *req)
+{
+	if (!bench_classify_calls || req->rq_msg.cb_prog != BENCH_PROG)
+		return (req->rq_xprt->xp_wpe.prio);
+
+	switch (req->rq_msg.cb_proc) {
+	case BENCH_PROC_BULK:
+		return (WORK_POOL_PRIO_BULK);
+	case BENCH_PROC_HIGH:
+		return (WORK_POOL_PRIO_HIGH);
+	default:
+		return (WORK_POOL_PRIO_NORMAL);
+	}
+}
+
+static void
+bench_dispatch(struct svc_req *req)
+{
+	uint64_t start = bench_ns();
+
+	if (req->rq_msg.cb_proc == BENCH_PROC_BULK)
+		while (bench_ns() - start < BENCH_PRIO_BUSY_NS)
+			;
+	svc_sendreply(req, (xdrproc_t) xdr_void, NULL);
+}
+
+static void *
+bench_chan(void *arg)
+{
+	svc_rqst_thrd_run(*(uint32_t *)arg, 0);
+	return (NULL);
+}
+
+static char *
+bench_put(char *p, uint32_t v)
+{
+	v = htonl(v);
+	memcpy(p, &v, sizeof(v));
+	return (p + sizeof(v));
+}
+
+static void
+bench_call(int fd, uint32_t xid, uint32_t proc)
+{
+	char call[4 + 40];
+	char *p = bench_put(call, 0x80000000 | 40);
+
+	p = bench_put(p, xid);
+	p = bench_put(p, CALL);
+	p = bench_put(p, RPC_MSG_VERSION);
+	p = bench_put(p, BENCH_PROG);
+	p = bench_put(p, 1);
+	p = bench_put(p, proc);
+	memset(p, 0, 4 * sizeof(uint32_t));	/* AUTH_NONE x 2 */
+
+	if (write(fd, call, sizeof(call)) != sizeof(call)) {
+		perror("write");
+		exit(1);
+	}
+}
+
+static bool
+bench_read(int fd, char *buf, size_t len)
+{
+	ssize_t n;
+
+	while (len) {
+		n = read(fd, buf, len);
+		if (n <= 0)
+			return (false);
+		buf += n;
+		len -= n;
+	}
+	return (true);
+}
+
+static void
+bench_reply(int fd)
+{
+	char reply[256];
+	uint32_t header;
+
+	if (!bench_read(fd, (char *)&header, sizeof(header))
+	 || (header = ntohl(header) & ~0x80000000) > sizeof(reply)
+	 || !bench_read(fd, reply, header)) {
+		fprintf(stderr, "reply failed\n");
+		exit(1);
+	}
+}
+
+static int
+bench_connect(struct sockaddr_in *sa)
+{
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+	if (connect(fd, (struct sockaddr *)sa, sizeof(*sa))) {
+		perror("connect");
+		exit(1);
+	}
+	return (fd);
+}
+
+/* BENCH_CALL_DEPTH bulk calls in flight, until the mixed connection is
+ * done
+ */
+static void *
+bench_flood(void *arg)
+{
+	int fd = bench_connect(arg);
+	uint32_t xid = 0;
+	uint32_t ix;
+
+	for (ix = 0; ix < BENCH_CALL_DEPTH; ix++)
+		bench_call(fd, ++xid, BENCH_PROC_BULK);
+	while (__atomic_load_n(&bench_flooding, __ATOMIC_RELAXED)) {
+		bench_reply(fd);
+		bench_call(fd, ++xid, BENCH_PROC_BULK);
+	}
+	for (ix = 0; ix < BENCH_CALL_DEPTH; ix++)
+		bench_reply(fd);
+	close(fd);
+	return (NULL);
+}
+
+static void
+bench_calls(const char *name, struct sockaddr_in *sa, int workers,
+	    bool classify, bool loaded)
+{
+	int n_flood = loaded ? 2 * workers : 0;
+	pthread_t *flood = calloc(n_flood + 1, sizeof(pthread_t));
+	uint64_t *latency = calloc(BENCH_CALL_ROUNDS, sizeof(uint64_t));
+	uint64_t start;
+	uint32_t ix;
+	int fd;
+
+	bench_classify_calls = classify;
+	__atomic_store_n(&bench_flooding, true, __ATOMIC_RELAXED);
+	for (ix = 0; ix < n_flood; ix++)
+		pthread_create(&flood[ix], NULL, bench_flood, sa);
+
+	/* let the flood fill the pool */
+	usleep(100000);
+
+	fd = bench_connect(sa);
+	for (ix = 0; ix < BENCH_CALL_ROUNDS; ix++) {
+		bench_call(fd, 2 * ix + 1, BENCH_PROC_BULK);
+		bench_reply(fd);
+
+		start = bench_ns();
+		bench_call(fd, 2 * ix + 2, BENCH_PROC_HIGH);
+		bench_reply(fd);
+		latency[ix] = bench_ns() - start;
+	}
+	close(fd);
+
+	__atomic_store_n(&bench_flooding, false, __ATOMIC_RELAXED);
+	for (ix = 0; ix < n_flood; ix++)
+		pthread_join(flood[ix], NULL);
+
+	qsort(latency, BENCH_CALL_ROUNDS, sizeof(uint64_t), bench_cmp);
+	printf("%-6s %12.3f %12.3f %12.3f\n", name,
+	       latency[BENCH_CALL_ROUNDS / 2] / 1000000.0,
+	       latency[BENCH_CALL_ROUNDS * 99 / 100] / 1000000.0,
+	       latency[BENCH_CALL_ROUNDS - 1] / 1000000.0);
+
+	free(latency);
+	free(flood);
+}
+
+static void
+bench_xprt(int workers)
+{
+	struct sockaddr_in sa;
+	socklen_t sl = sizeof(sa);
+	pthread_t chan_thrd;
+	uint32_t chan;
+	SVCXPRT *xprt;
+	int fd;
+
+	svc_init(&(svc_init_params) {
+		 .flags = SVC_INIT_EPOLL | SVC_INIT_WORK_PRIO,
+		 .max_connections = 4 * workers + 8,
+		 .max_events = 64,
+		 .gss_ctx_hash_partitions = 13,
+		 .gss_max_ctx = 64,
+		 .gss_max_idle_gen = 64,
+		 .gss_max_gc = 8,
+		 .ioq_thrd_max = workers,
+		 .classify = bench_classify,
+		 });
+
+	if (svc_rqst_new_evchan(&chan, NULL, SVC_RQST_FLAG_CHAN_AFFINITY
+						| SVC_RQST_FLAG_WORKER)) {
+		fprintf(stderr, "svc_rqst_new_evchan failed\n");
+		exit(1);
+	}
+
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	memset(&sa, 0, sizeof(sa));
+	sa.sin_family = AF_INET;
+	sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(fd, (struct sockaddr *)&sa, sizeof(sa))
+	 || getsockname(fd, (struct sockaddr *)&sa, &sl)) {
+		perror("bind");
+		exit(1);
+	}
+
+	xprt = svc_vc_ncreatef(fd, 0, 0,
+			       SVC_CREATE_FLAG_LISTEN
+			       | SVC_CREATE_FLAG_XPRT_NOREG);
+	svc_reg(xprt, BENCH_PROG, 1, bench_dispatch, NULL);
+	svc_rqst_evchan_reg(chan, xprt, SVC_RQST_FLAG_CHAN_AFFINITY);
+	pthread_create(&chan_thrd, NULL, bench_chan, &chan);
+
+	bench_calls("xidle", &sa, workers, true, false);
+	bench_calls("xconn", &sa, workers, false, true);
+	bench_calls("xcall", &sa, workers, true, true);
+
+	svc_rqst_thrd_signal(chan, SVC_RQST_SIGNAL_SHUTDOWN);
+	pthread_join(chan_thrd, NULL);
+}
+
+static void *
+bench_submitter(void *arg)
+{
+	struct bench_run *run = arg;
+	struct work_pool_entry **works;
+	uint32_t ix, n = 0;
+
+	if (run->batch <= 1) {
+		for (ix = 0; ix < run->tasks; ix++) {
+			run->entries[ix].fun = bench_task;
+			work_pool_submit(run->pool, &run->entries[ix]);
+		}
+		return (NULL);
+	}
+
+	works = calloc(run->batch, sizeof(struct work_pool_entry *));
+	for (ix = 0; ix < run->tasks; ix++) {
+		run->entries[ix].fun = bench_task;
+		works[n++] = &run->entries[ix];
+		if (n == run->batch || ix + 1 == run->tasks) {
+			work_pool_submit_batch(run->pool, works, n);
+			n = 0;
+		}
+	}
+	free(works);
+	return (NULL);
+}
+
+static double
+bench_once(struct work_pool *pool, int submitters, uint32_t tasks,
+	   uint32_t batch)
+{
+	struct bench_run *runs = calloc(submitters, sizeof(*runs));
+	struct timespec t0, t1;
+	uint64_t total = (uint64_t)submitters * tasks;
+	int ix;
+
+	__atomic_store_n(&completed, 0, __ATOMIC_RELAXED);
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+
+	for (ix = 0; ix < submitters; ix++) {
+		runs[ix].pool = pool;
+		runs[ix].tasks = tasks;
+		runs[ix].batch = batch;
+		runs[ix].entries = calloc(tasks,
+					  sizeof(struct work_pool_entry));
+		pthread_create(&runs[ix].id, NULL, bench_submitter, &runs[ix]);
+	}
+	for (ix = 0; ix < submitters; ix++)
+		pthread_join(runs[ix].id, NULL);
+
+	while (__atomic_load_n(&completed, __ATOMIC_RELAXED) < total)
+		sched_yield();
+
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+
+	for (ix = 0; ix < submitters; ix++)
+		free(runs[ix].entries);
+	free(runs);
+
+	return ((t1.tv_sec - t0.tv_sec)
+		+ (t1.tv_nsec - t0.tv_nsec) / 1000000000.0);
+}
+
+int
+main(int argc, char *argv[])
+{
+	static const int submitters[] = { 1, 8, 32, 128 };
+	static const struct {
+		const char *name;
+		uint32_t flags;
+		uint32_t spin_max_ns;
+	} modes[] = {
+		{ "mutex", WORK_POOL_FLAG_NONE, 0 },
+		{ "spin", WORK_POOL_FLAG_NONE, 50000 },
+		{ "ring", WORK_POOL_FLAG_RING, 0 },
+		{ "steal", WORK_POOL_FLAG_STEAL, 0 },
+		{ "sspin", WORK_POOL_FLAG_STEAL, 50000 },
+		{ "sring", WORK_POOL_FLAG_STEAL | WORK_POOL_FLAG_RING, 0 },
+		{ "numa", WORK_POOL_FLAG_STEAL | WORK_POOL_FLAG_NUMA, 0 },
+		{ "elast", WORK_POOL_FLAG_ELASTIC, 0 },
+	};
+	uint32_t tasks = 100000;
+	uint32_t batch = 1;
+	int workers = 16;
+	int opt, m, ix;
+
+	while ((opt = getopt(argc, argv, "b:t:w:")) != -1) {
+		switch (opt) {
+		case 'b':
+			batch = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			tasks = strtoul(optarg, NULL, 0);
+			break;
+		case 'w':
+			workers = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr,
+				"usage: %s [-t tasks] [-w workers] [-b batch]\n",
+				argv[0]);
+			return (1);
+		}
+	}
+
+	printf("%-6s %10s %12s %14s\n",
+	       "mode", "submitters", "seconds", "tasks/sec");
+
+	for (m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+		struct work_pool pool;
+		struct work_pool_stats stats;
+		struct work_pool_params params = {
+			.thrd_max = workers,
+			.thrd_min = workers,
+			.flags = modes[m].flags,
+			.spin_max_ns = modes[m].spin_max_ns,
+		};
+
+		if (modes[m].flags & WORK_POOL_FLAG_ELASTIC)
+			params.thrd_min = 1;
+
+		if (work_pool_init(&pool, modes[m].name, &params)) {
+			fprintf(stderr, "work_pool_init %s failed\n",
+				modes[m].name);
+			return (1);
+		}
+
+		for (ix = 0; ix < sizeof(submitters) / sizeof(int); ix++) {
+			double secs = bench_once(&pool, submitters[ix], tasks,
+						 batch);
+
+			printf("%-6s %10d %12.3f %14.0f\n",
+			       modes[m].name, submitters[ix], secs,
+			       submitters[ix] * (double)tasks / secs);
+		}
+
+		work_pool_get_stats(&pool, &stats);
+		if (modes[m].spin_max_ns)
+			printf("%-6s spin hits %llu misses %llu\n",
+			       modes[m].name,
+			       (unsigned long long)stats.spin_hits,
+			       (unsigned long long)stats.spin_misses);
+		if (modes[m].flags & WORK_POOL_FLAG_ELASTIC)
+			printf("%-6s threads %u spawned %llu exited %llu "
+			       "delay avg %llu ns\n",
+			       modes[m].name, stats.n_threads,
+			       (unsigned long long)stats.spawned,
+			       (unsigned long long)stats.exited,
+			       (unsigned long long)stats.delay_avg_ns);
+
+		work_pool_shutdown(&pool);
+	}
+
+	printf("\n%-6s %12s %12s %12s\n",
+	       "high", "p50 ms", "p99 ms", "max ms");
+	bench_prio("idle", WORK_POOL_FLAG_PRIO, workers, false);
+	bench_prio("fifo", WORK_POOL_FLAG_NONE, workers, true);
+	bench_prio("prio", WORK_POOL_FLAG_PRIO, workers, true);
+
+	bench_xprt(workers);
+
+	return (0);
+}
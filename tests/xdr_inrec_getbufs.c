@@ -0,0 +1,302 @@
+/*
+ * Copyright (c) 2026 The libntirpc contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR `AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * xdr_inrec_getbufs: XDR_GETBUFS of an xdr_inrec_create() stream over a
+ * socketpair.
+ *
+ *	xdr_inrec_getbufs
+ *
+ * Each case writes a record of two longs, an opaque payload (not a
+ * multiple of 4 bytes), its padding and two more longs, in several
+ * fragments, then a second record of one long.  The payload is received
+ * by XDR_GETBUFS into vectors that split it across the fragments, part
+ * from bytes already read ahead into the stream buffer and the rest
+ * read directly, a few hundred bytes per read().  The longs after it,
+ * and in the next record, must decode as written, the last one inline
+ * from a word aligned address, and the checksum must be that of the same
+ * record decoded by XDR_GETBYTES.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include <rpc/rpc.h>
+#include <rpc/xdr_inrec.h>
+
+#define TEST_LONG_A 0x11111111
+#define TEST_LONG_B 0x22222222
+#define TEST_LONG_C 0x33333333
+#define TEST_LONG_D 0x44444444
+#define TEST_READ_MAX 700
+#define TEST_VECS 3
+
+struct test_case {
+	const char *name;
+	u_int recvsize;
+	u_int readahead;	/* 0: none */
+	u_int frag;		/* fragment bytes, the last may be less */
+	u_int len;		/* payload */
+	u_int vecs[TEST_VECS];
+};
+
+static int
+test_readit(XDR *xdrs, void *handle, void *buf, int len)
+{
+	/* short reads, as from a socket */
+	return (read(*(int *)handle, buf, MIN(len, TEST_READ_MAX)));
+}
+
+static char *
+test_put(char *p, uint32_t v)
+{
+	v = htonl(v);
+	memcpy(p, &v, sizeof(v));
+	return (p + sizeof(v));
+}
+
+/* both records, as fragments, into fd */
+static void
+test_write(int fd, const char *rec, u_int reclen, u_int frag)
+{
+	char *stream = malloc(reclen + 4 * (reclen / frag + 1) + 8);
+	char *p = stream;
+	u_int off, n;
+
+	for (off = 0; off < reclen; off += n) {
+		n = MIN(frag, reclen - off);
+		p = test_put(p, n | (off + n == reclen ? 0x80000000 : 0));
+		memcpy(p, rec + off, n);
+		p += n;
+	}
+	p = test_put(p, 0x80000000 | 4);
+	p = test_put(p, TEST_LONG_D);
+
+	if (write(fd, stream, p - stream) != p - stream) {
+		perror("write");
+		exit(1);
+	}
+	free(stream);
+}
+
+static bool
+test_long(XDR *xdrs, const char *name, const char *what, uint32_t want)
+{
+	long l;
+
+	if (!XDR_GETLONG(xdrs, &l)) {
+		printf("%s: %s failed\n", name, what);
+		return (false);
+	}
+	if ((uint32_t)l != want) {
+		printf("%s: %s %08x, not %08x\n", name, what, (uint32_t)l,
+		       want);
+		return (false);
+	}
+	return (true);
+}
+
+/* the record, its payload received by XDR_GETBUFS (or XDR_GETBYTES) */
+static bool
+test_decode(const struct test_case *tc, const char *rec, u_int reclen,
+	    const char *payload, bool getbufs, uint64_t *cksum)
+{
+	const char *name = getbufs ? tc->name : "reference";
+	xdr_uio *uio = calloc(1, sizeof(xdr_uio)
+				 + TEST_VECS * sizeof(xdr_vio));
+	char *bufs[TEST_VECS];
+	char pad[4];
+	int32_t *c;
+	XDR xdrs[1];
+	bool ok = false;
+	u_int ix, off;
+	int sv[2];
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv)) {
+		perror("socketpair");
+		exit(1);
+	}
+	test_write(sv[1], rec, reclen, tc->frag);
+
+	xdr_inrec_create(xdrs, tc->recvsize, &sv[0], test_readit);
+	xdrs->x_op = XDR_DECODE;
+
+	/* as svc_vc_recv() */
+	(void)xdr_inrec_skiprecord(xdrs);
+	if (tc->readahead)
+		(void)xdr_inrec_readahead(xdrs, tc->readahead);
+
+	if (!test_long(xdrs, name, "A", TEST_LONG_A)
+	 || !test_long(xdrs, name, "length", tc->len))
+		goto out;
+
+	uio->uio_count = TEST_VECS;
+	for (ix = 0; ix < TEST_VECS; ix++) {
+		bufs[ix] = malloc(tc->vecs[ix]);
+		uio->uio_vio[ix].vio_base = bufs[ix];
+		uio->uio_vio[ix].vio_head = bufs[ix];
+		uio->uio_vio[ix].vio_tail = bufs[ix];
+		uio->uio_vio[ix].vio_wrap = bufs[ix] + tc->vecs[ix];
+	}
+
+	if (getbufs) {
+		if (!XDR_GETBUFS(xdrs, uio, tc->len, XDR_GETBUFS_FLAG_NONE)) {
+			printf("%s: XDR_GETBUFS failed\n", name);
+			goto free;
+		}
+	} else {
+		/* a word at a time, the checksum before any refill */
+		for (ix = 0, off = 0; off < tc->len; ix++) {
+			xdr_vio *vio = &uio->uio_vio[ix];
+			u_int n = MIN(tc->vecs[ix], tc->len - off);
+			u_int k;
+
+			for (k = 0; k < n; k += 4) {
+				if (!XDR_GETBYTES(xdrs, (char *)vio->vio_tail,
+						  MIN(4, n - k))) {
+					printf("%s: XDR_GETBYTES failed\n",
+					       name);
+					goto free;
+				}
+				vio->vio_tail = (char *)vio->vio_tail
+						+ MIN(4, n - k);
+			}
+			off += n;
+		}
+	}
+
+	/* filled in order, each to its end before the next */
+	for (ix = 0, off = 0; ix < TEST_VECS; ix++) {
+		xdr_vio *vio = &uio->uio_vio[ix];
+		u_int n = (char *)vio->vio_tail - (char *)vio->vio_head;
+
+		if (n != MIN(tc->vecs[ix], tc->len - off)) {
+			printf("%s: vector %u holds %u bytes\n", name, ix, n);
+			goto free;
+		}
+		if (memcmp(vio->vio_head, payload + off, n)) {
+			printf("%s: vector %u differs\n", name, ix);
+			goto free;
+		}
+		off += n;
+	}
+
+	/* padding is left to the caller */
+	if (!XDR_GETBYTES(xdrs, pad, RNDUP(tc->len) - tc->len)) {
+		printf("%s: padding failed\n", name);
+		goto free;
+	}
+	if (!test_long(xdrs, name, "B", TEST_LONG_B))
+		goto free;
+
+	/* buffered again, at the same alignment as in the stream */
+	c = XDR_INLINE(xdrs, BYTES_PER_XDR_UNIT);
+	if (!c || ((uintptr_t)c % BYTES_PER_XDR_UNIT)) {
+		printf("%s: C at %p, not inline and aligned\n", name, c);
+		goto free;
+	}
+	if (ntohl(*c) != TEST_LONG_C) {
+		printf("%s: C %08x, not %08x\n", name, ntohl(*c),
+		       TEST_LONG_C);
+		goto free;
+	}
+
+	*cksum = xdr_inrec_cksum(xdrs);
+
+	if (!xdr_inrec_skiprecord(xdrs)
+	 || !test_long(xdrs, name, "next record", TEST_LONG_D))
+		goto free;
+
+	ok = true;
+ free:
+	for (ix = 0; ix < TEST_VECS; ix++)
+		free(bufs[ix]);
+ out:
+	XDR_DESTROY(xdrs);
+	close(sv[0]);
+	close(sv[1]);
+	free(uio);
+	return (ok);
+}
+
+static bool
+test_run(const struct test_case *tc)
+{
+	u_int reclen = 8 + RNDUP(tc->len) + 8;
+	char *rec = calloc(1, reclen);
+	char *payload = rec + 8;
+	uint64_t cksum = 0, want = 0;
+	bool ok;
+	u_int ix;
+	char *p;
+
+	p = test_put(rec, TEST_LONG_A);
+	(void)test_put(p, tc->len);
+	for (ix = 0; ix < tc->len; ix++)
+		payload[ix] = (char)(ix * 7 + ix / 251);
+	p = payload + RNDUP(tc->len);
+	p = test_put(p, TEST_LONG_B);
+	(void)test_put(p, TEST_LONG_C);
+
+	ok = test_decode(tc, rec, reclen, payload, false, &want)
+	  && test_decode(tc, rec, reclen, payload, true, &cksum);
+	if (ok && cksum != want) {
+		printf("%s: checksum %016llx, not %016llx\n", tc->name,
+		       (unsigned long long)cksum, (unsigned long long)want);
+		ok = false;
+	}
+	printf("%-8s %s\n", tc->name, ok ? "ok" : "FAILED");
+
+	free(rec);
+	return (ok);
+}
+
+int
+main(int argc, char *argv[])
+{
+	static const struct test_case cases[] = {
+		/* read ahead (as svc_vc), then direct; split at 3000 */
+		{ "ahead", 8192, 1024, 3000, 5003, { 1000, 2500, 2000 } },
+		/* small buffer, no read ahead, 3 byte first vector */
+		{ "direct", 512, 0, 700, 5003, { 3, 4093, 2000 } },
+		/* fragments smaller than a read, and than the vectors */
+		{ "frags", 4000, 1024, 257, 6001, { 2999, 1, 4000 } },
+		/* payload ending on a fragment boundary */
+		{ "edge", 8192, 1024, 1004, 2000, { 1000, 1000, 0 } },
+	};
+	int failed = 0;
+	int ix;
+
+	for (ix = 0; ix < sizeof(cases) / sizeof(cases[0]); ix++)
+		if (!test_run(&cases[ix]))
+			failed++;
+
+	return (failed ? 1 : 0);
+}
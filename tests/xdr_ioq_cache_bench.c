@@ -0,0 +1,239 @@
+/*
+ * Copyright (c) 2026 The libntirpc contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR `AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * xdr_ioq_cache_bench: compare xdr_ioq_cache_get() segments with
+ * xdr_ioq_uv_create() allocating each from the process allocator.
+ *
+ *	xdr_ioq_cache_bench [-n segments per thread] [-d depth]
+ *
+ * For each size class and thread count, "local" threads each take depth
+ * segments and release them, over and over, like a worker encoding
+ * replies; "pass" threads are pairs, one taking segments and the other
+ * releasing them, like a receiving event thread and a worker.
+ *
+ * The "malloc" rows measure whichever allocator the library was built
+ * with (see the ALLOCATOR CMake option); run with LD_PRELOAD of
+ * libjemalloc or libtcmalloc to compare others with the same binary.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <time.h>
+#include <pthread.h>
+
+#include <rpc/types.h>
+#include <rpc/xdr_ioq.h>
+
+#define BENCH_RING 64
+
+struct bench_run {
+	struct xdr_ioq_uv **uv;
+	struct xdr_ioq_uv *ring[BENCH_RING];
+	uint32_t head;		/* producer */
+	uint32_t tail;		/* consumer */
+	uint32_t segments;
+	uint32_t depth;
+	u_int size;
+	bool cache;
+	pthread_t id[2];
+};
+
+static inline struct xdr_ioq_uv *
+bench_get(struct bench_run *run)
+{
+	struct xdr_ioq_uv *uv = run->cache
+				? xdr_ioq_cache_get(run->size)
+				: xdr_ioq_uv_create(run->size, UIO_FLAG_FREE);
+
+	/* as encoding would */
+	*(uint32_t *)uv->v.vio_base = run->segments;
+	return (uv);
+}
+
+static void *
+bench_local(void *arg)
+{
+	struct bench_run *run = arg;
+	uint32_t n, ix;
+
+	for (n = 0; n < run->segments; n += run->depth) {
+		for (ix = 0; ix < run->depth; ix++)
+			run->uv[ix] = bench_get(run);
+		for (ix = 0; ix < run->depth; ix++)
+			xdr_ioq_uv_release(run->uv[ix]);
+	}
+	return (NULL);
+}
+
+static void *
+bench_producer(void *arg)
+{
+	struct bench_run *run = arg;
+	uint32_t n;
+
+	for (n = 0; n < run->segments; n++) {
+		while (n - __atomic_load_n(&run->tail, __ATOMIC_ACQUIRE)
+		       >= BENCH_RING)
+			sched_yield();
+		run->ring[n % BENCH_RING] = bench_get(run);
+		__atomic_store_n(&run->head, n + 1, __ATOMIC_RELEASE);
+	}
+	return (NULL);
+}
+
+static void *
+bench_consumer(void *arg)
+{
+	struct bench_run *run = arg;
+	uint32_t n;
+
+	for (n = 0; n < run->segments; n++) {
+		while (__atomic_load_n(&run->head, __ATOMIC_ACQUIRE) == n)
+			sched_yield();
+		xdr_ioq_uv_release(run->ring[n % BENCH_RING]);
+		__atomic_store_n(&run->tail, n + 1, __ATOMIC_RELEASE);
+	}
+	return (NULL);
+}
+
+static double
+bench_once(bool cache, bool pass, u_int size, int threads,
+	   uint32_t segments, uint32_t depth)
+{
+	struct bench_run *runs = calloc(threads, sizeof(*runs));
+	struct timespec t0, t1;
+	int ix;
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+
+	for (ix = 0; ix < threads; ix++) {
+		runs[ix].cache = cache;
+		runs[ix].size = size;
+		runs[ix].segments = segments;
+		runs[ix].depth = depth;
+		runs[ix].uv = calloc(depth, sizeof(struct xdr_ioq_uv *));
+		if (pass) {
+			pthread_create(&runs[ix].id[0], NULL, bench_producer,
+				       &runs[ix]);
+			pthread_create(&runs[ix].id[1], NULL, bench_consumer,
+				       &runs[ix]);
+		} else {
+			pthread_create(&runs[ix].id[0], NULL, bench_local,
+				       &runs[ix]);
+		}
+	}
+	for (ix = 0; ix < threads; ix++) {
+		pthread_join(runs[ix].id[0], NULL);
+		if (pass)
+			pthread_join(runs[ix].id[1], NULL);
+		free(runs[ix].uv);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	free(runs);
+
+	return ((t1.tv_sec - t0.tv_sec)
+		+ (t1.tv_nsec - t0.tv_nsec) / 1000000000.0);
+}
+
+int
+main(int argc, char *argv[])
+{
+	static const char *names[XDR_IOQ_CACHE_CLASSES] = {
+		"4K", "8K", "64K", "1M"
+	};
+	static const u_int sizes[XDR_IOQ_CACHE_CLASSES] = {
+		4096, 8192, 65536, 1048576
+	};
+	static const int threads[] = { 1, 4, 16 };
+	struct xdr_ioq_cache_stats stats[XDR_IOQ_CACHE_CLASSES];
+	uint32_t segments = 200000;
+	uint32_t depth = 8;
+	int opt, c, p, ix, cache;
+
+	while ((opt = getopt(argc, argv, "d:n:")) != -1) {
+		switch (opt) {
+		case 'd':
+			depth = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			segments = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			fprintf(stderr,
+				"usage: %s [-n segments] [-d depth]\n",
+				argv[0]);
+			return (1);
+		}
+	}
+	if (depth < 1)
+		depth = 1;
+
+	printf("%-6s %-5s %4s %7s %12s %14s\n",
+	       "mode", "test", "size", "threads", "seconds", "segments/sec");
+
+	for (c = 0; c < XDR_IOQ_CACHE_CLASSES; c++) {
+		/* fewer of the largest, as the allocator may not cache them */
+		uint32_t n = (sizes[c] > 65536) ? segments / 16 : segments;
+
+		for (p = 0; p < 2; p++) {
+			for (cache = 0; cache < 2; cache++) {
+				for (ix = 0; ix < sizeof(threads) / sizeof(int);
+				     ix++) {
+					double secs = bench_once(cache, p,
+								 sizes[c],
+								 threads[ix],
+								 n, depth);
+
+					printf("%-6s %-5s %4s %7d %12.3f "
+					       "%14.0f\n",
+					       cache ? "cache" : "malloc",
+					       p ? "pass" : "local",
+					       names[c], threads[ix], secs,
+					       threads[ix] * (double)n / secs);
+				}
+			}
+		}
+	}
+
+	xdr_ioq_cache_stats(stats);
+	printf("\n%-4s %12s %8s %12s %12s %10s\n",
+	       "size", "allocs", "hit %", "frees", "released", "depot");
+	for (c = 0; c < XDR_IOQ_CACHE_CLASSES; c++)
+		printf("%-4s %12llu %8.2f %12llu %12llu %10llu\n",
+		       names[c],
+		       (unsigned long long)stats[c].allocs,
+		       stats[c].allocs
+		       ? 100.0 * stats[c].hits / stats[c].allocs : 0.0,
+		       (unsigned long long)stats[c].frees,
+		       (unsigned long long)stats[c].releases,
+		       (unsigned long long)stats[c].depot);
+
+	return (0);
+}